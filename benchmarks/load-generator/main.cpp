@@ -0,0 +1,338 @@
+// Closed-loop load generator: N threads, each driving its own CommandShellIO
+// session against one shared CommandShell, and reporting throughput plus
+// p50/p99/p99.9 latency per command for every thread count.
+//
+// Latency is measured per command line from its first input chunk to the
+// return of the chunk that completed it (dispatch, handler and output
+// included), in nanoseconds. Each session waits a think time between lines.
+//
+//   load-generator [--threads=1,2,4,8] [--duration-ms=1000] [--warmup-ms=100]
+//                  [--mix="led status=6,led on=2,sys work 20=1"]
+//                  [--think-us=0] [--chunk=line|byte|<n>] [--format=csv|json]
+//
+// The mix is a comma-separated list of command lines with optional weights.
+// The demo registry has `led on|off|status`, `sys echo <words>` and
+// `sys work <us>` (busy loop); benchmark a real registry by registering it in
+// makeShell().
+#include "CommandShell.hpp"
+#include "CommandShellIO.hpp"
+#include "CommandTypes.hpp"
+#include "LatencyStats.hpp"
+#include "StructuredOutput.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using commandshell::CommandDetails;
+using commandshell::CommandShell;
+using commandshell::CommandShellIO;
+using commandshell::ComponentCommands;
+using commandshell::LatencyStats;
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct MixEntry
+    {
+        std::string line;
+        uint32_t weight = 1;
+    };
+
+    struct Options
+    {
+        std::vector<size_t> threads{1, 2, 4, 8};
+        uint32_t durationMs = 1000;
+        uint32_t warmupMs = 100;
+        uint32_t thinkUs = 0;
+        size_t chunk = 0; // 0: whole line per input() call
+        bool json = false;
+        std::vector<MixEntry> mix{{"led status", 6}, {"led on", 2}, {"led off", 2}, {"sys echo hello world", 1}, {"sys work 20", 1}};
+    };
+
+    struct RunResult
+    {
+        size_t threads = 0;
+        double seconds = 0;
+        std::map<std::string, LatencyStats> latency; // by mix line, plus "all"
+    };
+
+    void usage()
+    {
+        std::cerr << "usage: load-generator [--threads=1,2,4,8] [--duration-ms=<ms>] [--warmup-ms=<ms>]\n"
+                     "                      [--mix=\"<line>[=<weight>],...\"] [--think-us=<us>]\n"
+                     "                      [--chunk=line|byte|<n>] [--format=csv|json]\n";
+    }
+
+    std::vector<std::string> splitList(const std::string& text)
+    {
+        std::vector<std::string> items;
+        size_t start = 0;
+        while (start <= text.size()) {
+            size_t end = text.find(',', start);
+            if (end == std::string::npos) end = text.size();
+            if (end > start) items.push_back(text.substr(start, end - start));
+            start = end + 1;
+        }
+        return items;
+    }
+
+    bool parseMix(const std::string& text, std::vector<MixEntry>& mix)
+    {
+        mix.clear();
+        for (const auto& item : splitList(text)) {
+            MixEntry entry;
+            const size_t eq = item.rfind('=');
+            entry.line = item.substr(0, eq);
+            if (eq != std::string::npos) {
+                entry.weight = static_cast<uint32_t>(std::strtoul(item.c_str() + eq + 1, nullptr, 10));
+            }
+            if (entry.line.empty() || entry.weight == 0) {
+                return false;
+            }
+            mix.push_back(entry);
+        }
+        return !mix.empty();
+    }
+
+    bool parseArgs(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            auto value = [&arg](const char* prefix) -> const char* {
+                const std::string p(prefix);
+                return arg.rfind(p, 0) == 0 ? arg.c_str() + p.size() : nullptr;
+            };
+            if (const char* v = value("--threads=")) {
+                options.threads.clear();
+                for (const auto& t : splitList(v)) {
+                    const size_t n = std::strtoul(t.c_str(), nullptr, 10);
+                    if (n == 0) return false;
+                    options.threads.push_back(n);
+                }
+                if (options.threads.empty()) return false;
+            } else if (const char* v = value("--duration-ms=")) {
+                options.durationMs = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+            } else if (const char* v = value("--warmup-ms=")) {
+                options.warmupMs = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+            } else if (const char* v = value("--think-us=")) {
+                options.thinkUs = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+            } else if (const char* v = value("--chunk=")) {
+                const std::string c = v;
+                options.chunk = c == "line" ? 0 : c == "byte" ? 1 : std::strtoul(v, nullptr, 10);
+                if (c != "line" && options.chunk == 0) return false;
+            } else if (const char* v = value("--format=")) {
+                const std::string f = v;
+                if (f != "csv" && f != "json") return false;
+                options.json = f == "json";
+            } else if (const char* v = value("--mix=")) {
+                if (!parseMix(v, options.mix)) return false;
+            } else {
+                return false;
+            }
+        }
+        return options.durationMs != 0;
+    }
+
+    std::unique_ptr<CommandShell> makeShell()
+    {
+        auto shell = std::make_unique<CommandShell>();
+        auto ledOn = std::make_shared<std::atomic<bool>>(false);
+
+        ComponentCommands led{"led", "Demo LED"};
+        led.addCommand(CommandDetails{"on", "Turn on",
+            [ledOn](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string {
+                ledOn->store(true);
+                return "LED: ON\n";
+            }});
+        led.addCommand(CommandDetails{"off", "Turn off",
+            [ledOn](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string {
+                ledOn->store(false);
+                return "LED: OFF\n";
+            }});
+        led.addCommand(CommandDetails{"status", "Show state",
+            [ledOn](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string {
+                return ledOn->load() ? "LED: ON\n" : "LED: OFF\n";
+            }});
+        shell->registerComponent(led);
+
+        ComponentCommands sys{"sys", "Demo system commands"};
+        sys.addCommand(CommandDetails{"echo", "Echo arguments",
+            [](const std::vector<std::string>& args, const std::vector<std::string>&) -> std::string {
+                std::string out;
+                for (size_t i = 0; i < args.size(); ++i) {
+                    if (i) out += ' ';
+                    out += args[i];
+                }
+                return out + "\n";
+            }});
+        sys.addCommand(CommandDetails{"work", "Busy loop for <us> microseconds",
+            [](const std::vector<std::string>& args, const std::vector<std::string>&) -> std::string {
+                const auto us = args.empty() ? 0 : std::strtoul(args[0].c_str(), nullptr, 10);
+                const auto until = Clock::now() + std::chrono::microseconds(us);
+                while (Clock::now() < until) {
+                }
+                return "done\n";
+            }});
+        shell->registerComponent(sys);
+        return shell;
+    }
+
+    // One session: pick lines by weight, feed them in chunks, time each line
+    void runSession(CommandShell& shell, const Options& options, size_t index, Clock::time_point start,
+                    std::map<std::string, LatencyStats>& latency)
+    {
+        CommandShellIO io(shell, /*echoInput=*/false);
+        // Output is consumed but not stored, as by a fast sink
+        io.setOutputCallback([](const std::string&) {});
+
+        std::vector<std::string> lines;
+        std::vector<uint32_t> weights;
+        for (const auto& m : options.mix) {
+            lines.push_back(m.line + "\n");
+            weights.push_back(m.weight);
+        }
+        std::vector<LatencyStats*> stats;
+        for (const auto& m : options.mix) {
+            stats.push_back(&latency[m.line]);
+        }
+
+        std::mt19937 rng(static_cast<uint32_t>(index) * 7919u + 1u);
+        std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+        std::uniform_int_distribution<uint32_t> think(options.thinkUs / 2, options.thinkUs + options.thinkUs / 2);
+        const auto warmupEnd = start + std::chrono::milliseconds(options.warmupMs);
+        const auto end = warmupEnd + std::chrono::milliseconds(options.durationMs);
+
+        std::string chunk;
+        for (auto now = Clock::now(); now < end; now = Clock::now()) {
+            const size_t which = pick(rng);
+            const std::string& line = lines[which];
+            const auto begin = Clock::now();
+            if (options.chunk == 0) {
+                chunk = line;
+                io.input(chunk);
+            } else {
+                for (size_t pos = 0; pos < line.size(); pos += options.chunk) {
+                    chunk.assign(line, pos, options.chunk);
+                    io.input(chunk);
+                }
+            }
+            const auto finished = Clock::now();
+            if (begin >= warmupEnd) {
+                stats[which]->add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(finished - begin).count()));
+            }
+            if (options.thinkUs != 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(think(rng)));
+            }
+        }
+    }
+
+    RunResult runPoint(CommandShell& shell, const Options& options, size_t threads)
+    {
+        std::vector<std::map<std::string, LatencyStats>> perThread(threads);
+        std::vector<std::thread> workers;
+        const auto start = Clock::now();
+        for (size_t i = 0; i < threads; ++i) {
+            workers.emplace_back([&, i]() { runSession(shell, options, i, start, perThread[i]); });
+        }
+        for (auto& w : workers) {
+            w.join();
+        }
+
+        RunResult result;
+        result.threads = threads;
+        result.seconds = options.durationMs / 1000.0;
+        for (const auto& stats : perThread) {
+            for (const auto& kv : stats) {
+                result.latency[kv.first].merge(kv.second);
+                result.latency["all"].merge(kv.second);
+            }
+        }
+        return result;
+    }
+
+    uint64_t throughput(const LatencyStats& stats, double seconds)
+    {
+        return static_cast<uint64_t>(static_cast<double>(stats.count()) / seconds);
+    }
+
+    void writeCsv(const std::vector<RunResult>& results)
+    {
+        std::cout << "threads,command,count,throughput_per_s,p50_ns,p99_ns,p999_ns,max_ns,mean_ns\n";
+        for (const auto& r : results) {
+            for (const auto& kv : r.latency) {
+                const auto& s = kv.second;
+                std::cout << r.threads << ",\"" << kv.first << "\"," << s.count() << ',' << throughput(s, r.seconds) << ','
+                          << s.percentile(50) << ',' << s.percentile(99) << ',' << s.percentile(99.9) << ','
+                          << s.max() << ',' << static_cast<uint64_t>(s.mean()) << '\n';
+            }
+        }
+    }
+
+    void writeJson(const std::vector<RunResult>& results, const Options& options)
+    {
+        std::string out;
+        commandshell::JsonWriter w(out);
+        w.beginObject();
+        w.field("durationMs", options.durationMs);
+        w.field("thinkUs", options.thinkUs);
+        w.field("chunk", static_cast<uint64_t>(options.chunk));
+        w.key("runs");
+        w.beginArray();
+        for (const auto& r : results) {
+            w.beginObject();
+            w.field("threads", static_cast<uint64_t>(r.threads));
+            w.key("commands");
+            w.beginArray();
+            for (const auto& kv : r.latency) {
+                const auto& s = kv.second;
+                w.beginObject();
+                w.field("command", kv.first);
+                w.field("count", static_cast<uint64_t>(s.count()));
+                w.field("throughputPerSec", throughput(s, r.seconds));
+                w.field("p50Ns", s.percentile(50));
+                w.field("p99Ns", s.percentile(99));
+                w.field("p999Ns", s.percentile(99.9));
+                w.field("maxNs", s.max());
+                w.field("meanNs", static_cast<uint64_t>(s.mean()));
+                w.endObject();
+            }
+            w.endArray();
+            w.endObject();
+        }
+        w.endArray();
+        w.endObject();
+        std::cout << out << "\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+
+    // One shared registry for every point of the scaling curve
+    auto shell = makeShell();
+    std::vector<RunResult> results;
+    for (size_t threads : options.threads) {
+        results.push_back(runPoint(*shell, options, threads));
+    }
+
+    if (options.json) {
+        writeJson(results, options);
+    } else {
+        writeCsv(results);
+    }
+    return 0;
+}
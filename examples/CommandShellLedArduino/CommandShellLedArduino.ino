@@ -10,6 +10,9 @@
     - led off
     - led toggle
     - led status
+    - led blink [on_ms] [off_ms]
+    - led sweep [count]   (resumable, advanced from loop())
+    - events subscribe led.*   (push LED state changes instead of polling)
     - help
     - help led [command]
 
@@ -53,6 +56,8 @@ static std::string ledStatusText() { return gLed.statusText(); }
 static void registerLedComponent()
 {
   gShell.registerComponent(gLed.buildCommands());
+  // Subscribed sessions get these from poll(), coalesced to one per 100 ms
+  gLed.setOnChange([](const std::string& status) { gShell.publishEvent("led.state", status); });
 }
 
 void setup() {
@@ -62,8 +67,31 @@ void setup() {
   Serial.begin(BAUD_RATE, SERIAL_8N1);
   while (!Serial) { /* wait for native USB boards */ }
 
+  // Time slicing, rate limits, cache TTLs and watches use the board's microsecond
+  // timer. micros() is 32-bit and wraps every ~71.6 minutes; the shell compares
+  // timestamps, so extend it to 64 bits by counting the wraps.
+  gShell.setClock([]() -> uint64_t {
+    static uint32_t last = 0;
+    static uint64_t high = 0;
+    const uint32_t now = micros();
+    if (now < last) {
+      high += (1ULL << 32);
+    }
+    last = now;
+    return high + now;
+  });
+
   registerLedComponent();
 
+  // Keep one chatty client from starving the LED state machine:
+  // at most 20 lines/s, extra lines wait in a short queue.
+  commandshell::AdmissionPolicy admission;
+  admission.ratePerSecond = 20;
+  admission.burst = 5;
+  admission.maxQueued = 4;
+  admission.overflow = commandshell::AdmissionPolicy::Overflow::Queue;
+  gShell.setAdmissionPolicy(admission);
+
   static CommandShellIO io(gShell, /*echoInput*/ true, /*prompt*/ "cmd> ");
   gIO = &io;
   gIO->setOutputCallback(serialOut);
@@ -84,4 +112,7 @@ void loop() {
     char ch = Serial.read();
     gIO->input(&ch, 1);
   }
+
+  // Deliver events, advance resumable commands for at most ~2ms per tick, then run parked lines
+  gIO->poll(2000);
 }
@@ -1,6 +1,8 @@
 // Implementation file for LedController
 #include "LedController.hpp"
 
+#include <utility>
+
 using commandshell::ComponentCommands;
 using commandshell::CommandDetails;
 
@@ -23,11 +25,13 @@ void LedController::begin() {
 void LedController::setOn() {
   state_ = State::SteadyOn;
   setLedPinOn(pin_);
+  notifyChange();
 }
 
 void LedController::setOff() {
   state_ = State::SteadyOff;
   setLedPinOff(pin_);
+  notifyChange();
 }
 
 void LedController::toggle() {
@@ -51,6 +55,7 @@ void LedController::startBlink(unsigned long onMs, unsigned long offMs) {
   state_ = State::BlinkOn; // start with ON phase
   setLedPinOn(pin_);
   phase_started_at_ = millis();
+  notifyChange();
 }
 
 void LedController::update() {
@@ -64,6 +69,7 @@ void LedController::update() {
         state_ = State::BlinkOff;
         setLedPinOff(pin_);
         phase_started_at_ = now;
+        notifyChange();
       }
       break;
     case State::BlinkOff:
@@ -71,6 +77,7 @@ void LedController::update() {
         state_ = State::BlinkOn;
         setLedPinOn(pin_);
         phase_started_at_ = now;
+        notifyChange();
       }
       break;
   }
@@ -91,6 +98,16 @@ std::string LedController::statusText() const {
   return base + "\n";
 }
 
+void LedController::setOnChange(std::function<void(const std::string&)> onChange) {
+  on_change_ = std::move(onChange);
+}
+
+void LedController::notifyChange() {
+  if (on_change_) {
+    on_change_(statusText());
+  }
+}
+
 unsigned long LedController::elapsedSince(unsigned long start, unsigned long now) {
   return now - start; // unsigned arithmetic handles wrap-around
 }
@@ -144,6 +161,29 @@ ComponentCommands LedController::buildCommands() {
       }
   });
 
+  // Resumable: each loop() tick runs one step via CommandShellIO::poll(),
+  // so a long sweep never stalls update()
+  CommandDetails sweep{
+      "sweep",
+      "Toggle LED N times, one step per loop tick: led sweep [count]",
+      nullptr
+  };
+  sweep.resumable = [this](const std::vector<std::string>& args, const std::vector<std::string>&) -> commandshell::CommandStep {
+    unsigned long total = 20;
+    if (args.size() >= 1) {
+      total = strtoul(args[0].c_str(), nullptr, 10);
+    }
+    if (total < 1) total = 1;
+    unsigned long done = 0;
+    return [this, total, done](std::string& out) mutable -> bool {
+      this->toggle();
+      ++done;
+      out += std::string("sweep ") + std::to_string(done) + "/" + std::to_string(total) + ": " + (isOn() ? "ON" : "OFF") + "\n";
+      return done >= total;
+    };
+  };
+  led.addCommand(sweep);
+
   led.addCommand(CommandDetails{
       "status",
       "Show current LED state",
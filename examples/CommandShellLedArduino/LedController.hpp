@@ -2,6 +2,7 @@
 #pragma once
 
 #include <Arduino.h>
+#include <functional>
 #include <string>
 #include "CommandTypes.hpp"
 
@@ -31,16 +32,21 @@ public:
   State state() const;
   std::string statusText() const;
 
+  // Called with statusText() whenever the LED state changes (including blink phases)
+  void setOnChange(std::function<void(const std::string&)> onChange);
+
   // Build the CommandShell component for this LED
   commandshell::ComponentCommands buildCommands();
 
 private:
   static unsigned long elapsedSince(unsigned long start, unsigned long now);
+  void notifyChange();
 
   uint8_t pin_;
   State state_ = State::SteadyOff;
   unsigned long on_ms_ = 500;
   unsigned long off_ms_ = 500;
   unsigned long phase_started_at_ = 0;
+  std::function<void(const std::string&)> on_change_;
 };
 
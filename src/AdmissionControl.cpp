@@ -0,0 +1,42 @@
+#include "AdmissionControl.hpp"
+
+#include <algorithm>
+
+using namespace commandshell;
+
+bool TokenBucket::tryTake(const AdmissionPolicy& policy, uint64_t nowUs)
+{
+    if (policy.ratePerSecond == 0)
+    {
+        return true;
+    }
+
+    const uint64_t burst = policy.burst != 0 ? policy.burst : std::max<uint32_t>(policy.ratePerSecond, 1);
+    const uint64_t capacity = burst * kTokenScale;
+    if (!mInitialized)
+    {
+        mInitialized = true;
+        mMicroTokens = capacity;
+        mLastUs = nowUs;
+    }
+
+    if (nowUs > mLastUs)
+    {
+        // elapsed[us] * rate[tokens/s] == micro-tokens earned
+        const uint64_t earned = (nowUs - mLastUs) * policy.ratePerSecond;
+        mMicroTokens = std::min(capacity, mMicroTokens + earned);
+        mLastUs = nowUs;
+    }
+    else if (nowUs < mLastUs)
+    {
+        mLastUs = nowUs; // clock stepped back: restart the interval rather than stall
+    }
+    mMicroTokens = std::min(capacity, mMicroTokens);
+
+    if (mMicroTokens < kTokenScale)
+    {
+        return false;
+    }
+    mMicroTokens -= kTokenScale;
+    return true;
+}
@@ -0,0 +1,51 @@
+#ifndef ADMISSION_CONTROL_HPP
+#define ADMISSION_CONTROL_HPP
+
+#include <cstdint>
+
+namespace commandshell
+{
+    /* Per-session admission limits
+    *  ratePerSecond/burst form a token bucket (one token per command line);
+    *  maxInFlight caps lines the session has started and not finished: a
+    *  resumable command still being stepped, or lines a running handler fed
+    *  back as input. Parked lines do not count; maxQueued bounds those.
+    *  Zero means unlimited. When a limit is hit the overflow policy
+    *  decides what happens to the line:
+    *    Queue  - park it (up to maxQueued) and run it from CommandShellIO::poll()
+    *    Reject - answer with an error
+    *    Drop   - discard silently
+    */
+    struct AdmissionPolicy
+    {
+        enum class Overflow { Queue, Reject, Drop };
+        uint32_t ratePerSecond = 0;
+        uint32_t burst = 0; // defaults to ratePerSecond (at least 1) when 0
+        uint32_t maxInFlight = 0;
+        uint32_t maxQueued = 16;
+        Overflow overflow = Overflow::Reject;
+    };
+
+    struct AdmissionStats
+    {
+        uint64_t admitted = 0;
+        uint64_t queued = 0;
+        uint64_t rejected = 0;
+        uint64_t dropped = 0;
+    };
+
+    // Token bucket with integer micro-token arithmetic
+    class TokenBucket
+    {
+    public:
+        // Take one token if available at nowUs under policy
+        bool tryTake(const AdmissionPolicy& policy, uint64_t nowUs);
+
+    private:
+        static constexpr uint64_t kTokenScale = 1000000; // micro-tokens per token
+        bool mInitialized = false;
+        uint64_t mMicroTokens = 0;
+        uint64_t mLastUs = 0;
+    };
+} // namespace commandshell
+#endif // ADMISSION_CONTROL_HPP
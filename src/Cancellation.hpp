@@ -0,0 +1,78 @@
+#ifndef CANCELLATION_HPP
+#define CANCELLATION_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace commandshell
+{
+    /* Cooperative cancellation for handlers that opt in
+    *  Copies share state. A token reports cancelled once cancel() was called or
+    *  its deadline has passed, measured on the clock it was created with (the
+    *  steady clock by default); long-running handlers should check
+    *  isCancelled() between units of work and return early.
+    */
+    class CancellationToken
+    {
+    public:
+        // Token that never cancels
+        CancellationToken() = default;
+
+        // clock returns microseconds (e.g. CommandShell::setClock's); it is called
+        // from whichever thread checks the token
+        static CancellationToken withDeadline(uint32_t timeoutMs, std::function<uint64_t()> clock = {})
+        {
+            CancellationToken token;
+            token.mState = std::make_shared<State>();
+            token.mState->clock = std::move(clock);
+            token.mState->deadlineUs = token.now() + static_cast<uint64_t>(timeoutMs) * 1000u;
+            return token;
+        }
+
+        bool isCancelled() const
+        {
+            if (!mState)
+            {
+                return false;
+            }
+            if (mState->cancelled.load(std::memory_order_relaxed))
+            {
+                return true;
+            }
+            return mState->deadlineUs != 0 && now() >= mState->deadlineUs;
+        }
+
+        void cancel() const
+        {
+            if (mState)
+            {
+                mState->cancelled.store(true, std::memory_order_relaxed);
+            }
+        }
+
+        // Absolute deadline in microseconds on the token's clock, 0 when none
+        uint64_t deadlineUs() const { return mState ? mState->deadlineUs : 0; }
+
+        // Current time on the token's clock
+        uint64_t now() const { return mState && mState->clock ? mState->clock() : steadyMicros(); }
+
+        static uint64_t steadyMicros()
+        {
+            using namespace std::chrono;
+            return static_cast<uint64_t>(duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count());
+        }
+
+    private:
+        struct State
+        {
+            std::atomic<bool> cancelled{false};
+            uint64_t deadlineUs = 0;
+            std::function<uint64_t()> clock;
+        };
+        std::shared_ptr<State> mState;
+    };
+} // namespace commandshell
+#endif // CANCELLATION_HPP
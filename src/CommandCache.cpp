@@ -0,0 +1,161 @@
+#include "CommandCache.hpp"
+
+#include <algorithm>
+#include <vector>
+
+using namespace commandshell;
+
+CommandCache::CommandCache(size_t maxEntries, size_t maxBytes)
+    : mMaxEntries(maxEntries), mMaxBytes(maxBytes) {}
+
+void CommandCache::setLimits(size_t maxEntries, size_t maxBytes)
+{
+    detail::Lock lock(mMutex);
+    mMaxEntries = maxEntries;
+    mMaxBytes = maxBytes;
+    evictToLimits();
+}
+
+std::optional<std::string> CommandCache::lookup(const std::string& key, uint64_t nowUs)
+{
+    detail::Lock lock(mMutex);
+    auto it = mIndex.find(key);
+    if (it == mIndex.end())
+    {
+        ++mStats.misses;
+        return std::nullopt;
+    }
+
+    auto entryIt = it->second;
+    if (entryIt->expiresAtUs != 0 && nowUs >= entryIt->expiresAtUs)
+    {
+        erase(entryIt);
+        ++mStats.misses;
+        return std::nullopt;
+    }
+
+    // Move to front to mark as most recently used
+    mEntries.splice(mEntries.begin(), mEntries, entryIt);
+    ++mStats.hits;
+    return entryIt->output;
+}
+
+void CommandCache::store(const std::string& key, const Command& command, const std::string& output, uint64_t expiresAtUs)
+{
+    detail::Lock lock(mMutex);
+    auto it = mIndex.find(key);
+    if (it != mIndex.end())
+    {
+        erase(it->second);
+    }
+
+    Entry entry{key, command.component, command.command, output, expiresAtUs};
+    if (mMaxEntries == 0 || entryBytes(entry) > mMaxBytes)
+    {
+        return; // would never fit
+    }
+
+    mEntries.push_front(std::move(entry));
+    mIndex.emplace(mEntries.front().key, mEntries.begin());
+    mStats.bytes += entryBytes(mEntries.front());
+    evictToLimits();
+}
+
+void CommandCache::invalidate()
+{
+    detail::Lock lock(mMutex);
+    mStats.invalidations += mEntries.size();
+    mIndex.clear();
+    mEntries.clear();
+    mStats.bytes = 0;
+}
+
+void CommandCache::invalidate(const std::string& component)
+{
+    detail::Lock lock(mMutex);
+    for (auto it = mEntries.begin(); it != mEntries.end();)
+    {
+        auto next = std::next(it);
+        if (it->component == component)
+        {
+            erase(it);
+            ++mStats.invalidations;
+        }
+        it = next;
+    }
+}
+
+void CommandCache::invalidate(const std::string& component, const std::string& command)
+{
+    detail::Lock lock(mMutex);
+    for (auto it = mEntries.begin(); it != mEntries.end();)
+    {
+        auto next = std::next(it);
+        if (it->component == component && it->command == command)
+        {
+            erase(it);
+            ++mStats.invalidations;
+        }
+        it = next;
+    }
+}
+
+CommandCache::Stats CommandCache::stats() const
+{
+    detail::Lock lock(mMutex);
+    Stats s = mStats;
+    s.entries = mEntries.size();
+    return s;
+}
+
+std::string CommandCache::makeKey(const Command& command)
+{
+    // Every field is length-prefixed ("<len>:<bytes>"), and the argument count
+    // separates arguments from options, so no argument bytes can forge a boundary
+    std::string key;
+    auto field = [&key](const std::string& value) {
+        key += std::to_string(value.size());
+        key += ':';
+        key += value;
+    };
+    field(command.component);
+    field(command.command);
+    key += std::to_string(command.arguments.size());
+    key += '#';
+    for (const auto& arg : command.arguments)
+    {
+        field(arg);
+    }
+
+    std::vector<std::string> opts(command.options);
+    std::sort(opts.begin(), opts.end());
+    opts.erase(std::unique(opts.begin(), opts.end()), opts.end());
+    for (const auto& opt : opts)
+    {
+        field(opt);
+    }
+    return key;
+}
+
+/******************** Private methods *******************/
+
+size_t CommandCache::entryBytes(const Entry& e)
+{
+    return e.key.size() + e.component.size() + e.command.size() + e.output.size();
+}
+
+void CommandCache::erase(EntryList::iterator it)
+{
+    mStats.bytes -= entryBytes(*it);
+    mIndex.erase(it->key);
+    mEntries.erase(it);
+}
+
+void CommandCache::evictToLimits()
+{
+    while (!mEntries.empty() && (mEntries.size() > mMaxEntries || mStats.bytes > mMaxBytes))
+    {
+        erase(std::prev(mEntries.end()));
+        ++mStats.evictions;
+    }
+}
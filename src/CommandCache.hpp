@@ -0,0 +1,73 @@
+#ifndef COMMAND_CACHE_HPP
+#define COMMAND_CACHE_HPP
+
+#include <cstdint>
+#include <list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "CommandShellConfig.hpp"
+#include "CommandTypes.hpp"
+
+namespace commandshell
+{
+    // Bounded LRU store of memoized command outputs
+    class CommandCache
+    {
+    public:
+        struct Stats
+        {
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t evictions = 0;
+            uint64_t invalidations = 0;
+            size_t entries = 0;
+            size_t bytes = 0;
+        };
+
+        explicit CommandCache(size_t maxEntries = 32, size_t maxBytes = 8192);
+
+        // Change the bounds; evicts immediately if the cache is over the new limits
+        void setLimits(size_t maxEntries, size_t maxBytes);
+
+        // Returns the cached output for key if present and not expired
+        std::optional<std::string> lookup(const std::string& key, uint64_t nowUs);
+
+        // Store output under key; expiresAtUs == 0 means no expiry
+        void store(const std::string& key, const Command& command, const std::string& output, uint64_t expiresAtUs);
+
+        // Drop all entries, all entries of a component, or of a single command
+        void invalidate();
+        void invalidate(const std::string& component);
+        void invalidate(const std::string& component, const std::string& command);
+
+        Stats stats() const;
+
+        // Key from component, command, arguments in order and sorted unique options
+        static std::string makeKey(const Command& command);
+
+    private:
+        struct Entry
+        {
+            std::string key;
+            std::string component;
+            std::string command;
+            std::string output;
+            uint64_t expiresAtUs;
+        };
+        using EntryList = std::list<Entry>;
+
+        static size_t entryBytes(const Entry& e);
+        void erase(EntryList::iterator it);
+        void evictToLimits();
+
+        size_t mMaxEntries;
+        size_t mMaxBytes;
+        EntryList mEntries; // most recently used first
+        std::unordered_map<std::string_view, EntryList::iterator> mIndex;
+        Stats mStats;
+        mutable detail::Mutex mMutex;
+    };
+} // namespace commandshell
+#endif // COMMAND_CACHE_HPP
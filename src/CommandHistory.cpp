@@ -0,0 +1,227 @@
+#include "CommandHistory.hpp"
+
+#include <cstring>
+
+using namespace commandshell;
+
+namespace {
+    // FNV-1a; only used to skip byte comparisons against unrelated lines
+    uint32_t hashOf(std::string_view line)
+    {
+        uint32_t hash = 2166136261u;
+        for (char c : line)
+        {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+        }
+        return hash;
+    }
+}
+
+CommandHistory::CommandHistory(size_t capacityBytes, size_t maxEntries)
+{
+    configure(capacityBytes, maxEntries);
+}
+
+void CommandHistory::configure(size_t capacityBytes, size_t maxEntries)
+{
+    mArena.assign(capacityBytes, '\0');
+    mArena.shrink_to_fit();
+    mLines.assign(maxEntries, Line{0, 0, 0, kNone});
+    mLines.shrink_to_fit();
+    mEntries.assign(maxEntries, Entry{kNone});
+    mEntries.shrink_to_fit();
+    clear();
+}
+
+void CommandHistory::push(std::string_view line)
+{
+    if (line.empty() || line.size() > mArena.size() || mEntries.empty())
+    {
+        return;
+    }
+    if (mCount != 0 && at(0) == line)
+    {
+        return; // same as the newest entry
+    }
+
+    if (mSlots == mEntries.size())
+    {
+        dropOldest();
+    }
+    const uint32_t hash = hashOf(line);
+    if (auto existing = findLine(line, hash))
+    {
+        // Already stored: the entry moves to newest and keeps its bytes
+        mEntries[mLines[*existing].slot].line = kNone;
+        --mCount;
+        skipEmptySlots();
+        appendEntry(*existing);
+        return;
+    }
+    appendEntry(storeLine(line, hash));
+}
+
+void CommandHistory::clear()
+{
+    mLineHead = 0;
+    mLineCount = 0;
+    mHead = 0;
+    mSlots = 0;
+    mCount = 0;
+}
+
+std::string_view CommandHistory::at(size_t age) const
+{
+    for (size_t i = mSlots; i-- > 0;)
+    {
+        const auto& e = mEntries[(mHead + i) % mEntries.size()];
+        if (e.line != kNone && age-- == 0)
+        {
+            const auto& l = mLines[e.line];
+            return std::string_view(mArena.data() + l.offset, l.length);
+        }
+    }
+    return std::string_view{};
+}
+
+std::optional<size_t> CommandHistory::searchOlder(std::string_view needle, size_t fromAge) const
+{
+    size_t age = 0;
+    for (size_t i = mSlots; i-- > 0;)
+    {
+        const auto& e = mEntries[(mHead + i) % mEntries.size()];
+        if (e.line == kNone)
+        {
+            continue;
+        }
+        const auto& l = mLines[e.line];
+        if (age >= fromAge && std::string_view(mArena.data() + l.offset, l.length).find(needle) != std::string_view::npos)
+        {
+            return age;
+        }
+        ++age;
+    }
+    return std::nullopt;
+}
+
+size_t CommandHistory::memoryFootprint() const
+{
+    return mArena.capacity() + mLines.capacity() * sizeof(Line) + mEntries.capacity() * sizeof(Entry);
+}
+
+/******************** Private methods *******************/
+
+std::optional<size_t> CommandHistory::findLine(std::string_view line, uint32_t hash) const
+{
+    for (size_t i = 0; i < mLineCount; ++i)
+    {
+        const size_t index = (mLineHead + i) % mLines.size();
+        const auto& l = mLines[index];
+        if (l.slot != kNone && l.hash == hash && l.length == line.size()
+            && std::memcmp(mArena.data() + l.offset, line.data(), line.size()) == 0)
+        {
+            return index;
+        }
+    }
+    return std::nullopt;
+}
+
+size_t CommandHistory::storeLine(std::string_view line, uint32_t hash)
+{
+    std::optional<size_t> offset;
+    while (mLineCount == mLines.size() || !(offset = freeOffset(line.size())))
+    {
+        reclaim();
+    }
+    std::memcpy(mArena.data() + *offset, line.data(), line.size());
+    const size_t index = (mLineHead + mLineCount) % mLines.size();
+    mLines[index] = Line{static_cast<uint32_t>(*offset), static_cast<uint32_t>(line.size()), hash, kNone};
+    ++mLineCount;
+    return index;
+}
+
+std::optional<size_t> CommandHistory::freeOffset(size_t length) const
+{
+    if (mLineCount == 0)
+    {
+        return 0;
+    }
+    // Live bytes run from the head record to the end of the newest, possibly wrapping
+    const auto& newest = mLines[(mLineHead + mLineCount - 1) % mLines.size()];
+    const size_t begin = mLines[mLineHead].offset;
+    const size_t end = newest.offset + newest.length;
+    if (newest.offset >= begin)
+    {
+        // [begin, end) is live: use the tail, else wrap to the front
+        if (end + length <= mArena.size()) return end;
+        if (length <= begin) return 0;
+        return std::nullopt;
+    }
+    // Wrapped: [end, begin) is free
+    if (end + length <= begin) return end;
+    return std::nullopt;
+}
+
+void CommandHistory::reclaim()
+{
+    const Line head = mLines[mLineHead];
+    if (head.slot == kNone)
+    {
+        mLineHead = (mLineHead + 1) % mLines.size();
+        --mLineCount;
+        return;
+    }
+    // A moved line at the head: slide its bytes to the end of a freed record
+    // right behind it, which then becomes the head and frees the bytes before it
+    if (mLineCount > 1)
+    {
+        const size_t nextIndex = (mLineHead + 1) % mLines.size();
+        const Line next = mLines[nextIndex];
+        // After a wrap the freed record starts at 0 and must be at least as long
+        if (next.slot == kNone && (next.offset > head.offset || next.length >= head.length))
+        {
+            const size_t offset = next.offset + next.length - head.length;
+            std::memmove(mArena.data() + offset, mArena.data() + head.offset, head.length);
+            mLines[nextIndex] = Line{static_cast<uint32_t>(offset), head.length, head.hash, head.slot};
+            mEntries[head.slot].line = static_cast<uint32_t>(nextIndex);
+            mLineHead = nextIndex;
+            --mLineCount;
+            return;
+        }
+    }
+    dropOldest();
+}
+
+void CommandHistory::appendEntry(size_t line)
+{
+    const size_t slot = (mHead + mSlots) % mEntries.size();
+    mEntries[slot].line = static_cast<uint32_t>(line);
+    mLines[line].slot = static_cast<uint32_t>(slot);
+    ++mSlots;
+    ++mCount;
+}
+
+void CommandHistory::dropOldest()
+{
+    if (mSlots == 0)
+    {
+        return;
+    }
+    auto& e = mEntries[mHead];
+    if (e.line != kNone)
+    {
+        mLines[e.line].slot = kNone;
+        --mCount;
+        e.line = kNone;
+    }
+    skipEmptySlots();
+}
+
+void CommandHistory::skipEmptySlots()
+{
+    while (mSlots != 0 && mEntries[mHead].line == kNone)
+    {
+        mHead = (mHead + 1) % mEntries.size();
+        --mSlots;
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef COMMAND_HISTORY_HPP
+#define COMMAND_HISTORY_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace commandshell
+{
+    /* Fixed-size command history
+    *  Line bytes live in a ring arena of capacityBytes, described by a ring of
+    *  maxEntries line records in arena order; entries (newest-first recall
+    *  order) live in a ring table of maxEntries slots that point at records.
+    *  Push and eviction only move head/tail indices. A line is kept contiguous:
+    *  if it does not fit before the end of the arena it starts again at offset 0.
+    *  Lines are interned: re-entering any stored line moves its entry to newest
+    *  and reuses its bytes (the old slot is left empty), so history never holds
+    *  a line twice. Oldest entries are evicted when the arena, the records or
+    *  the table are full; a moved line whose bytes reach the front of the arena
+    *  slides over freed bytes behind it instead of being evicted.
+    */
+    class CommandHistory
+    {
+    public:
+        explicit CommandHistory(size_t capacityBytes = 1024, size_t maxEntries = 32);
+
+        // Reconfigure the footprint; clears the history
+        void configure(size_t capacityBytes, size_t maxEntries);
+
+        // Add a line as the newest entry (empty lines are ignored)
+        void push(std::string_view line);
+
+        void clear();
+        size_t size() const { return mCount; }
+        bool empty() const { return mCount == 0; }
+
+        // Entry by age: 0 is the newest
+        std::string_view at(size_t age) const;
+
+        // Newest entry at age >= fromAge containing needle
+        std::optional<size_t> searchOlder(std::string_view needle, size_t fromAge = 0) const;
+
+        // Bytes reserved by the arena and entry table
+        size_t memoryFootprint() const;
+
+    private:
+        static constexpr uint32_t kNone = UINT32_MAX;
+
+        struct Line
+        {
+            uint32_t offset;
+            uint32_t length;
+            uint32_t hash;
+            uint32_t slot; // table slot of the entry using it, kNone once evicted
+        };
+
+        struct Entry
+        {
+            uint32_t line; // record index, kNone for a slot left by a moved line
+        };
+
+        std::optional<size_t> findLine(std::string_view line, uint32_t hash) const;
+        size_t storeLine(std::string_view line, uint32_t hash);
+        // Arena offset where a line of `length` bytes fits without overwriting live records
+        std::optional<size_t> freeOffset(size_t length) const;
+        // One step towards room for a new line: drop a freed record, slide a
+        // live one over freed bytes, or evict the oldest entry
+        void reclaim();
+        void appendEntry(size_t line);
+        void dropOldest();
+        void skipEmptySlots();
+
+        std::vector<char> mArena;
+        std::vector<Line> mLines;    // ring of maxEntries records, oldest bytes first
+        size_t mLineHead = 0;
+        size_t mLineCount = 0;
+        std::vector<Entry> mEntries; // ring of maxEntries slots, oldest first
+        size_t mHead = 0;  // slot of the oldest entry
+        size_t mSlots = 0; // slots in use, including empty ones
+        size_t mCount = 0; // entries
+    };
+} // namespace commandshell
+#endif // COMMAND_HISTORY_HPP
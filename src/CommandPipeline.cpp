@@ -0,0 +1,182 @@
+#include "CommandPipeline.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+using namespace commandshell;
+
+namespace {
+    std::string_view stripNewline(std::string_view line)
+    {
+        while (!line.empty() && (line.back() == '\n' || line.back() == '\r'))
+        {
+            line.remove_suffix(1);
+        }
+        return line;
+    }
+
+    bool containsIgnoreCase(std::string_view haystack, std::string_view needle)
+    {
+        auto it = std::search(haystack.begin(), haystack.end(), needle.begin(), needle.end(),
+            [](char a, char b) {
+                return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+            });
+        return it != haystack.end();
+    }
+
+    bool hasOption(const PipelineStage& stage, const char* shortOpt, const char* longOpt)
+    {
+        for (const auto& o : stage.options)
+        {
+            if (o == shortOpt || o == longOpt) return true;
+        }
+        return false;
+    }
+
+    // grep [-v] [-i] <pattern>: substring match per line
+    class GrepFilter : public LineSink
+    {
+    public:
+        GrepFilter(LineSink& down, std::string pattern, bool invert, bool ignoreCase)
+            : mDown(down), mPattern(std::move(pattern)), mInvert(invert), mIgnoreCase(ignoreCase) {}
+
+        bool writeLine(std::string_view line) override
+        {
+            auto text = stripNewline(line);
+            bool match = mIgnoreCase ? containsIgnoreCase(text, mPattern)
+                                     : text.find(mPattern) != std::string_view::npos;
+            if (match == mInvert) return true;
+            return mDown.writeLine(line);
+        }
+        void finish() override { mDown.finish(); }
+
+    private:
+        LineSink& mDown;
+        std::string mPattern;
+        bool mInvert;
+        bool mIgnoreCase;
+    };
+
+    // head [N | -N | -n N]: first N lines (default 10), then stops the producer
+    class HeadFilter : public LineSink
+    {
+    public:
+        HeadFilter(LineSink& down, unsigned long limit) : mDown(down), mRemaining(limit) {}
+
+        bool writeLine(std::string_view line) override
+        {
+            if (mRemaining == 0) return false;
+            --mRemaining;
+            return mDown.writeLine(line) && mRemaining > 0;
+        }
+        void finish() override { mDown.finish(); }
+
+    private:
+        LineSink& mDown;
+        unsigned long mRemaining;
+    };
+
+    // count: number of lines
+    class CountFilter : public LineSink
+    {
+    public:
+        explicit CountFilter(LineSink& down) : mDown(down) {}
+
+        bool writeLine(std::string_view) override
+        {
+            ++mCount;
+            return true;
+        }
+        void finish() override
+        {
+            auto text = std::to_string(mCount) + "\n";
+            mDown.writeLine(text);
+            mDown.finish();
+        }
+
+    private:
+        LineSink& mDown;
+        unsigned long mCount = 0;
+    };
+}
+
+bool commandshell::writeLines(std::string_view text, LineSink& sink)
+{
+    size_t start = 0;
+    while (start < text.size())
+    {
+        size_t eol = text.find('\n', start);
+        size_t end = (eol == std::string_view::npos) ? text.size() : eol + 1;
+        if (!sink.writeLine(text.substr(start, end - start)))
+        {
+            return false;
+        }
+        start = end;
+    }
+    return true;
+}
+
+std::vector<FilterDetails> commandshell::builtinFilters()
+{
+    std::vector<FilterDetails> filters;
+    filters.push_back(FilterDetails{
+        "grep",
+        "Keep lines containing a pattern: grep [-v] [-i] <pattern>",
+        [](const PipelineStage& stage, LineSink& down, std::string& error) -> std::unique_ptr<LineSink> {
+            if (stage.arguments.empty())
+            {
+                error = "Error: grep requires a pattern\n";
+                return nullptr;
+            }
+            return std::make_unique<GrepFilter>(down, stage.arguments[0],
+                hasOption(stage, "-v", "--invert-match"), hasOption(stage, "-i", "--ignore-case"));
+        }
+    });
+    filters.push_back(FilterDetails{
+        "head",
+        "Keep the first N lines: head [N | -N | -n N] (default 10)",
+        [](const PipelineStage& stage, LineSink& down, std::string& error) -> std::unique_ptr<LineSink> {
+            unsigned long limit = 10;
+            std::string count;
+            for (const auto& o : stage.options)
+            {
+                // `-n N` takes its count from the argument; `-N` carries it inline
+                if (o == "-n" || o == "--lines")
+                {
+                    continue;
+                }
+                if (o.size() < 2 || o[1] == '-' || !std::all_of(o.begin() + 1, o.end(),
+                        [](char c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; }))
+                {
+                    error = "Error: head: unknown option '" + o + "'\n";
+                    return nullptr;
+                }
+                count = o.substr(1);
+            }
+            if (!stage.arguments.empty())
+            {
+                count = stage.arguments[0];
+            }
+            if (!count.empty())
+            {
+                char* end = nullptr;
+                limit = std::strtoul(count.c_str(), &end, 10);
+                if (count.empty() || count[0] == '-' || *end != '\0')
+                {
+                    error = "Error: head count must be a number: '" + count + "'\n";
+                    return nullptr;
+                }
+            }
+            return std::make_unique<HeadFilter>(down, limit);
+        }
+    });
+    filters.push_back(FilterDetails{
+        "count",
+        "Print the number of lines",
+        [](const PipelineStage&, LineSink& down, std::string&) -> std::unique_ptr<LineSink> {
+            return std::make_unique<CountFilter>(down);
+        }
+    });
+    return filters;
+}
@@ -0,0 +1,65 @@
+#ifndef COMMAND_PIPELINE_HPP
+#define COMMAND_PIPELINE_HPP
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace commandshell
+{
+    /* Line-oriented stream between pipeline stages
+    *  Each call receives one line including its trailing '\n' (the last line of
+    *  an output may lack it). Returning false tells the producer to stop early.
+    */
+    class LineSink
+    {
+    public:
+        virtual ~LineSink() = default;
+        virtual bool writeLine(std::string_view line) = 0;
+        // Called once after the producer is done
+        virtual void finish() {}
+    };
+
+    // Sink that appends everything to a string (end of a pipeline)
+    class StringLineSink : public LineSink
+    {
+    public:
+        explicit StringLineSink(std::string& out) : mOut(out) {}
+        bool writeLine(std::string_view line) override
+        {
+            mOut.append(line.data(), line.size());
+            return true;
+        }
+
+    private:
+        std::string& mOut;
+    };
+
+    // Split text into lines and push them to sink until it asks to stop
+    bool writeLines(std::string_view text, LineSink& sink);
+
+    // One `| name args...` stage of a pipeline
+    struct PipelineStage
+    {
+        std::string name;
+        std::vector<std::string> arguments;
+        std::vector<std::string> options;
+    };
+
+    /* Filter usable after `|`
+    *  create() builds a stage that forwards lines to downstream. On invalid
+    *  arguments it returns nullptr and sets error.
+    */
+    struct FilterDetails
+    {
+        const std::string name;
+        const std::string description;
+        std::function<std::unique_ptr<LineSink>(const PipelineStage& stage, LineSink& downstream, std::string& error)> create;
+    };
+
+    // Built-in filters: grep, head, count
+    std::vector<FilterDetails> builtinFilters();
+} // namespace commandshell
+#endif // COMMAND_PIPELINE_HPP
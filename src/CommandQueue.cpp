@@ -0,0 +1,246 @@
+#include "CommandQueue.hpp"
+#include "CommandShell.hpp"
+
+#include <chrono>
+#include <utility>
+
+using namespace commandshell;
+
+namespace {
+    // Producers stamp submissions without going through the shell's clock callback
+    uint64_t steadyMicros()
+    {
+        using namespace std::chrono;
+        return static_cast<uint64_t>(duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count());
+    }
+
+#if COMMANDSHELL_THREADS
+    // Producers notify without the wake mutex, so a notify can land just before
+    // the executor waits; it then picks the command up after this long at most
+    constexpr auto kWakeBackstop = std::chrono::milliseconds(2);
+#endif
+}
+
+CommandQueue::CommandQueue(CommandShell& shell, size_t capacity)
+    : mShell(shell)
+    , mCapacity(capacity)
+{
+    for (auto& lane : mLanes)
+    {
+        lane.reset(new MpscQueue<Item>(capacity));
+    }
+}
+
+CommandQueue::~CommandQueue()
+{
+#if COMMANDSHELL_THREADS
+    stop();
+#endif
+}
+
+CommandQueue::ProducerId CommandQueue::addProducer(ReplySink sink, CommandPriority lane)
+{
+    mProducers.push_back(Producer{std::move(sink), lane});
+    return static_cast<ProducerId>(mProducers.size() - 1);
+}
+
+void CommandQueue::setStarvationLimit(uint32_t limit)
+{
+    mStarvationLimit = limit == 0 ? 1 : limit;
+}
+
+CommandPriority CommandQueue::laneFor(ProducerId producer, const Command& command) const
+{
+    const CommandPriority fallback = producer < mProducers.size() ? mProducers[producer].lane : CommandPriority::Normal;
+    return mShell.commandPriority(command).value_or(fallback);
+}
+
+bool CommandQueue::submit(ProducerId producer, Command command)
+{
+    const CommandPriority lane = producer < mProducers.size() ? mProducers[producer].lane : CommandPriority::Normal;
+    return push(producer, std::move(command), lane, true);
+}
+
+bool CommandQueue::submit(ProducerId producer, Command command, CommandPriority lane)
+{
+    return push(producer, std::move(command), lane, false);
+}
+
+bool CommandQueue::push(ProducerId producer, Command command, CommandPriority priority, bool resolve)
+{
+    const auto lane = static_cast<size_t>(priority);
+    if (producer >= mProducers.size() || lane >= kLanes)
+    {
+        mRejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (!mLanes[lane]->tryPush(Item{producer, steadyMicros(), resolve, lane, std::move(command)}))
+    {
+        mRejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    mSubmitted.fetch_add(1, std::memory_order_relaxed);
+#if COMMANDSHELL_THREADS
+    // Dekker handshake with runExecutor: both sides store, fence, then load, so
+    // either the executor sees this command before sleeping or this sees mIdle
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (mIdle.load(std::memory_order_seq_cst))
+    {
+        mWake.notify_one();
+    }
+#endif
+    return true;
+}
+
+size_t CommandQueue::drain(size_t maxCommands)
+{
+    size_t ran = 0;
+    Item item;
+    size_t lane = 0;
+    while (ran < maxCommands && popNext(item, lane))
+    {
+        auto reply = mShell.executeCommand(item.command);
+        const auto& sink = mProducers[item.producer].sink;
+        if (sink)
+        {
+            sink(reply);
+        }
+        {
+            detail::Lock lock(mLatencyMutex);
+            mLatency[lane].add(steadyMicros() - item.submittedUs);
+        }
+        mExecuted.fetch_add(1, std::memory_order_relaxed);
+        ++ran;
+    }
+    return ran;
+}
+
+LatencyHistogram CommandQueue::laneLatency(CommandPriority lane) const
+{
+    detail::Lock lock(mLatencyMutex);
+    return mLatency[static_cast<size_t>(lane)];
+}
+
+void CommandQueue::takeIn()
+{
+    // Each intake lane may have up to capacity commands waiting on this side,
+    // so a full ready lane still pushes back on that lane's producers
+    for (size_t l = kLanes; l-- > 0;)
+    {
+        Item item;
+        while (mTakenIn[l] < mCapacity && mLanes[l]->tryPop(item))
+        {
+            size_t lane = l;
+            if (item.resolve)
+            {
+                lane = static_cast<size_t>(mShell.commandPriority(item.command).value_or(static_cast<CommandPriority>(l)));
+            }
+            mReady[lane].push_back(std::move(item));
+            ++mTakenIn[l];
+        }
+    }
+}
+
+bool CommandQueue::popNext(Item& item, size_t& lane)
+{
+    takeIn();
+
+    // A lane that has waited long enough goes first (the most passed-over one)
+    size_t starved = kLanes;
+    for (size_t l = 0; l < kLanes; ++l)
+    {
+        if (mPassedOver[l] >= mStarvationLimit && (starved == kLanes || mPassedOver[l] > mPassedOver[starved]))
+        {
+            starved = l;
+        }
+    }
+    lane = starved;
+    if (lane == kLanes || mReady[lane].empty())
+    {
+        lane = kLanes;
+        for (size_t l = kLanes; l-- > 0;)
+        {
+            if (!mReady[l].empty())
+            {
+                lane = l;
+                break;
+            }
+        }
+        if (lane == kLanes)
+        {
+            return false;
+        }
+    }
+    item = std::move(mReady[lane].front());
+    mReady[lane].pop_front();
+    --mTakenIn[item.intake];
+
+    mPassedOver[lane] = 0;
+    for (size_t l = 0; l < lane; ++l)
+    {
+        mPassedOver[l] = mReady[l].empty() ? 0 : mPassedOver[l] + 1;
+    }
+    return true;
+}
+
+CommandQueue::Stats CommandQueue::stats() const
+{
+    Stats s;
+    s.submitted = mSubmitted.load(std::memory_order_relaxed);
+    s.rejected = mRejected.load(std::memory_order_relaxed);
+    s.executed = mExecuted.load(std::memory_order_relaxed);
+    return s;
+}
+
+bool CommandQueue::allLanesEmpty() const
+{
+    for (size_t l = 0; l < kLanes; ++l)
+    {
+        if (!mLanes[l]->empty() || !mReady[l].empty()) return false;
+    }
+    return true;
+}
+
+#if COMMANDSHELL_THREADS
+void CommandQueue::start()
+{
+    if (mRunning.exchange(true))
+    {
+        return;
+    }
+    mExecutor = std::thread([this]() { runExecutor(); });
+}
+
+void CommandQueue::stop()
+{
+    if (!mRunning.exchange(false))
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mWakeMutex);
+    }
+    mWake.notify_one();
+    mExecutor.join();
+    drain(); // commands that raced with stop()
+}
+
+void CommandQueue::runExecutor()
+{
+    while (mRunning.load(std::memory_order_acquire))
+    {
+        if (drain() != 0)
+        {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mWakeMutex);
+        mIdle.store(true, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // A push that raced with the drain above is seen by the predicate; any
+        // later one sees mIdle and notifies, or is caught by the backstop
+        mWake.wait_for(lock, kWakeBackstop,
+            [this]() { return !mRunning.load(std::memory_order_acquire) || !allLanesEmpty(); });
+        mIdle.store(false, std::memory_order_relaxed);
+    }
+}
+#endif
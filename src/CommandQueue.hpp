@@ -0,0 +1,143 @@
+#ifndef COMMAND_QUEUE_HPP
+#define COMMAND_QUEUE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "CommandShellConfig.hpp"
+#include "CommandTypes.hpp"
+#include "LatencyStats.hpp"
+#include "MpscQueue.hpp"
+
+#if COMMANDSHELL_THREADS
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace commandshell
+{
+    class CommandShell;
+
+    /* Command intake for several producers feeding one executor
+    *  Producers (UART RX, network, timer callbacks) submit parsed commands
+    *  without taking a lock; a full queue rejects the command instead of
+    *  blocking. A single consumer - drain() from the main loop, or the
+    *  executor thread started with start() - runs the commands and
+    *  hands each reply to the sink of the producer that submitted it.
+    *
+    *  Commands are sorted into priority lanes: CommandDetails::priority when
+    *  declared, else the producer's lane. Producers only push into their own
+    *  lane; the consumer looks up declared priorities as it takes commands
+    *  in. It always serves the highest non-empty lane, except that a waiting
+    *  lane passed over starvationLimit times in a row gets the next turn.
+    *
+    *  Usage:
+    *    CommandQueue queue(shell, 64);
+    *    auto uart = queue.addProducer([](const std::string& r) { uartWrite(r); });
+    *    queue.submit(uart, command);   // from any thread
+    *    queue.drain();                 // from the loop (or queue.start())
+    */
+    class CommandQueue
+    {
+    public:
+        using ProducerId = uint32_t;
+        using ReplySink = std::function<void(const std::string&)>;
+
+        struct Stats
+        {
+            uint64_t submitted = 0;
+            uint64_t rejected = 0; // queue full or unknown producer
+            uint64_t executed = 0;
+        };
+
+        static constexpr size_t kLanes = 3;
+
+        // capacity is per lane
+        CommandQueue(CommandShell& shell, size_t capacity);
+        ~CommandQueue();
+
+        CommandQueue(const CommandQueue&) = delete;
+        CommandQueue& operator=(const CommandQueue&) = delete;
+
+        // Setup only (before producers start): register a reply sink. Sinks run on
+        // the consumer, so they must be safe to call from there.
+        ProducerId addProducer(ReplySink sink, CommandPriority lane = CommandPriority::Normal);
+
+        // Setup only: how often a waiting lane may be passed over (at least 1)
+        void setStarvationLimit(uint32_t limit);
+
+        // Any thread, lock-free. False when the producer's lane is full. The
+        // consumer moves the command to its declared lane, if any.
+        bool submit(ProducerId producer, Command command);
+
+        // Same, into a lane chosen by the caller (e.g. resolved once by laneFor());
+        // the consumer keeps the command in that lane
+        bool submit(ProducerId producer, Command command, CommandPriority lane);
+        CommandPriority laneFor(ProducerId producer, const Command& command) const;
+
+        // Consumer: run up to maxCommands queued commands; returns how many ran
+        size_t drain(size_t maxCommands = static_cast<size_t>(-1));
+
+#if COMMANDSHELL_THREADS
+        // Run the consumer on a dedicated thread; do not call drain() meanwhile.
+        // stop() finishes the commands already queued.
+        void start();
+        void stop();
+#endif
+
+        Stats stats() const;
+
+        // Submit-to-reply latency (microseconds, steady clock) of one lane
+        LatencyHistogram laneLatency(CommandPriority lane) const;
+
+    private:
+        struct Item
+        {
+            ProducerId producer = 0;
+            uint64_t submittedUs = 0;
+            bool resolve = false; // look up the declared lane on intake
+            size_t intake = 0;    // lane the producer pushed into
+            Command command;
+        };
+
+        struct Producer
+        {
+            ReplySink sink;
+            CommandPriority lane;
+        };
+
+        bool push(ProducerId producer, Command command, CommandPriority lane, bool resolve);
+        void takeIn();
+        bool popNext(Item& item, size_t& lane);
+        bool allLanesEmpty() const;
+
+        CommandShell& mShell;
+        size_t mCapacity;
+        std::unique_ptr<MpscQueue<Item>> mLanes[kLanes]; // intake, indexed by CommandPriority
+        std::deque<Item> mReady[kLanes]; // consumer only: taken in, sorted by declared lane
+        size_t mTakenIn[kLanes] = {};    // consumer only: mReady items per intake lane
+        std::vector<Producer> mProducers;
+        uint32_t mStarvationLimit = 8;
+        uint32_t mPassedOver[kLanes] = {}; // consumer only
+        mutable detail::Mutex mLatencyMutex; // consumer and readers; never producers
+        LatencyHistogram mLatency[kLanes]; // fixed size however long the executor runs
+        std::atomic<uint64_t> mSubmitted{0};
+        std::atomic<uint64_t> mRejected{0};
+        std::atomic<uint64_t> mExecuted{0};
+#if COMMANDSHELL_THREADS
+        void runExecutor();
+
+        std::thread mExecutor;
+        std::atomic<bool> mRunning{false};
+        std::atomic<bool> mIdle{false};
+        std::mutex mWakeMutex; // executor side only; producers notify without it
+        std::condition_variable mWake;
+#endif
+    };
+} // namespace commandshell
+#endif // COMMAND_QUEUE_HPP
@@ -1,138 +1,2009 @@
 #include "CommandShell.hpp"
 #include "CommandTypes.hpp"
+#include "Glob.hpp"
+#include "StructuredOutput.hpp"
+#include "Trace.hpp"
 
 #include <utility>
 #include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#if COMMANDSHELL_THREADS
+#include <condition_variable>
+#include <mutex>
+#endif
 
 using namespace commandshell;
 
 namespace {
-    std::string renderComponents(const std::map<std::string, commandshell::ComponentCommands>& comps)
+    using commandshell::OutputFormat;
+    using commandshell::StructuredWriter;
+
+    // Sorted view of the multi-instance components (stored unordered)
+    template <typename InstanceMap>
+    std::vector<const commandshell::InstanceComponentCommands*> sortedInstances(const InstanceMap& instances)
+    {
+        std::vector<const commandshell::InstanceComponentCommands*> sorted;
+        for (const auto& kv : instances)
+        {
+            sorted.push_back(&kv.second);
+        }
+        std::sort(sorted.begin(), sorted.end(),
+            [](const auto* a, const auto* b) { return a->component < b->component; });
+        return sorted;
+    }
+
+    void writeInstanceSummary(StructuredWriter& w, const commandshell::InstanceComponentCommands& comp)
+    {
+        w.field("name", comp.component);
+        w.field("description", comp.description);
+        w.field("instances", static_cast<uint64_t>(comp.count));
+    }
+
+    // Name and description of a component, from the mutable or the frozen registry
+    struct ComponentSummary
+    {
+        std::string_view name;
+        std::string_view description;
+    };
+
+    /* Filter and page of a help listing: `--prefix=<p>`, a glob, `--page=<n>` (from 1)
+    *  and `--limit=<n>`. Names are offered in listing order through take(), which
+    *  counts every match (the total) but accepts only those on the requested page.
+    */
+    struct HelpQuery
+    {
+        std::string prefix;
+        std::string pattern;
+        size_t page = 1;
+        size_t limit = 0; // 0: no paging
+        bool active = false;
+        size_t matched = 0;
+        size_t shown = 0;
+
+        // Longest literal start every match shares, for seeking in a sorted index
+        std::string rangePrefix() const
+        {
+            const std::string literal = pattern.substr(0, pattern.find_first_of("*?"));
+            return (literal.size() > prefix.size() && literal.compare(0, prefix.size(), prefix) == 0) ? literal : prefix;
+        }
+
+        bool take(std::string_view name)
+        {
+            if (name.substr(0, prefix.size()) != prefix
+                || (!pattern.empty() && !commandshell::globMatch(pattern, std::string(name))))
+            {
+                return false;
+            }
+            const size_t index = matched++;
+            const size_t first = (page - 1) * limit;
+            if (limit != 0 && (index < first || index >= first + limit))
+            {
+                return false;
+            }
+            ++shown;
+            return true;
+        }
+
+        // "1-20 of 57" (or "0 of 57" for an empty page)
+        std::string range() const
+        {
+            const size_t first = limit == 0 ? 0 : (page - 1) * limit;
+            return shown == 0 ? "0 of " + std::to_string(matched)
+                              : std::to_string(first + 1) + "-" + std::to_string(first + shown) + " of " + std::to_string(matched);
+        }
+
+        void writeTotals(StructuredWriter& w) const
+        {
+            if (!active) return;
+            w.field("total", static_cast<uint64_t>(matched));
+            w.field("page", static_cast<uint64_t>(page));
+            w.field("limit", static_cast<uint64_t>(limit));
+        }
+    };
+
+    // Reads the query options; false with error for a bad --page/--limit value
+    bool parseHelpQuery(const std::vector<std::string>& options, HelpQuery& query, std::string& error)
+    {
+        for (const auto& opt : options)
+        {
+            size_t* number = nullptr;
+            std::string value;
+            if (opt.rfind("--prefix=", 0) == 0)
+            {
+                query.prefix = opt.substr(9);
+            }
+            else if (opt.rfind("--page=", 0) == 0)
+            {
+                number = &query.page;
+                value = opt.substr(7);
+            }
+            else if (opt.rfind("--limit=", 0) == 0)
+            {
+                number = &query.limit;
+                value = opt.substr(8);
+            }
+            else
+            {
+                continue;
+            }
+            query.active = true;
+            if (number != nullptr)
+            {
+                char* end = nullptr;
+                *number = static_cast<size_t>(std::strtoul(value.c_str(), &end, 10));
+                if (value.empty() || *end != '\0' || (number == &query.page && *number == 0))
+                {
+                    error = "Error: invalid value for " + opt.substr(0, opt.find('=')) + " '" + value + "'";
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // `help <component> [glob]`: as above, plus a glob argument filtering the commands
+    bool parseCommandQuery(const std::vector<std::string>& args, const std::vector<std::string>& options,
+                           HelpQuery& query, std::string& error)
+    {
+        if (!parseHelpQuery(options, query, error)) return false;
+        if (!args.empty() && commandshell::isGlob(args[0]))
+        {
+            query.pattern = args[0];
+            query.active = true;
+        }
+        return true;
+    }
+
+    std::string renderComponents(const std::vector<ComponentSummary>& comps,
+                                 const std::vector<const commandshell::InstanceComponentCommands*>& instances,
+                                 const HelpQuery& query, OutputFormat format)
     {
+        // Names and descriptions are kept outside the (possibly unbuilt) command sets
+        if (format != OutputFormat::Text)
+        {
+            std::string out;
+            commandshell::writeStructured(format, out, [&](StructuredWriter& w) {
+                w.beginObject();
+                w.key("components");
+                w.beginArray();
+                for (const auto& comp : comps)
+                {
+                    w.beginObject();
+                    w.field("name", comp.name);
+                    w.field("description", comp.description);
+                    w.endObject();
+                }
+                w.endArray();
+                w.key("instanceComponents");
+                w.beginArray();
+                for (const auto* comp : instances)
+                {
+                    w.beginObject();
+                    writeInstanceSummary(w, *comp);
+                    w.endObject();
+                }
+                w.endArray();
+                query.writeTotals(w);
+                w.endObject();
+            });
+            return out;
+        }
+
         std::ostringstream os;
-        os << "Available components:\n";
-        for (const auto& kv : comps)
+        os << "Available components";
+        if (query.active) os << " (" << query.range() << ")";
+        os << ":\n";
+        for (const auto& comp : comps)
         {
-            const auto& comp = kv.second;
-            os << "  " << comp.component << " - " << comp.description << "\n";
+            os << "  " << comp.name << " - " << comp.description << "\n";
+        }
+        for (const auto* comp : instances)
+        {
+            os << "  " << comp->component << "[0.." << (comp->count == 0 ? 0 : comp->count - 1) << "] - "
+               << comp->description << "\n";
         }
         return os.str();
     }
 
-    std::string renderCommandHelp(const commandshell::ComponentCommands& comp, const std::string& cmdName)
+    void writeFilters(StructuredWriter& w, const std::map<std::string, commandshell::FilterDetails>& filters)
+    {
+        w.beginArray();
+        for (const auto& kv : filters)
+        {
+            w.beginObject();
+            w.field("name", kv.second.name);
+            w.field("description", kv.second.description);
+            w.endObject();
+        }
+        w.endArray();
+    }
+
+    std::string renderFilters(const std::map<std::string, commandshell::FilterDetails>& filters, OutputFormat format)
     {
+        if (format != OutputFormat::Text)
+        {
+            std::string out;
+            commandshell::writeStructured(format, out, [&](StructuredWriter& w) {
+                w.beginObject();
+                w.key("filters");
+                writeFilters(w, filters);
+                w.endObject();
+            });
+            return out;
+        }
+
         std::ostringstream os;
-        for (const auto& cd : comp.commands)
+        os << "Available filters (use after '|'):\n";
+        for (const auto& kv : filters)
+        {
+            os << "  " << kv.second.name << " - " << kv.second.description << "\n";
+        }
+        return os.str();
+    }
+
+    template <typename Options>
+    void renderOptions(std::ostringstream& os, const Options& options)
+    {
+        if (options.empty())
+        {
+            return;
+        }
+        os << "Options:\n";
+        for (const auto& opt : options)
+        {
+            bool hasShort = !opt.shortOpt.empty();
+            bool hasLong = !opt.longOpt.empty();
+            os << "  ";
+            if (hasShort) os << opt.shortOpt;
+            if (hasShort && hasLong) os << ", ";
+            if (hasLong) os << opt.longOpt;
+            if (hasShort || hasLong) os << "  ";
+            os << "- " << opt.description << "\n";
+        }
+        os << "\n";
+    }
+
+    // "options" and "commands" members shared by component and instance help
+    template <typename Options, typename Commands>
+    void writeCommandTable(StructuredWriter& w, const Options& options, const Commands& commands, HelpQuery query = {})
+    {
+        w.key("options");
+        w.beginArray();
+        for (const auto& opt : options)
+        {
+            w.beginObject();
+            w.field("short", opt.shortOpt);
+            w.field("long", opt.longOpt);
+            w.field("description", opt.description);
+            w.endObject();
+        }
+        w.endArray();
+        w.key("commands");
+        w.beginArray();
+        for (const auto& cmd : commands)
+        {
+            if (!query.take(cmd.command)) continue;
+            w.beginObject();
+            w.field("name", cmd.command);
+            w.field("description", cmd.description);
+            w.endObject();
+        }
+        w.endArray();
+        query.writeTotals(w);
+    }
+
+    // "Commands:" section of text help, filtered and paged by query
+    template <typename Commands>
+    void renderCommandList(std::ostringstream& os, const Commands& commands, HelpQuery query)
+    {
+        std::ostringstream rows;
+        for (const auto& cmd : commands)
+        {
+            if (query.take(cmd.command))
+            {
+                rows << "  " << cmd.command << " - " << cmd.description << "\n";
+            }
+        }
+        os << "Commands";
+        if (query.active) os << " (" << query.range() << ")";
+        os << ":\n" << rows.str();
+    }
+
+    // Component is ComponentCommands or FrozenRegistry::Component (same member names)
+    template <typename Component>
+    void writeComponent(StructuredWriter& w, const Component& comp, const HelpQuery& query = {})
+    {
+        w.field("name", comp.component);
+        w.field("description", comp.description);
+        writeCommandTable(w, comp.options, comp.commands, query);
+    }
+
+    std::string renderError(OutputFormat format, const std::string& message)
+    {
+        if (format == OutputFormat::Text)
+        {
+            return message + "\n";
+        }
+        std::string out;
+        commandshell::writeStructured(format, out, [&](StructuredWriter& w) {
+            w.beginObject();
+            w.field("error", message);
+            w.endObject();
+        });
+        return out;
+    }
+
+    // Plain handler output; structured formats wrap it as {"output": ...}
+    std::string renderOutput(OutputFormat format, std::string text)
+    {
+        if (format == OutputFormat::Text)
+        {
+            return text;
+        }
+        std::string out;
+        commandshell::writeStructured(format, out, [&](StructuredWriter& w) {
+            w.beginObject();
+            w.field("output", text);
+            w.endObject();
+        });
+        return out;
+    }
+
+    template <typename CommandList>
+    std::string renderSingleCommand(OutputFormat format, std::string_view prefix, const CommandList& commands,
+                                    std::string_view component, const std::string& cmdName)
+    {
+        for (const auto& cd : commands)
         {
-            if (cd.command == cmdName)
+            if (cd.command != cmdName)
+            {
+                continue;
+            }
+            if (format == OutputFormat::Text)
             {
-                os << comp.component << " " << cd.command << ": " << cd.description << "\n";
-                return os.str();
+                std::string out(prefix);
+                out += ' ';
+                out += cd.command;
+                out += ": ";
+                out += cd.description;
+                out += '\n';
+                return out;
             }
+            std::string out;
+            commandshell::writeStructured(format, out, [&](StructuredWriter& w) {
+                w.beginObject();
+                w.field("component", component);
+                w.field("command", cd.command);
+                w.field("description", cd.description);
+                w.endObject();
+            });
+            return out;
         }
         return std::string{};
     }
 
-    std::string renderComponentHelp(const commandshell::ComponentCommands& comp)
+    template <typename Component>
+    std::string renderCommandHelp(const Component& comp, const std::string& cmdName, OutputFormat format)
     {
+        return renderSingleCommand(format, comp.component, comp.commands, comp.component, cmdName);
+    }
+
+    template <typename Component>
+    std::string renderComponentHelp(const Component& comp, const HelpQuery& query, OutputFormat format)
+    {
+        if (format != OutputFormat::Text)
+        {
+            std::string out;
+            commandshell::writeStructured(format, out, [&](StructuredWriter& w) {
+                w.beginObject();
+                writeComponent(w, comp, query);
+                w.endObject();
+            });
+            return out;
+        }
+
         std::ostringstream os;
         os << "Component: " << comp.component << "\n";
         os << comp.description << "\n\n";
+        renderOptions(os, comp.options);
+        renderCommandList(os, comp.commands, query);
+        return os.str();
+    }
+
+    std::string renderInstanceHelp(const commandshell::InstanceComponentCommands& comp, const std::string& cmdName,
+                                   const HelpQuery& query, OutputFormat format)
+    {
+        if (!cmdName.empty() && query.pattern.empty())
+        {
+            auto out = renderSingleCommand(format, comp.component + "[N]", comp.commands, comp.component, cmdName);
+            if (!out.empty()) return out;
+        }
+        if (format != OutputFormat::Text)
+        {
+            std::string out;
+            commandshell::writeStructured(format, out, [&](StructuredWriter& w) {
+                w.beginObject();
+                writeInstanceSummary(w, comp);
+                writeCommandTable(w, comp.options, comp.commands, query);
+                w.endObject();
+            });
+            return out;
+        }
+
+        std::ostringstream os;
+        os << "Component: " << comp.component << "[0.." << (comp.count == 0 ? 0 : comp.count - 1) << "]\n";
+        os << comp.description << "\n\n";
+        renderOptions(os, comp.options);
+        renderCommandList(os, comp.commands, query);
+        return os.str();
+    }
+
+    // `<instance component> help [command | glob]` with the help query options
+    std::string renderInstanceHelp(const commandshell::InstanceComponentCommands& comp, const commandshell::Command& command,
+                                   OutputFormat format)
+    {
+        HelpQuery query;
+        std::string error;
+        if (!parseCommandQuery(command.arguments, command.options, query, error))
+        {
+            return renderError(format, error);
+        }
+        return renderInstanceHelp(comp, command.arguments.empty() ? std::string{} : command.arguments[0], query, format);
+    }
+
+    std::string renderCacheStats(const CommandCache::Stats& s)
+    {
+        std::ostringstream os;
+        os << "Cache: " << s.entries << " entries, " << s.bytes << " bytes\n";
+        os << "  hits: " << s.hits << "\n";
+        os << "  misses: " << s.misses << "\n";
+        os << "  evictions: " << s.evictions << "\n";
+        os << "  invalidations: " << s.invalidations << "\n";
+        return os.str();
+    }
+
+    // Results of one fan-out; shared with workers that may outlive a timed-out request
+    struct FanOutState
+    {
+#if COMMANDSHELL_THREADS
+        std::mutex mutex;
+        std::condition_variable done;
+#endif
+        std::vector<std::string> outputs;
+        std::vector<bool> finished;
+        size_t remaining = 0;
+        bool abandoned = false; // the caller stopped waiting
+    };
+
+    // Tighter of two optional deadlines (0 = none)
+    uint32_t effectiveDeadline(uint32_t commandMs, uint32_t sessionMs)
+    {
+        if (commandMs == 0) return sessionMs;
+        if (sessionMs == 0) return commandMs;
+        return std::min(commandMs, sessionMs);
+    }
+
+    std::string renderTimeout(uint32_t deadlineMs, OutputFormat format = OutputFormat::Text)
+    {
+        return renderError(format, "Error: command timed out after " + std::to_string(deadlineMs) + " ms");
+    }
+
+    // `--format=json|cbor|text` selects the encoding of one response; handlers never see it
+    const std::string kFormatOption = "--format=";
+
+    bool hasFormatOption(const Command& command)
+    {
+        return std::any_of(command.options.begin(), command.options.end(),
+            [](const std::string& opt) { return opt.compare(0, kFormatOption.size(), kFormatOption) == 0; });
+    }
 
-        if (!comp.options.empty())
+    // Move every `--format=` option of command into options (the last one wins)
+    bool takeFormatOptions(Command& command, ExecutionOptions& options, std::string& error)
+    {
+        auto& opts = command.options;
+        for (auto it = opts.begin(); it != opts.end();)
         {
-            os << "Options:\n";
-            for (const auto& opt : comp.options)
+            if (it->compare(0, kFormatOption.size(), kFormatOption) != 0)
+            {
+                ++it;
+                continue;
+            }
+            const std::string name = it->substr(kFormatOption.size());
+            if (!parseOutputFormat(name, options.format))
             {
-                bool hasShort = !opt.shortOpt.empty();
-                bool hasLong = !opt.longOpt.empty();
-                os << "  ";
-                if (hasShort) os << opt.shortOpt;
-                if (hasShort && hasLong) os << ", ";
-                if (hasLong) os << opt.longOpt;
-                if (hasShort || hasLong) os << "  ";
-                os << "- " << opt.description << "\n";
+                error = "Error: unknown format '" + name + "' (text, json, cbor)";
+                return false;
             }
-            os << "\n";
+            it = opts.erase(it);
         }
+        return true;
+    }
+
+    // `macro run` is answered by runMacro with the caller's options, never as one bounded handler
+    bool isMacroRun(const Command& command)
+    {
+        return command.component == "macro" && command.command == "run";
+    }
 
-        os << "Commands:\n";
-        for (const auto& cmd : comp.commands)
+    std::string renderWatchdog(const commandshell::Watchdog::Stats& stats, const std::vector<std::string>& unresponsive)
+    {
+        std::ostringstream os;
+        os << "Watchdog: started " << stats.started
+           << ", timeouts " << stats.timeouts
+           << ", cancelled " << stats.cancelled
+           << ", unresponsive " << stats.unresponsive
+           << ", running " << stats.running << "\n";
+        for (const auto& name : unresponsive)
         {
-            os << "  " << cmd.command << " - " << cmd.description << "\n";
+            os << "  ignored cancellation: " << name << "\n";
         }
         return os.str();
     }
+
+    uint64_t steadyClockMicros()
+    {
+        using namespace std::chrono;
+        return static_cast<uint64_t>(duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count());
+    }
 }
 
 CommandShell::CommandShell()
+    : mClock(steadyClockMicros)
 {
     // Register built-in help component so it appears in listings
     ComponentCommands help{"help", "Show help for components and commands"};
     registerComponent(help);
+    registerBuiltins();
+    for (const auto& filter : builtinFilters())
+    {
+        registerFilter(filter);
+    }
+}
+
+bool CommandShell::registerComponent(const ComponentCommands& component)
+{
+    return registerComponent(ComponentCommands(component));
+}
+
+bool CommandShell::registerComponent(ComponentCommands&& component)
+{
+    if (mFrozen)
+    {
+        return false;
+    }
+    auto it = resetEntry(mComponents.end(), component.component);
+    storeCommands(it, std::move(component));
+    return true;
+}
+
+bool CommandShell::registerComponentFactory(ComponentFactory factory)
+{
+    if (mFrozen)
+    {
+        return false;
+    }
+    auto it = resetEntry(mComponents.end(), factory.component);
+    it->second.description = std::move(factory.description);
+    it->second.factory = std::move(factory.build);
+    return true;
+}
+
+bool CommandShell::registerComponents(std::vector<ComponentCommands> components)
+{
+    if (mFrozen)
+    {
+        return false;
+    }
+    std::sort(components.begin(), components.end(),
+        [](const ComponentCommands& a, const ComponentCommands& b) { return a.component < b.component; });
+    auto hint = mComponents.end();
+    for (auto& component : components)
+    {
+        auto it = resetEntry(hint, component.component);
+        storeCommands(it, std::move(component));
+        hint = std::next(it);
+    }
+    return true;
+}
+
+bool CommandShell::registerComponentFactories(std::vector<ComponentFactory> factories)
+{
+    if (mFrozen)
+    {
+        return false;
+    }
+    std::sort(factories.begin(), factories.end(),
+        [](const ComponentFactory& a, const ComponentFactory& b) { return a.component < b.component; });
+    auto hint = mComponents.end();
+    for (auto& factory : factories)
+    {
+        auto it = resetEntry(hint, factory.component);
+        it->second.description = std::move(factory.description);
+        it->second.factory = std::move(factory.build);
+        hint = std::next(it);
+    }
+    return true;
+}
+
+FrozenRegistry::Stats CommandShell::freeze()
+{
+    if (mFrozen)
+    {
+        return mFrozen->stats();
+    }
+    // Lazy components are built now: the frozen layout has no factories
+    std::vector<ComponentCommands> components;
+    components.reserve(mComponents.size());
+    for (auto& kv : mComponents)
+    {
+        materialize(kv.first, kv.second);
+        components.push_back(std::move(*kv.second.owned));
+    }
+    const size_t before = FrozenRegistry::footprint(components);
+    mComponents.clear();
+    mFrozen = std::make_unique<FrozenRegistry>(std::move(components));
+    ++mRegistryGeneration;
+    mFrozen->setBytesBefore(before);
+    return mFrozen->stats();
+}
+
+void CommandShell::thaw()
+{
+    if (!mFrozen)
+    {
+        return;
+    }
+    auto components = mFrozen->thaw();
+    mFrozen.reset();
+    registerComponents(std::move(components));
+}
+
+bool CommandShell::isFrozen() const
+{
+    return mFrozen != nullptr;
+}
+
+void CommandShell::registerInstanceComponent(InstanceComponentCommands component)
+{
+    mCache.invalidate(component.component);
+    ++mRegistryGeneration;
+    auto name = component.component;
+    mInstanceComponents.insert_or_assign(std::move(name), std::move(component));
+}
+
+void CommandShell::setFanOutThreads(size_t threads)
+{
+    mFanOutThreads = threads == 0 ? 1 : threads;
+#if COMMANDSHELL_THREADS
+    detail::Lock lock(mPoolMutex);
+    mPool.reset(); // recreated with the new size on next use
+#endif
 }
 
-void CommandShell::registerComponent(const ComponentCommands& component)
+void CommandShell::setFanOutTimeout(uint32_t timeoutMs)
 {
-    auto it = mComponents.find(component.component);
-    if (it != mComponents.end())
+    mFanOutTimeoutMs = timeoutMs;
+}
+
+void CommandShell::setFanOutAbandonLimit(size_t tasks)
+{
+    mFanOutAbandonLimit = tasks;
+}
+
+size_t CommandShell::materializedComponents() const
+{
+    if (mFrozen)
+    {
+        return mFrozen->components().size();
+    }
+    size_t count = 0;
+    for (const auto& kv : mComponents)
     {
-        mComponents.erase(it);
+        if (kv.second.commands.load(std::memory_order_acquire) != nullptr) ++count;
     }
-    mComponents.emplace(component.component, component);
+    return count;
 }
 
 // Executes a parsed command and returns the output via registered components
 std::string CommandShell::executeCommand(const Command &command)
 {
+    return executeCommand(command, ExecutionOptions{});
+}
+
+std::string CommandShell::executeCommand(const Command& command, const ExecutionOptions& options)
+{
+    COMMANDSHELL_TRACE_SCOPE("shell.executeCommand");
+    if (hasFormatOption(command))
+    {
+        Command stripped = command;
+        ExecutionOptions overridden = options;
+        std::string error;
+        if (!takeFormatOptions(stripped, overridden, error))
+        {
+            return renderError(options.format, error);
+        }
+        return executeCommand(stripped, overridden);
+    }
+    const OutputFormat format = options.format;
+
     // Built-in help component and per-component help command
     if (command.component == "help")
     {
         // help list | help components -> list all components
         if (command.command == "list" || command.command == "components")
         {
-            return renderComponents(mComponents);
-        }
+            // Filter (`--prefix`, a name or glob argument) and page (`--page`, `--limit`):
+            // only the requested slice is rendered, walked from the sorted index
+            HelpQuery query;
+            std::string error;
+            if (!parseHelpQuery(command.options, query, error))
+            {
+                return renderError(format, error);
+            }
+            if (!command.arguments.empty())
+            {
+                query.pattern = command.arguments[0];
+                query.active = true;
+            }
+            const std::string start = query.rangePrefix();
+            auto inRange = [&start](std::string_view name) { return name.substr(0, start.size()) == start; };
 
-        // help <component> [command]
-        auto compIt2 = mComponents.find(command.command);
-        if (compIt2 == mComponents.end())
+            std::vector<ComponentSummary> summaries;
+            if (mFrozen)
+            {
+                const auto comps = mFrozen->components();
+                auto it = std::lower_bound(comps.begin(), comps.end(), start,
+                    [](const auto& comp, const std::string& name) { return comp.component < name; });
+                for (; it != comps.end() && inRange(it->component); ++it)
+                {
+                    if (query.take(it->component))
+                    {
+                        summaries.push_back(ComponentSummary{it->component, it->description});
+                    }
+                }
+            }
+            else
+            {
+                for (auto it = mComponents.lower_bound(start); it != mComponents.end() && inRange(it->first); ++it)
+                {
+                    if (query.take(it->first))
+                    {
+                        const ComponentCommands* built = it->second.commands.load(std::memory_order_acquire);
+                        summaries.push_back(ComponentSummary{it->first, built ? built->description : it->second.description});
+                    }
+                }
+            }
+            std::vector<const InstanceComponentCommands*> instances;
+            for (const auto* comp : sortedInstances(mInstanceComponents))
+            {
+                if (query.take(comp->component))
+                {
+                    instances.push_back(comp);
+                }
+            }
+            return renderComponents(summaries, instances, query, format);
+        }
+        if (command.command == "filters")
         {
-            // If asking help for unknown component, return empty
-            return std::string{};
+            return renderFilters(mFilters, format);
         }
-        const auto& comp2 = compIt2->second;
-        if (!command.arguments.empty())
+        // help registry -> everything registered, always structured (JSON unless CBOR asked)
+        if (command.command == "registry")
         {
-            auto out = renderCommandHelp(comp2, command.arguments[0]);
-            if (!out.empty()) return out;
+            return renderRegistry(format == OutputFormat::Cbor ? OutputFormat::Cbor : OutputFormat::Json);
+        }
+
+        // help <component> [command | glob] [--prefix=<p>] [--page=<n>] [--limit=<n>]
+        auto help = renderHelp(command.command, command.arguments, command.options, format);
+        if (!help)
+        {
+            // `help led` or `help led3` for a multi-instance component
+            auto instIt = mInstanceComponents.find(command.command);
+            size_t index = 0;
+            bool outOfRange = false;
+            const InstanceComponentCommands* inst = (instIt != mInstanceComponents.end())
+                ? &instIt->second : findInstanceComponent(command.command, index, outOfRange);
+            if (inst != nullptr)
+            {
+                return renderInstanceHelp(*inst, command, format);
+            }
+            // If asking help for unknown component, return empty (an error object when structured)
+            if (format != OutputFormat::Text)
+            {
+                return renderError(format, "Unknown component '" + command.command + "'");
+            }
+            return std::string{};
         }
-        return renderComponentHelp(comp2);
+        return std::move(*help);
     }
 
-    auto compIt = mComponents.find(command.component);
-    if (compIt == mComponents.end())
+    if ((command.component == "all" || isGlob(command.component)) && !hasComponent(command.component))
     {
-        return std::string{"Unknown component '" + command.component + "'\n"};
+        return renderOutput(format, executeFanOut(command));
     }
 
-    const auto& comp = compIt->second;
-    // Per-component help: `<component> help [command]`
-    if (command.command == "help")
+    if (!hasComponent(command.component))
     {
-        if (!command.arguments.empty())
+        size_t index = 0;
+        bool outOfRange = false;
+        if (const auto* inst = findInstanceComponent(command.component, index, outOfRange))
         {
-            auto out = renderCommandHelp(comp, command.arguments[0]);
-            if (!out.empty()) return out;
+            if (outOfRange)
+            {
+                return renderError(format, "Instance out of range for '" + inst->component + "' (0.."
+                    + std::to_string(inst->count == 0 ? 0 : inst->count - 1) + ")");
+            }
+            return executeInstanceCommand(*inst, index, command, format);
         }
-        return renderComponentHelp(comp);
+        return renderError(format, "Unknown component '" + command.component + "'");
     }
-    auto maybe = comp.getCommandFunction(command.command);
-    if (!maybe.has_value())
+
+    // Per-component help: `<component> help [command]`
+    if (command.command == "help")
     {
-        return std::string{"Unknown command for component '" + command.component + "'\n"};
+        return renderHelp(command.component, command.arguments, command.options, format).value_or(std::string{});
     }
-
-    const auto& details = maybe.value();
-    return details.execute(command.arguments, command.options);
+    const CommandDetails* details = findCommandDetails(command);
+    if (details == nullptr)
+    {
+        return renderError(format, "Unknown command for component '" + command.component + "'");
+    }
+    if (isMacroRun(command) && !command.arguments.empty())
+    {
+        return runMacro(command.arguments[0], std::vector<std::string>(command.arguments.begin() + 1, command.arguments.end()), options);
+    }
+    return executeDetails(*details, command, options);
+}
+
+std::string CommandShell::executeDetails(const CommandDetails& details, const Command& command, const ExecutionOptions& options)
+{
+    const OutputFormat format = options.format;
+    if (auto busy = abandonedHandler(command.component))
+    {
+        return renderError(format, *busy);
+    }
+
+    const uint32_t deadlineMs = effectiveDeadline(details.deadlineMs, options.deadlineMs);
+    std::optional<std::string> output;
+    if (format != OutputFormat::Text && details.structured)
+    {
+        output = runStructured(details, command, format, deadlineMs);
+        return output ? std::move(*output) : renderTimeout(deadlineMs, format);
+    }
+    if (details.cache.kind != CachePolicy::Kind::None)
+    {
+        output = executeCached(command, details, deadlineMs);
+    }
+    else
+    {
+        output = runBounded(details, command, deadlineMs);
+    }
+    return output ? renderOutput(format, std::move(*output)) : renderTimeout(deadlineMs, format);
+}
+
+CommandStep CommandShell::startCommand(const Command& command, std::string& output, const ExecutionOptions& options)
+{
+    if (command.component != "help" && command.command != "help")
+    {
+        const CommandDetails* details = findCommandDetails(command);
+        // Structured sessions get the collected output in one encoded document instead
+        if (details != nullptr && details->resumable && details->cache.kind == CachePolicy::Kind::None
+            && options.format == OutputFormat::Text && !mWatchdog.abandoned(command.component))
+        {
+            auto step = details->resumable(command.arguments, command.options);
+            const uint32_t deadlineMs = effectiveDeadline(details->deadlineMs, options.deadlineMs);
+            if (deadlineMs == 0 || !step)
+            {
+                return step;
+            }
+            // Slices are short by contract, so the deadline is checked between them
+            auto token = CancellationToken::withDeadline(deadlineMs, mClock);
+            return [step = std::move(step), token, deadlineMs](std::string& out) {
+                if (token.isCancelled())
+                {
+                    out += renderTimeout(deadlineMs);
+                    return true;
+                }
+                return step(out);
+            };
+        }
+    }
+    output = executeCommand(command, options);
+    return CommandStep{};
+}
+
+std::optional<CommandPriority> CommandShell::commandPriority(const Command& command) const
+{
+    if (mFrozen)
+    {
+        const auto* comp = mFrozen->findComponent(command.component);
+        const CommandDetails* details = comp ? mFrozen->findCommand(*comp, command.command) : nullptr;
+        return details ? details->priority : std::nullopt;
+    }
+    auto it = mComponents.find(command.component);
+    if (it == mComponents.end())
+    {
+        return std::nullopt;
+    }
+    // Never build a lazy component here: that would take the materialize lock
+    const ComponentCommands* comp = it->second.commands.load(std::memory_order_acquire);
+    if (comp == nullptr)
+    {
+        return std::nullopt;
+    }
+    for (const auto& cd : comp->commands)
+    {
+        if (cd.command == command.command)
+        {
+            return cd.priority;
+        }
+    }
+    return std::nullopt;
+}
+
+EventBus& CommandShell::events()
+{
+    return mEvents;
+}
+
+void CommandShell::publishEvent(const std::string& topic, const std::string& payload)
+{
+    mEvents.publish(topic, payload, nowMicros());
+}
+
+Watchdog::Stats CommandShell::watchdogStats() const
+{
+    return mWatchdog.stats();
+}
+
+bool CommandShell::defineMacro(const std::string& name, const std::string& body, std::string* reply)
+{
+    std::string error;
+    auto entry = std::make_shared<MacroEntry>();
+    if (name.empty() || name.find('$') != std::string::npos)
+    {
+        error = "Error: invalid macro name '" + name + "'\n";
+    }
+    else if (MacroDefinition::parse(body, entry->definition, error))
+    {
+        resolveMacro(*entry, &error);
+    }
+    if (!error.empty())
+    {
+        if (reply) *reply = error;
+        return false;
+    }
+
+    const size_t steps = entry->definition.steps().size();
+    const size_t arity = entry->definition.arity();
+    {
+        detail::Lock lock(mMacroMutex);
+        mMacros[name] = std::move(entry);
+    }
+    if (reply)
+    {
+        *reply = "Macro '" + name + "' defined: " + std::to_string(steps) + (steps == 1 ? " step" : " steps")
+            + ", " + std::to_string(arity) + (arity == 1 ? " argument\n" : " arguments\n");
+    }
+    return true;
+}
+
+bool CommandShell::deleteMacro(const std::string& name)
+{
+    detail::Lock lock(mMacroMutex);
+    return mMacros.erase(name) != 0;
+}
+
+std::string CommandShell::runMacro(const std::string& name, const std::vector<std::string>& args, const ExecutionOptions& options)
+{
+    // Steps may run further macros; bound the nesting so a cycle cannot recurse forever
+    static thread_local unsigned depth = 0;
+    constexpr unsigned kMaxDepth = 8;
+    if (depth >= kMaxDepth)
+    {
+        return renderError(options.format, "Error: macro nesting deeper than " + std::to_string(kMaxDepth));
+    }
+
+    std::shared_ptr<const MacroEntry> entry;
+    {
+        detail::Lock lock(mMacroMutex);
+        auto it = mMacros.find(name);
+        if (it == mMacros.end())
+        {
+            return renderError(options.format, "Error: unknown macro '" + name + "'");
+        }
+        if (it->second->generation != mRegistryGeneration)
+        {
+            // Handlers moved since definition (re-registration, freeze): look them up once more
+            auto fresh = std::make_shared<MacroEntry>(*it->second);
+            resolveMacro(*fresh, nullptr);
+            it->second = std::move(fresh);
+        }
+        entry = it->second;
+    }
+
+    const auto& definition = entry->definition;
+    if (args.size() < definition.arity())
+    {
+        return renderError(options.format, "Error: macro '" + name + "' needs " + std::to_string(definition.arity()) + " arguments");
+    }
+
+    // Every step gets the session deadline; the combined text is encoded once at the end
+    ExecutionOptions stepOptions = options;
+    stepOptions.format = OutputFormat::Text;
+    ++depth;
+    std::string output;
+    const auto& steps = definition.steps();
+    for (size_t i = 0; i < steps.size(); ++i)
+    {
+        Command expanded;
+        const Command* command = &steps[i].command;
+        if (steps[i].templated)
+        {
+            expanded = definition.expand(i, args);
+            command = &expanded;
+        }
+        const CommandDetails* details = entry->handlers[i];
+        output += details ? executeResolved(*details, *command, stepOptions) : executeCommand(*command, stepOptions);
+    }
+    --depth;
+    return renderOutput(options.format, std::move(output));
+}
+
+void CommandShell::registerFilter(const FilterDetails& filter)
+{
+    mFilters.erase(filter.name);
+    mFilters.emplace(filter.name, filter);
+}
+
+std::string CommandShell::executePipeline(const Command& source, const std::vector<PipelineStage>& stages, const ExecutionOptions& options)
+{
+    std::string output;
+    StringLineSink tail(output);
+
+    // Build the chain back to front so each stage knows its downstream
+    std::vector<std::unique_ptr<LineSink>> chain;
+    LineSink* head = &tail;
+    for (auto it = stages.rbegin(); it != stages.rend(); ++it)
+    {
+        auto filterIt = mFilters.find(it->name);
+        if (filterIt == mFilters.end())
+        {
+            return renderError(options.format, "Error: unknown filter '" + it->name + "'");
+        }
+        std::string error;
+        auto stage = filterIt->second.create(*it, *head, error);
+        if (!stage)
+        {
+            if (options.format == OutputFormat::Text)
+            {
+                return error;
+            }
+            return renderError(options.format, error.substr(0, error.find_last_not_of('\n') + 1));
+        }
+        head = stage.get();
+        chain.push_back(std::move(stage));
+    }
+
+    // Filters see text; the session format applies to what comes out of the last stage
+    ExecutionOptions sourceOptions = options;
+    sourceOptions.format = OutputFormat::Text;
+
+    // Stream straight from the handler when it supports it; otherwise split its output.
+    // Streams cannot be interrupted, so a deadline sends the source through the watchdog.
+    const CommandDetails* details = (source.component == "help") ? nullptr : findCommandDetails(source);
+    if (details != nullptr && details->stream && details->cache.kind == CachePolicy::Kind::None
+        && effectiveDeadline(details->deadlineMs, options.deadlineMs) == 0 && !hasFormatOption(source)
+        && !mWatchdog.abandoned(source.component))
+    {
+        details->stream(source.arguments, source.options, *head);
+    }
+    else
+    {
+        writeLines(executeCommand(source, sourceOptions), *head);
+    }
+    head->finish();
+    return renderOutput(options.format, std::move(output));
+}
+
+void CommandShell::invalidateCache()
+{
+    mCache.invalidate();
+}
+
+void CommandShell::invalidateCache(const std::string& component)
+{
+    mCache.invalidate(component);
+}
+
+void CommandShell::invalidateCache(const std::string& component, const std::string& command)
+{
+    mCache.invalidate(component, command);
+}
+
+void CommandShell::setCacheLimits(size_t maxEntries, size_t maxBytes)
+{
+    mCache.setLimits(maxEntries, maxBytes);
+}
+
+CommandCache::Stats CommandShell::cacheStats() const
+{
+    return mCache.stats();
+}
+
+void CommandShell::setClock(std::function<uint64_t()> nowUs)
+{
+    mClock = nowUs ? std::move(nowUs) : std::function<uint64_t()>(steadyClockMicros);
+    mWatchdog.setClock(mClock);
+}
+
+uint64_t CommandShell::nowMicros() const
+{
+    return mClock();
+}
+
+void CommandShell::setAdmissionPolicy(const AdmissionPolicy& policy)
+{
+    mGlobalAdmission = policy;
+    mHasGlobalAdmission = true;
+}
+
+void CommandShell::setAdmissionPolicy(const std::string& component, const AdmissionPolicy& policy)
+{
+    mComponentAdmission[component] = policy;
+}
+
+void CommandShell::clearAdmissionPolicies()
+{
+    mHasGlobalAdmission = false;
+    mComponentAdmission.clear();
+}
+
+const AdmissionPolicy* CommandShell::admissionPolicyFor(const std::string& component, bool* perComponent) const
+{
+    auto it = mComponentAdmission.find(component);
+    if (perComponent != nullptr)
+    {
+        *perComponent = (it != mComponentAdmission.end());
+    }
+    if (it != mComponentAdmission.end())
+    {
+        return &it->second;
+    }
+    return mHasGlobalAdmission ? &mGlobalAdmission : nullptr;
+}
+
+/******************** Private methods *******************/
+
+std::optional<std::string> CommandShell::executeCached(const Command& command, const CommandDetails& details, uint32_t deadlineMs)
+{
+    const auto key = CommandCache::makeKey(command);
+    const uint64_t now = nowMicros();
+    if (auto hit = mCache.lookup(key, now))
+    {
+        return *hit;
+    }
+
+    auto bounded = runBounded(details, command, deadlineMs);
+    if (!bounded)
+    {
+        return std::nullopt; // never memoize a timeout
+    }
+    auto output = std::move(*bounded);
+    uint64_t expiresAt = 0;
+    if (details.cache.kind == CachePolicy::Kind::Ttl)
+    {
+        expiresAt = now + static_cast<uint64_t>(details.cache.ttlMs) * 1000u;
+    }
+    mCache.store(key, command, output, expiresAt);
+    return output;
+}
+
+CommandShell::ComponentMap::iterator CommandShell::resetEntry(ComponentMap::iterator hint, const std::string& name)
+{
+    auto it = mComponents.try_emplace(hint, name);
+    auto& entry = it->second;
+    entry.commands.store(nullptr, std::memory_order_release);
+    entry.owned.reset();
+    entry.factory = nullptr;
+    entry.description = std::string{};
+    mCache.invalidate(name);
+    ++mRegistryGeneration;
+    return it;
+}
+
+void CommandShell::storeCommands(ComponentMap::iterator it, ComponentCommands&& component)
+{
+    auto& entry = it->second;
+    entry.owned = std::make_unique<ComponentCommands>(std::move(component));
+    entry.commands.store(entry.owned.get(), std::memory_order_release);
+}
+
+std::vector<CommandShell::FanOutTarget> CommandShell::fanOutTargets(const std::string& pattern, const std::string& command) const
+{
+    const bool all = (pattern == "all");
+    auto hasCommand = [&command](const auto& commands) {
+        for (const auto& cd : commands)
+        {
+            if (cd.command == command) return true;
+        }
+        return false;
+    };
+
+    std::vector<FanOutTarget> targets;
+    if (mFrozen)
+    {
+        for (const auto& comp : mFrozen->components())
+        {
+            if (comp.component == "help" || (!all && !globMatch(pattern, std::string(comp.component))))
+            {
+                continue;
+            }
+            const bool found = mFrozen->findCommand(comp, command) != nullptr;
+            if (all && !found)
+            {
+                continue;
+            }
+            targets.push_back(FanOutTarget{std::string(comp.component), found});
+        }
+    }
+    for (const auto& kv : mComponents)
+    {
+        if (kv.first == "help" || (!all && !globMatch(pattern, kv.first)))
+        {
+            continue;
+        }
+        if (all && kv.second.commands.load(std::memory_order_acquire) == nullptr)
+        {
+            continue; // lazy and not built yet; `all` must not build every factory
+        }
+        const bool found = hasCommand(materialize(kv.first, kv.second)->commands);
+        if (all && !found)
+        {
+            continue;
+        }
+        targets.push_back(FanOutTarget{kv.first, found});
+    }
+
+    std::vector<const InstanceComponentCommands*> instances;
+    for (const auto& kv : mInstanceComponents)
+    {
+        instances.push_back(&kv.second);
+    }
+    std::sort(instances.begin(), instances.end(),
+        [](const auto* a, const auto* b) { return a->component < b->component; });
+    for (const auto* inst : instances)
+    {
+        const bool found = hasCommand(inst->commands);
+        if (all && !found)
+        {
+            continue;
+        }
+        for (size_t i = 0; i < inst->count; ++i)
+        {
+            auto name = inst->component + std::to_string(i);
+            if (all || globMatch(pattern, name))
+            {
+                targets.push_back(FanOutTarget{std::move(name), found});
+            }
+        }
+    }
+    return targets;
+}
+
+std::string CommandShell::executeFanOut(const Command& command)
+{
+    // Consume --timeout=<ms>; every other option is passed to the targets
+    uint32_t timeoutMs = mFanOutTimeoutMs;
+    Command base = command;
+    base.options.clear();
+    for (const auto& opt : command.options)
+    {
+        if (opt.rfind("--timeout=", 0) == 0)
+        {
+            timeoutMs = static_cast<uint32_t>(std::strtoul(opt.c_str() + 10, nullptr, 10));
+        }
+        else
+        {
+            base.options.push_back(opt);
+        }
+    }
+
+    const auto targets = fanOutTargets(command.component, command.command);
+    if (targets.empty())
+    {
+        return std::string{"No targets for '" + command.component + " " + command.command + "'\n"};
+    }
+
+    auto state = std::make_shared<FanOutState>();
+    state->outputs.resize(targets.size());
+    state->finished.assign(targets.size(), false);
+    const uint64_t deadline = nowMicros() + static_cast<uint64_t>(timeoutMs) * 1000u;
+
+#if COMMANDSHELL_THREADS
+    ThreadPool* pool = nullptr;
+    if (!ThreadPool::onWorkerThread())
+    {
+        detail::Lock lock(mPoolMutex);
+        if (!mPool)
+        {
+            mPool = std::make_unique<ThreadPool>(mFanOutThreads);
+        }
+        pool = mPool.get();
+    }
+    const size_t abandoned = mFanOutAbandoned.load();
+    if (pool != nullptr && abandoned >= mFanOutAbandonLimit)
+    {
+        return "Error: fan-out refused: " + std::to_string(abandoned) + " timed-out handler(s) still running (limit "
+            + std::to_string(mFanOutAbandonLimit) + ")\n";
+    }
+#endif
+
+    for (size_t i = 0; i < targets.size(); ++i)
+    {
+        if (!targets[i].hasCommand)
+        {
+            continue;
+        }
+        Command target = base;
+        target.component = targets[i].name;
+#if COMMANDSHELL_THREADS
+        if (pool != nullptr)
+        {
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                ++state->remaining;
+            }
+            pool->submit([this, state, i, target]() {
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    if (state->abandoned)
+                    {
+                        // Still queued when the fan-out timed out: nobody waits for it
+                        --state->remaining;
+                        mFanOutAbandoned.fetch_sub(1);
+                        return;
+                    }
+                }
+                auto out = executeCommand(target);
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->outputs[i] = std::move(out);
+                state->finished[i] = true;
+                --state->remaining;
+                if (state->abandoned)
+                {
+                    mFanOutAbandoned.fetch_sub(1);
+                }
+                else if (state->remaining == 0)
+                {
+                    state->done.notify_all();
+                }
+            });
+            continue;
+        }
+#endif
+        // No workers (single-threaded build or nested fan-out): run inline until the deadline
+        if (nowMicros() < deadline)
+        {
+            state->outputs[i] = executeCommand(target);
+            state->finished[i] = true;
+        }
+    }
+
+#if COMMANDSHELL_THREADS
+    std::unique_lock<std::mutex> lock(state->mutex);
+    if (pool != nullptr)
+    {
+        state->done.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&state]() { return state->remaining == 0; });
+        if (state->remaining != 0)
+        {
+            // Workers still owe these; each one releases its count when it returns
+            state->abandoned = true;
+            mFanOutAbandoned.fetch_add(state->remaining);
+        }
+    }
+#endif
+
+    std::ostringstream os;
+    size_t ok = 0, timedOut = 0, errors = 0;
+    for (size_t i = 0; i < targets.size(); ++i)
+    {
+        os << "[" << targets[i].name << "] ";
+        if (!targets[i].hasCommand)
+        {
+            os << "error: unknown command '" << command.command << "'\n";
+            ++errors;
+        }
+        else if (!state->finished[i])
+        {
+            os << "timeout\n";
+            ++timedOut;
+        }
+        else
+        {
+            os << "ok\n" << state->outputs[i];
+            if (!state->outputs[i].empty() && state->outputs[i].back() != '\n') os << "\n";
+            ++ok;
+        }
+    }
+    os << targets.size() << " targets: " << ok << " ok, " << timedOut << " timeout, " << errors << " error\n";
+    if (timedOut != 0)
+    {
+        os << mFanOutAbandoned.load() << " abandoned handler(s) running (limit " << mFanOutAbandonLimit << ")\n";
+    }
+    return os.str();
+}
+
+const InstanceComponentCommands* CommandShell::findInstanceComponent(const std::string& token, size_t& index, bool& outOfRange) const
+{
+    if (mInstanceComponents.empty() || token.empty())
+    {
+        return nullptr;
+    }
+
+    // `led[17]` or `led17`
+    size_t baseLen = 0;
+    size_t digitsBegin = 0;
+    size_t digitsEnd = token.size();
+    if (token.back() == ']')
+    {
+        size_t open = token.rfind('[');
+        if (open == std::string::npos || open == 0)
+        {
+            return nullptr;
+        }
+        baseLen = open;
+        digitsBegin = open + 1;
+        digitsEnd = token.size() - 1;
+    }
+    else
+    {
+        size_t pos = token.size();
+        while (pos > 0 && token[pos - 1] >= '0' && token[pos - 1] <= '9')
+        {
+            --pos;
+        }
+        baseLen = pos;
+        digitsBegin = pos;
+    }
+    if (baseLen == 0 || digitsBegin >= digitsEnd || digitsEnd - digitsBegin > 9)
+    {
+        return nullptr;
+    }
+
+    size_t value = 0;
+    for (size_t i = digitsBegin; i < digitsEnd; ++i)
+    {
+        if (token[i] < '0' || token[i] > '9')
+        {
+            return nullptr;
+        }
+        value = value * 10 + static_cast<size_t>(token[i] - '0');
+    }
+
+    auto it = mInstanceComponents.find(token.substr(0, baseLen));
+    if (it == mInstanceComponents.end())
+    {
+        return nullptr;
+    }
+    index = value;
+    outOfRange = value >= it->second.count;
+    return &it->second;
+}
+
+std::string CommandShell::executeInstanceCommand(const InstanceComponentCommands& comp, size_t index, const Command& command,
+                                                 OutputFormat format) const
+{
+    if (command.command == "help")
+    {
+        return renderInstanceHelp(comp, command, format);
+    }
+    for (const auto& cd : comp.commands)
+    {
+        if (cd.command == command.command)
+        {
+            return renderOutput(format, cd.execute(index, command.arguments, command.options));
+        }
+    }
+    return renderError(format, "Unknown command for component '" + command.component + "'");
+}
+
+const ComponentCommands* CommandShell::findComponent(const std::string& name) const
+{
+    COMMANDSHELL_TRACE_SCOPE("shell.lookupComponent");
+    auto it = mComponents.find(name);
+    if (it == mComponents.end())
+    {
+        return nullptr;
+    }
+    return materialize(it->first, it->second);
+}
+
+bool CommandShell::hasComponent(const std::string& name) const
+{
+    return mFrozen ? mFrozen->findComponent(name) != nullptr : mComponents.count(name) != 0;
+}
+
+std::optional<std::string> CommandShell::renderHelp(const std::string& component, const std::vector<std::string>& args,
+                                                    const std::vector<std::string>& options, OutputFormat format) const
+{
+    HelpQuery query;
+    std::string error;
+    const bool valid = parseCommandQuery(args, options, query, error);
+    auto render = [&](const auto& comp) {
+        if (!valid)
+        {
+            return renderError(format, error);
+        }
+        if (!args.empty() && query.pattern.empty())
+        {
+            auto out = renderCommandHelp(comp, args[0], format);
+            if (!out.empty()) return out;
+        }
+        return renderComponentHelp(comp, query, format);
+    };
+    if (mFrozen)
+    {
+        const auto* comp = mFrozen->findComponent(component);
+        return comp ? std::optional<std::string>(render(*comp)) : std::nullopt;
+    }
+    const ComponentCommands* comp = findComponent(component);
+    return comp ? std::optional<std::string>(render(*comp)) : std::nullopt;
+}
+
+const ComponentCommands* CommandShell::materialize(const std::string& name, const ComponentEntry& entry) const
+{
+    const ComponentCommands* built = entry.commands.load(std::memory_order_acquire);
+    if (built != nullptr)
+    {
+        return built;
+    }
+
+    detail::Lock lock(mMaterializeMutex);
+    built = entry.commands.load(std::memory_order_acquire);
+    if (built != nullptr)
+    {
+        return built;
+    }
+    auto comp = entry.factory ? entry.factory() : ComponentCommands{name, entry.description};
+    comp.component = name;
+    entry.owned = std::make_unique<ComponentCommands>(std::move(comp));
+    entry.factory = nullptr; // release captured state
+    entry.commands.store(entry.owned.get(), std::memory_order_release);
+    return entry.owned.get();
+}
+
+const CommandDetails* CommandShell::findCommandDetails(const Command& command) const
+{
+    COMMANDSHELL_TRACE_SCOPE("shell.lookupCommand");
+    if (mFrozen)
+    {
+        const auto* frozen = mFrozen->findComponent(command.component);
+        return frozen ? mFrozen->findCommand(*frozen, command.command) : nullptr;
+    }
+    const ComponentCommands* comp = findComponent(command.component);
+    if (comp == nullptr)
+    {
+        return nullptr;
+    }
+    for (const auto& cd : comp->commands)
+    {
+        if (cd.command == command.command)
+        {
+            return &cd;
+        }
+    }
+    return nullptr;
+}
+
+std::optional<std::string> CommandShell::abandonedHandler(const std::string& component) const
+{
+    // Its handlers are not assumed reentrant, so the component waits for the late one
+    auto name = mWatchdog.abandoned(component);
+    if (!name)
+    {
+        return std::nullopt;
+    }
+    return "Error: '" + *name + "' missed its deadline and is still running; '" + component + "' is unavailable until it returns";
+}
+
+std::optional<std::string> CommandShell::runBounded(const CommandDetails& details, const Command& command, uint32_t deadlineMs)
+{
+    if (deadlineMs == 0)
+    {
+        return runHandler(details, command, CancellationToken{});
+    }
+    // Copies: a handler that misses its deadline may outlive this call and the registration
+    return mWatchdog.run(command.component, command.component + " " + command.command, deadlineMs,
+        [details, command](const CancellationToken& token) { return runHandler(details, command, token); });
+}
+
+std::optional<std::string> CommandShell::runStructured(const CommandDetails& details, const Command& command,
+                                                       OutputFormat format, uint32_t deadlineMs)
+{
+    auto work = [details, command, format](const CancellationToken&) {
+        std::string out;
+        writeStructured(format, out, [&](StructuredWriter& w) {
+            details.structured(command.arguments, command.options, w);
+        });
+        return out;
+    };
+    if (deadlineMs == 0)
+    {
+        return work(CancellationToken{});
+    }
+    return mWatchdog.run(command.component, command.component + " " + command.command, deadlineMs, std::move(work));
+}
+
+std::string CommandShell::renderRegistry(OutputFormat format) const
+{
+    std::string out;
+    writeStructured(format, out, [&](StructuredWriter& w) {
+        w.beginObject();
+        w.key("components");
+        w.beginArray();
+        if (mFrozen)
+        {
+            for (const auto& comp : mFrozen->components())
+            {
+                w.beginObject();
+                writeComponent(w, comp);
+                w.endObject();
+            }
+        }
+        for (const auto& kv : mComponents)
+        {
+            w.beginObject();
+            if (const ComponentCommands* comp = materialize(kv.first, kv.second))
+            {
+                writeComponent(w, *comp);
+            }
+            else
+            {
+                w.field("name", kv.first);
+                w.field("description", kv.second.description);
+            }
+            w.endObject();
+        }
+        w.endArray();
+        w.key("instanceComponents");
+        w.beginArray();
+        for (const auto* comp : sortedInstances(mInstanceComponents))
+        {
+            w.beginObject();
+            writeInstanceSummary(w, *comp);
+            writeCommandTable(w, comp->options, comp->commands);
+            w.endObject();
+        }
+        w.endArray();
+        w.key("filters");
+        writeFilters(w, mFilters);
+        w.endObject();
+    });
+    return out;
+}
+
+bool CommandShell::resolveMacro(MacroEntry& entry, std::string* error) const
+{
+    const auto& steps = entry.definition.steps();
+    entry.handlers.assign(steps.size(), nullptr);
+    entry.generation = mRegistryGeneration;
+    for (size_t i = 0; i < steps.size(); ++i)
+    {
+        const Command& command = steps[i].command;
+        if (steps[i].dynamicTarget || command.component == "help" || command.command == "help" || isMacroRun(command))
+        {
+            continue; // full dispatch on every run
+        }
+        entry.handlers[i] = findCommandDetails(command);
+        if (entry.handlers[i] != nullptr || error == nullptr)
+        {
+            continue;
+        }
+        // Targets without a single handler still run through full dispatch
+        size_t index = 0;
+        bool outOfRange = false;
+        const bool dispatchable = command.component == "all" || isGlob(command.component)
+            || findInstanceComponent(command.component, index, outOfRange) != nullptr;
+        if (!dispatchable)
+        {
+            *error = "Error: macro step " + std::to_string(i + 1) + ": unknown command '"
+                + command.component + " " + command.command + "'\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string CommandShell::executeResolved(const CommandDetails& details, const Command& command, const ExecutionOptions& options)
+{
+    if (hasFormatOption(command))
+    {
+        Command stripped = command;
+        ExecutionOptions overridden = options;
+        std::string error;
+        if (!takeFormatOptions(stripped, overridden, error))
+        {
+            return renderError(options.format, error);
+        }
+        return executeDetails(details, stripped, overridden);
+    }
+    return executeDetails(details, command, options);
+}
+
+std::string CommandShell::renderMacros() const
+{
+    detail::Lock lock(mMacroMutex);
+    if (mMacros.empty())
+    {
+        return "No macros defined\n";
+    }
+    std::ostringstream os;
+    os << "Macros:\n";
+    for (const auto& kv : mMacros)
+    {
+        const auto& definition = kv.second->definition;
+        os << "  " << kv.first << " (" << definition.steps().size() << " steps, " << definition.arity()
+           << " args): " << definition.body() << "\n";
+    }
+    return os.str();
+}
+
+std::string CommandShell::renderRegistryStats() const
+{
+    std::ostringstream os;
+    if (!mFrozen)
+    {
+        os << "Registry: mutable, " << mComponents.size() << " components (" << materializedComponents() << " built)\n";
+        return os.str();
+    }
+    const auto stats = mFrozen->stats();
+    os << "Registry: frozen, " << stats.components << " components, " << stats.commands << " commands\n";
+    os << "  strings: " << stats.blobBytes << " bytes in one blob\n";
+    os << "  memory: " << stats.bytesBefore << " -> " << stats.bytesAfter << " bytes (saved "
+       << (stats.bytesBefore > stats.bytesAfter ? stats.bytesBefore - stats.bytesAfter : 0) << ")\n";
+    return os.str();
+}
+
+std::string CommandShell::renderMemory() const
+{
+    std::ostringstream body;
+    size_t total = 0;
+    size_t components = 0;
+    auto line = [&body, &total](std::string_view name, size_t bytes, const std::string& detail) {
+        body << "  " << name << ": " << bytes << " bytes" << detail << "\n";
+        total += bytes;
+    };
+    auto counts = [](size_t commands, size_t options) {
+        return ", " + std::to_string(commands) + " commands, " + std::to_string(options) + " options";
+    };
+
+    if (mFrozen)
+    {
+        for (const auto& comp : mFrozen->components())
+        {
+            line(comp.component, mFrozen->footprint(comp), counts(comp.commands.size(), comp.options.size())
+                + ", " + std::to_string(comp.stringBytes) + " string bytes pooled");
+            ++components;
+        }
+    }
+    for (const auto& kv : mComponents)
+    {
+        const ComponentCommands* comp = kv.second.commands.load(std::memory_order_acquire);
+        if (comp == nullptr)
+        {
+            line(kv.first, sizeof(ComponentMap::value_type) + StringPool::heapBytes(kv.first)
+                + StringPool::heapBytes(kv.second.description), " (not built)");
+        }
+        else
+        {
+            line(kv.first, sizeof(ComponentEntry) + StringPool::heapBytes(kv.second.description) + FrozenRegistry::footprint(*comp),
+                 counts(comp->commands.size(), comp->options.size()));
+        }
+        ++components;
+    }
+    for (const auto* comp : sortedInstances(mInstanceComponents))
+    {
+        size_t bytes = sizeof(InstanceComponentCommands) + 2 * StringPool::heapBytes(comp->component)
+            + StringPool::heapBytes(comp->description)
+            + comp->commands.capacity() * sizeof(InstanceCommandDetails)
+            + comp->options.capacity() * sizeof(OptionDetails);
+        for (const auto& cd : comp->commands)
+        {
+            bytes += StringPool::heapBytes(cd.command) + StringPool::heapBytes(cd.description);
+        }
+        line(comp->component + "[0.." + std::to_string(comp->count == 0 ? 0 : comp->count - 1) + "]", bytes,
+             ", " + std::to_string(comp->commands.size()) + " commands shared by " + std::to_string(comp->count) + " instances");
+        ++components;
+    }
+
+    // Only the frozen layout interns; the mutable registry keeps each string where it was registered
+    if (mFrozen)
+    {
+        const StringPool& pool = mFrozen->strings();
+        const auto strings = pool.stats();
+        total += pool.memoryFootprint();
+        body << "  strings: " << pool.memoryFootprint() << " bytes, " << strings.strings << " interned ("
+             << strings.bytes << " bytes), " << strings.savedBytes << " bytes shared\n";
+    }
+    else
+    {
+        body << "  strings: not interned until freeze()\n";
+    }
+
+    std::ostringstream os;
+    os << "Registry memory (" << (mFrozen ? "frozen" : "mutable") << "): " << total << " bytes, "
+       << components << " components\n";
+    os << body.str();
+    return os.str();
+}
+
+std::string CommandShell::runHandler(const CommandDetails& details, const Command& command, const CancellationToken& token)
+{
+    COMMANDSHELL_TRACE_SCOPE("shell.handler");
+    if (details.cancellable)
+    {
+        return details.cancellable(command.arguments, command.options, token);
+    }
+    if (details.execute)
+    {
+        return details.execute(command.arguments, command.options);
+    }
+    std::string output;
+    if (details.stream)
+    {
+        StringLineSink sink(output);
+        details.stream(command.arguments, command.options, sink);
+    }
+    else if (details.resumable)
+    {
+        // Direct execution: run all slices back to back
+        auto step = details.resumable(command.arguments, command.options);
+        while (step && !step(output))
+        {
+            if (token.isCancelled())
+            {
+                break;
+            }
+        }
+    }
+    return output;
+}
+
+void CommandShell::registerBuiltins()
+{
+    ComponentCommands shell{"shell", "Shell diagnostics and maintenance"};
+    shell.addCommand(CommandDetails{
+        "cache",
+        "Show result cache counters; `shell cache clear [component]` drops entries",
+        [this](const std::vector<std::string>& args, const std::vector<std::string>&) -> std::string {
+            if (!args.empty() && args[0] == "clear")
+            {
+                if (args.size() >= 2) invalidateCache(args[1]);
+                else invalidateCache();
+                return "Cache cleared\n";
+            }
+            return renderCacheStats(cacheStats());
+        }
+    });
+    shell.addCommand(CommandDetails{
+        "watchdog",
+        "Show deadline counters and handlers that ignored cancellation",
+        [this](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string {
+            return renderWatchdog(mWatchdog.stats(), mWatchdog.unresponsive());
+        }
+    });
+    shell.addCommand(CommandDetails{
+        "registry",
+        "Show registry layout; after freeze() the memory saved by compaction",
+        [this](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string {
+            return renderRegistryStats();
+        }
+    });
+    shell.addCommand(CommandDetails{
+        "memory",
+        "Show registry RAM footprint per component",
+        [this](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string {
+            return renderMemory();
+        }
+    });
+    registerComponent(shell);
+
+    // subscribe/unsubscribe/list act on the calling session and are answered by
+    // CommandShellIO; only publish makes sense without one
+    ComponentCommands events{"events", "Push notifications for this session"};
+    const auto needsSession = [](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string {
+        return "Error: events subscriptions belong to a CommandShellIO session\n";
+    };
+    events.addCommand(CommandDetails{"subscribe", "Receive events matching a topic glob: `events subscribe led.*`", needsSession});
+    events.addCommand(CommandDetails{"unsubscribe", "Stop receiving a topic glob", needsSession});
+    events.addCommand(CommandDetails{"list", "Show subscriptions and delivery counters", needsSession});
+    events.addCommand(CommandDetails{
+        "publish",
+        "Publish an event: `events publish <topic> [payload...]`",
+        [this](const std::vector<std::string>& args, const std::vector<std::string>&) -> std::string {
+            if (args.empty())
+            {
+                return "Error: events publish <topic> [payload...]\n";
+            }
+            std::string payload;
+            for (size_t i = 1; i < args.size(); ++i)
+            {
+                if (i > 1) payload += ' ';
+                payload += args[i];
+            }
+            publishEvent(args[0], payload);
+            return "Published " + args[0] + "\n";
+        }
+    });
+    registerComponent(events);
+
+    ComponentCommands watch{"watch",
+        "Periodic commands in this session, output only on change: `watch <ms> [--diff] <command>`, "
+        "`repeat <n> [--every=<ms>] [--diff] <command>`; Ctrl-C stops them"};
+    const auto watchNeedsSession = [](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string {
+        return "Error: watches belong to a CommandShellIO session\n";
+    };
+    watch.addCommand(CommandDetails{"list", "Show this session's watches and their counters", watchNeedsSession});
+    watch.addCommand(CommandDetails{"stop", "Stop a watch: `watch stop <id>` or `watch stop all`", watchNeedsSession});
+    registerComponent(watch);
+
+    ComponentCommands macro{"macro", "Named command sequences run in one round trip"};
+    macro.addCommand(CommandDetails{
+        "define",
+        "Define a macro: `macro define <name> <step> ; <step> ...` ($1..$9 are arguments)",
+        [this](const std::vector<std::string>& args, const std::vector<std::string>& opts) -> std::string {
+            if (args.size() < 2)
+            {
+                return "Error: macro define <name> <step> [; <step>...]\n";
+            }
+            // Arguments and options arrive split, so their order inside a step is lost here
+            if (!opts.empty())
+            {
+                return "Error: steps with options must be defined from a CommandShellIO session or defineMacro()\n";
+            }
+            std::string body;
+            for (size_t i = 1; i < args.size(); ++i)
+            {
+                if (i > 1) body += ' ';
+                body += args[i];
+            }
+            std::string reply;
+            defineMacro(args[0], body, &reply);
+            return reply;
+        }
+    });
+    macro.addCommand(CommandDetails{
+        "run",
+        "Run a macro: `macro run <name> [args...]`; outputs of all steps in one response",
+        [this](const std::vector<std::string>& args, const std::vector<std::string>&) -> std::string {
+            if (args.empty())
+            {
+                return "Error: macro run <name> [args...]\n";
+            }
+            return runMacro(args[0], std::vector<std::string>(args.begin() + 1, args.end()));
+        }
+    });
+    macro.addCommand(CommandDetails{
+        "list",
+        "List macros with their steps",
+        [this](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string {
+            return renderMacros();
+        }
+    });
+    macro.addCommand(CommandDetails{
+        "delete",
+        "Delete a macro",
+        [this](const std::vector<std::string>& args, const std::vector<std::string>&) -> std::string {
+            if (args.empty())
+            {
+                return "Error: macro delete <name>\n";
+            }
+            return deleteMacro(args[0]) ? "Deleted macro '" + args[0] + "'\n" : "Error: unknown macro '" + args[0] + "'\n";
+        }
+    });
+    registerComponent(macro);
 }
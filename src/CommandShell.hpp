@@ -3,8 +3,24 @@
 
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <vector>
+#include <functional>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <optional>
 #include "CommandTypes.hpp"
+#include "CommandCache.hpp"
+#include "CommandPipeline.hpp"
+#include "AdmissionControl.hpp"
+#include "CommandShellConfig.hpp"
+#include "EventBus.hpp"
+#include "FrozenRegistry.hpp"
+#include "Macro.hpp"
+#include "StringPool.hpp"
+#include "ThreadPool.hpp"
+#include "Watchdog.hpp"
 
 namespace commandshell
 {
@@ -14,15 +30,239 @@ namespace commandshell
         CommandShell();
         ~CommandShell() = default;
 
-        // Register a component command set
-        void registerComponent(const commandshell::ComponentCommands& component);
+        // Built-in commands capture this instance, so the shell is not copyable
+        CommandShell(const CommandShell&) = delete;
+        CommandShell& operator=(const CommandShell&) = delete;
+
+        // Register a component command set (replaces one with the same name).
+        // Registration is meant for startup; it is not synchronized with dispatch.
+        // Returns false (and registers nothing) while the registry is frozen.
+        bool registerComponent(const commandshell::ComponentCommands& component);
+        bool registerComponent(commandshell::ComponentCommands&& component);
+
+        // Register a component that is only built on first dispatch or help
+        bool registerComponentFactory(commandshell::ComponentFactory factory);
+
+        // Bulk registration; sorts once and inserts with position hints
+        bool registerComponents(std::vector<commandshell::ComponentCommands> components);
+        bool registerComponentFactories(std::vector<commandshell::ComponentFactory> factories);
+
+        /* Read-mostly deployments: once startup registration is done, freeze()
+        *  builds every lazy component and compacts the registry into a
+        *  FrozenRegistry (one string blob, dense handler table, sorted lookup
+        *  offsets) and reports the memory saved. Component registration is
+        *  rejected until thaw() rebuilds the mutable registry; filters and
+        *  multi-instance components are unaffected. Like registration, neither
+        *  call is synchronized with dispatch.
+        *  String interning happens here only: the mutable registry keeps its own
+        *  std::string copies (component names both as map key and in the
+        *  table, shared descriptions once per component), and `shell memory`
+        *  reports pooled strings only while frozen.
+        */
+        commandshell::FrozenRegistry::Stats freeze();
+        void thaw();
+        bool isFrozen() const;
+
+        // Register one command table shared by N instances (`led[3] on` / `led3 on`)
+        void registerInstanceComponent(commandshell::InstanceComponentCommands component);
+
+        /* Fan-out: `all <command> ...` runs the command on every component (and
+        *  instance) that has it; a glob such as `led* status` or `dev? status`
+        *  selects targets by name. Targets run concurrently on a worker pool and
+        *  results come back in name order with a per-target status. Handlers used
+        *  this way must be thread-safe. `--timeout=<ms>` overrides the default.
+        *  `all` skips lazy components that have not been built yet; a glob that
+        *  names them builds them.
+        *
+        *  A target that times out is abandoned but keeps its worker until the
+        *  handler returns (queued targets of a timed-out fan-out are dropped).
+        *  While abandonLimit handlers are still running, new fan-outs are refused
+        *  so stuck targets cannot take over the whole pool.
+        */
+        void setFanOutThreads(size_t threads);
+        void setFanOutTimeout(uint32_t timeoutMs);
+        void setFanOutAbandonLimit(size_t tasks);
+
+        // Number of components whose command sets have been built
+        size_t materializedComponents() const;
 
         // Executes a parsed command and returns the output
         std::string executeCommand(const commandshell::Command &command);
 
+        // Same, with session settings: a deadline (handlers with one run under the
+        // watchdog; a late one is answered with a timeout error while it is cancelled)
+        // and the output format. JSON/CBOR responses come from a streaming encoder;
+        // `help registry` dumps the whole registry.
+        std::string executeCommand(const commandshell::Command& command, const commandshell::ExecutionOptions& options);
+
+        // Start a command. Resumable commands return their step function without running it;
+        // everything else runs to completion, fills output and returns an empty step.
+        commandshell::CommandStep startCommand(const commandshell::Command& command, std::string& output,
+                                               const commandshell::ExecutionOptions& options = {});
+
+        // Declared lane of a command; none for unknown commands, instances and
+        // lazy components not built yet. Lock-free, so producers may call it.
+        std::optional<commandshell::CommandPriority> commandPriority(const commandshell::Command& command) const;
+
+        // Event bus shared by all sessions; components publish state changes here
+        commandshell::EventBus& events();
+
+        // Publish on the event bus stamped with the shell clock
+        void publishEvent(const std::string& topic, const std::string& payload);
+
+        // Counters of deadline-bound handlers
+        commandshell::Watchdog::Stats watchdogStats() const;
+
+        /* Server-side macros: a named `;`-separated command sequence with $1..$9
+        *  placeholders, parsed and resolved to handlers once at definition (and
+        *  again only after the registry changes). Running one executes every
+        *  step in the engine and returns their outputs as one response: each step
+        *  is bounded by options.deadlineMs (and its own deadline) and the combined
+        *  text is encoded in options.format. Also the `macro` built-in:
+        *  define/run/list/delete. reply receives the confirmation or the
+        *  "Error: ..." message.
+        */
+        bool defineMacro(const std::string& name, const std::string& body, std::string* reply = nullptr);
+        bool deleteMacro(const std::string& name);
+        std::string runMacro(const std::string& name, const std::vector<std::string>& args,
+                             const commandshell::ExecutionOptions& options = {});
+
+        // Register a filter usable after `|` (replaces one with the same name)
+        void registerFilter(const commandshell::FilterDetails& filter);
+
+        // Executes source and streams its output line by line through the filter stages.
+        // options.deadlineMs bounds the source; the filtered text is encoded in options.format.
+        std::string executePipeline(const commandshell::Command& source, const std::vector<commandshell::PipelineStage>& stages,
+                                    const commandshell::ExecutionOptions& options = {});
+
+        // Drop memoized outputs (all, per component, or per command)
+        void invalidateCache();
+        void invalidateCache(const std::string& component);
+        void invalidateCache(const std::string& component, const std::string& command);
+
+        // Bound the memory used by memoized outputs
+        void setCacheLimits(size_t maxEntries, size_t maxBytes);
+
+        commandshell::CommandCache::Stats cacheStats() const;
+
+        // Replace the monotonic clock (microseconds); useful for simulated time in tests.
+        // It must not wrap: extend a 32-bit timer such as Arduino micros() to 64 bits.
+        // Command deadlines follow it too, so watchdog workers call it from their threads.
+        void setClock(std::function<uint64_t()> nowUs);
+
+        // Current time from the configured clock in microseconds
+        uint64_t nowMicros() const;
+
+        // Admission limits applied by each CommandShellIO session: a global default
+        // and per-component overrides (the component policy wins when both exist)
+        void setAdmissionPolicy(const commandshell::AdmissionPolicy& policy);
+        void setAdmissionPolicy(const std::string& component, const commandshell::AdmissionPolicy& policy);
+        void clearAdmissionPolicies();
+
+        // Effective policy for a component, or nullptr when unlimited.
+        // perComponent is set when the policy is a component override.
+        const commandshell::AdmissionPolicy* admissionPolicyFor(const std::string& component, bool* perComponent = nullptr) const;
+
     private:
+        struct ComponentEntry
+        {
+            std::string description; // advertised by a factory; unused once registered eagerly
+            // Built on first use under mMaterializeMutex, hence mutable
+            mutable std::function<commandshell::ComponentCommands()> factory;
+            mutable std::unique_ptr<commandshell::ComponentCommands> owned;
+            // Published once built; read without locking on the dispatch path
+            mutable std::atomic<const commandshell::ComponentCommands*> commands{nullptr};
+        };
+        using ComponentMap = std::map<std::string, ComponentEntry>;
+
+        ComponentMap::iterator resetEntry(ComponentMap::iterator hint, const std::string& name);
+        void storeCommands(ComponentMap::iterator it, commandshell::ComponentCommands&& component);
+        const commandshell::ComponentCommands* findComponent(const std::string& name) const;
+        const commandshell::ComponentCommands* materialize(const std::string& name, const ComponentEntry& entry) const;
+        bool hasComponent(const std::string& name) const;
+        // `help <component> [command | glob]` for the mutable or frozen registry, filtered
+        // and paged by --prefix/--page/--limit; nullopt if unknown
+        std::optional<std::string> renderHelp(const std::string& component, const std::vector<std::string>& args,
+                                              const std::vector<std::string>& options,
+                                              commandshell::OutputFormat format) const;
+        std::string renderRegistryStats() const;
+
+        struct MacroEntry
+        {
+            commandshell::MacroDefinition definition;
+            std::vector<const commandshell::CommandDetails*> handlers; // per step; nullptr = full dispatch
+            uint64_t generation = 0; // registry generation the handlers were resolved against
+        };
+        // Resolve steps to handlers; with error set, unknown targets are reported
+        bool resolveMacro(MacroEntry& entry, std::string* error) const;
+        // Run a pre-resolved handler like executeCommand would: `--format=` stripped,
+        // cache policy, and the tighter of its own and the session deadline
+        std::string executeResolved(const commandshell::CommandDetails& details, const commandshell::Command& command,
+                                    const commandshell::ExecutionOptions& options);
+        // Shared tail of executeCommand and executeResolved once the handler is known
+        std::string executeDetails(const commandshell::CommandDetails& details, const commandshell::Command& command,
+                                   const commandshell::ExecutionOptions& options);
+        std::string renderMacros() const;
+        // `shell memory`: registry bytes per component (string pool line only when frozen)
+        std::string renderMemory() const;
+
+        // Resolve `name[3]` / `name3` to an instance component and index
+        const commandshell::InstanceComponentCommands* findInstanceComponent(const std::string& token, size_t& index, bool& outOfRange) const;
+        std::string executeInstanceCommand(const commandshell::InstanceComponentCommands& comp, size_t index, const commandshell::Command& command,
+                                           commandshell::OutputFormat format) const;
+
+        struct FanOutTarget
+        {
+            std::string name;
+            bool hasCommand;
+        };
+        std::vector<FanOutTarget> fanOutTargets(const std::string& pattern, const std::string& command) const;
+        std::string executeFanOut(const commandshell::Command& command);
+
+        std::optional<std::string> executeCached(const commandshell::Command& command, const commandshell::CommandDetails& details, uint32_t deadlineMs);
+        const commandshell::CommandDetails* findCommandDetails(const commandshell::Command& command) const;
+        // Output of the handler, or nullopt when it missed deadlineMs (0 = unbounded)
+        // Error for a component whose timed-out handler is still running
+        std::optional<std::string> abandonedHandler(const std::string& component) const;
+        std::optional<std::string> runBounded(const commandshell::CommandDetails& details, const commandshell::Command& command, uint32_t deadlineMs);
+        std::optional<std::string> runStructured(const commandshell::CommandDetails& details, const commandshell::Command& command,
+                                                 commandshell::OutputFormat format, uint32_t deadlineMs);
+        // Machine-readable dump of components, commands, options and filters
+        std::string renderRegistry(commandshell::OutputFormat format) const;
+        static std::string runHandler(const commandshell::CommandDetails& details, const commandshell::Command& command,
+                                      const commandshell::CancellationToken& token);
+        void registerBuiltins();
+
         // Registered components by name
-        std::map<std::string, commandshell::ComponentCommands> mComponents;
+        ComponentMap mComponents;
+        mutable detail::Mutex mMaterializeMutex;
+        // Replaces mComponents between freeze() and thaw()
+        std::unique_ptr<commandshell::FrozenRegistry> mFrozen;
+        // Bumped whenever handler addresses may change (macros re-resolve lazily)
+        uint64_t mRegistryGeneration = 0;
+        mutable detail::Mutex mMacroMutex;
+        std::map<std::string, std::shared_ptr<const MacroEntry>> mMacros;
+        // Multi-instance components by base name
+        std::unordered_map<std::string, commandshell::InstanceComponentCommands> mInstanceComponents;
+        // Registered pipeline filters by name
+        std::map<std::string, commandshell::FilterDetails> mFilters;
+        commandshell::CommandCache mCache;
+        commandshell::EventBus mEvents;
+        std::function<uint64_t()> mClock;
+        bool mHasGlobalAdmission = false;
+        commandshell::AdmissionPolicy mGlobalAdmission;
+        std::map<std::string, commandshell::AdmissionPolicy> mComponentAdmission;
+        size_t mFanOutThreads = 4;
+        uint32_t mFanOutTimeoutMs = 5000;
+        size_t mFanOutAbandonLimit = 2;
+        std::atomic<size_t> mFanOutAbandoned{0}; // timed-out handlers still running
+        // Destroyed after the fan-out pool below, whose workers may still call into it
+        commandshell::Watchdog mWatchdog;
+#if COMMANDSHELL_THREADS
+        // Declared last so workers are joined before the rest of the shell is destroyed
+        detail::Mutex mPoolMutex;
+        std::unique_ptr<commandshell::ThreadPool> mPool;
+#endif
     };
 } // namespace commandshell
 #endif // COMMAND_SHELL_HPP
@@ -0,0 +1,57 @@
+#ifndef COMMANDSHELL_CONFIG_HPP
+#define COMMANDSHELL_CONFIG_HPP
+
+// Threading support. Hosted builds get real mutexes; Arduino cores generally
+// lack std::thread/std::mutex, so locking compiles down to no-ops there.
+// Override by defining COMMANDSHELL_THREADS to 0 or 1 before including.
+#ifndef COMMANDSHELL_THREADS
+#if defined(ARDUINO)
+#define COMMANDSHELL_THREADS 0
+#else
+#define COMMANDSHELL_THREADS 1
+#endif
+#endif
+
+// Span tracing (see Trace.hpp). Off unless defined to 1, e.g. by the CMake
+// option ENABLE_TRACE; when off the instrumentation compiles to nothing.
+#ifndef COMMANDSHELL_TRACE
+#define COMMANDSHELL_TRACE 0
+#endif
+
+#if COMMANDSHELL_THREADS
+#include <mutex>
+#endif
+
+namespace commandshell {
+namespace detail {
+#if COMMANDSHELL_THREADS
+    using Mutex = std::mutex;
+#else
+    // Stand-in used on single-threaded targets
+    struct Mutex
+    {
+        void lock() {}
+        void unlock() {}
+        bool try_lock() { return true; }
+    };
+#endif
+
+    // Minimal scoped lock that works with both Mutex variants
+    template <typename M>
+    class ScopedLock
+    {
+    public:
+        explicit ScopedLock(M& m) : mMutex(m) { mMutex.lock(); }
+        ~ScopedLock() { mMutex.unlock(); }
+        ScopedLock(const ScopedLock&) = delete;
+        ScopedLock& operator=(const ScopedLock&) = delete;
+
+    private:
+        M& mMutex;
+    };
+
+    using Lock = ScopedLock<Mutex>;
+} // namespace detail
+} // namespace commandshell
+
+#endif // COMMANDSHELL_CONFIG_HPP
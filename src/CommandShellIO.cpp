@@ -1,66 +1,83 @@
 #include "CommandShellIO.hpp"
 #include "CommandShell.hpp"
+#include "InputJournal.hpp"
+#include "OutputQueue.hpp"
+#include "StructuredOutput.hpp"
+#include "Trace.hpp"
 
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <string>
 
 using namespace commandshell;
 
 CommandShellIO::CommandShellIO(CommandShell &shell, bool echo, std::string promptText)
-    : mCommandShell(shell), mEchoInput(echo), mCurrentInput(""), mOnOutputCallback(nullptr), mPromptText(std::move(promptText)) {}
+    : mCommandShell(shell), mEchoInput(echo), mOnOutputCallback(nullptr), mPromptText(std::move(promptText)) {}
+
+CommandShellIO::~CommandShellIO()
+{
+    if (mSubscriber != 0) {
+        mCommandShell.events().removeSubscriber(mSubscriber);
+    }
+}
 
 void CommandShellIO::input(std::string &promptPart)
 {
-    if(mEchoInput && mOnOutputCallback)
+    COMMANDSHELL_TRACE_SCOPE("io.input");
+    if(mRecorder)
     {
-        mOnOutputCallback(promptPart);
+        mRecorder->record(promptPart.data(), promptPart.size(), mCommandShell.nowMicros());
     }
 
-    mCurrentInput += promptPart;
-    bool isEndofLine = false;
-    for(auto c : promptPart) {
-        if(c == '\n' || c == '\r') {
-            isEndofLine = true;
-            break;
-        }
+    // A slow sink: hold input instead of producing more output
+    if(inputPaused() || !mHeldInput.empty())
+    {
+        const size_t room = kMaxHeldInputBytes - mHeldInput.size();
+        mHeldInput.append(promptPart, 0, room);
+        mDroppedInput += promptPart.size() - std::min(room, promptPart.size());
+        return;
     }
+    processInput(promptPart);
+}
 
-    if(!isEndofLine)
+void CommandShellIO::processInput(std::string &promptPart)
+{
+    // Control bytes (arrows, Ctrl-R, ...) and mid-line edits go through the line editor
+    if(mSearching || !mEditor.atRest() || hasControlBytes(promptPart))
     {
+        processKeys(promptPart);
         return;
     }
 
-    // Trim at first newline for parsing
-    size_t eol = mCurrentInput.find_first_of("\r\n");
-    auto commandStr = (eol == std::string::npos) ? mCurrentInput : mCurrentInput.substr(0, eol);
-    auto commandParts = splitInput(commandStr);
-
-    std::string output;
-    Command command;
-    if(commandParts.empty()) {
-        output = ""; // No-op on empty input
-    }
-    else if(commandParts.size() < 2) {
-        // Allow bare `help` to map to `help list`
-        if (commandParts.size() == 1 && commandParts[0] == "help") {
-            command.component = "help";
-            command.command = "list";
-        } else {
-            output = "Error: Incomplete command.\n";
-        }
-    } else {
-        command = parseCommand(commandParts);
-        // Execute via CommandShell if a command is registered
-        output = mCommandShell.executeCommand(command);
+    if(mEchoInput && mOnOutputCallback)
+    {
+        COMMANDSHELL_TRACE_SCOPE("io.output");
+        mOnOutputCallback(promptPart);
     }
 
-    mCurrentInput.clear();
+    std::string commandStr;
+    {
+        COMMANDSHELL_TRACE_SCOPE("io.assembleLine");
+        mEditor.append(promptPart);
+        bool isEndofLine = false;
+        for(auto c : promptPart) {
+            if(c == '\n' || c == '\r') {
+                isEndofLine = true;
+                break;
+            }
+        }
 
-    if(mOnOutputCallback) {
-        mOnOutputCallback(output);
-    } 
+        if(!isEndofLine)
+        {
+            return;
+        }
 
-    printPrompt();
+        // Trim at first newline for parsing
+        commandStr = mEditor.take();
+        commandStr.resize(commandStr.find_first_of("\r\n"));
+    }
+    submitLine(commandStr);
 }
 
 void CommandShellIO::input(char *promptPart, size_t size)
@@ -75,6 +92,26 @@ void CommandShellIO::setOutputCallback(std::function<void(const std::string &)>
     printPrompt();
 }
 
+void CommandShellIO::setOutputQueue(OutputQueue* queue)
+{
+    mOutputQueue = queue;
+    if (queue == nullptr) {
+        mOnOutputCallback = nullptr;
+        return;
+    }
+    setOutputCallback([queue](const std::string& s) { queue->push(s); });
+}
+
+bool CommandShellIO::inputPaused() const
+{
+    return mOutputQueue != nullptr && mOutputQueue->paused();
+}
+
+uint64_t CommandShellIO::droppedInputBytes() const
+{
+    return mDroppedInput;
+}
+
 void CommandShellIO::printPrompt()
 {
     if (mOnOutputCallback) {
@@ -82,10 +119,744 @@ void CommandShellIO::printPrompt()
     }
 }
 
+void CommandShellIO::setHistoryLimits(size_t capacityBytes, size_t maxEntries)
+{
+    mHistory.configure(capacityBytes, maxEntries);
+    mHistoryAge = kNoHistory;
+}
+
+const CommandHistory& CommandShellIO::history() const
+{
+    return mHistory;
+}
+
+void CommandShellIO::poll(uint32_t budgetUs)
+{
+    if (!mHeldInput.empty() && !inputPaused()) {
+        std::string held;
+        held.swap(mHeldInput);
+        processInput(held);
+    }
+    if (inputPaused()) {
+        return; // events and watches wait too, so the queue can drain
+    }
+
+    deliverEvents();
+    if (!mActiveTask) {
+        runWatches();
+    }
+
+    if (mActiveTask) {
+        stepActiveTask(budgetUs);
+        if (mActiveTask) {
+            return;
+        }
+    }
+
+    while (!mPendingLines.empty() && !mActiveTask) {
+        const std::string& line = mPendingLines.front();
+        auto parts = splitInput(line);
+        std::string component = parts.empty() ? std::string{} : std::string(parts[0]);
+        bool perComponent = false;
+        const AdmissionPolicy* policy = mCommandShell.admissionPolicyFor(component, &perComponent);
+        if (policy && !bucketFor(perComponent ? component : std::string{}).tryTake(*policy, mCommandShell.nowMicros())) {
+            return; // still over budget; retry on the next poll
+        }
+        std::string next = std::move(mPendingLines.front());
+        mPendingLines.pop_front();
+        ++mAdmissionStats.admitted;
+        runLine(next);
+    }
+}
+
+bool CommandShellIO::isBusy() const
+{
+    return static_cast<bool>(mActiveTask);
+}
+
+const AdmissionStats& CommandShellIO::admissionStats() const
+{
+    return mAdmissionStats;
+}
+
+size_t CommandShellIO::pendingLines() const
+{
+    return mPendingLines.size();
+}
+
+void CommandShellIO::setInputRecorder(InputRecorder* recorder)
+{
+    mRecorder = recorder;
+}
+
+void CommandShellIO::setCommandDeadline(uint32_t deadlineMs)
+{
+    mExecutionOptions.deadlineMs = deadlineMs;
+}
+
+void CommandShellIO::setOutputFormat(OutputFormat format)
+{
+    mExecutionOptions.format = format;
+}
+
+void CommandShellIO::setEventOptions(const EventBus::Options& options)
+{
+    mEventOptions = options;
+    if (mSubscriber != 0) {
+        // Re-create the mailbox with the new limits, keeping the subscriptions
+        auto& bus = mCommandShell.events();
+        auto patterns = bus.subscriptions(mSubscriber);
+        bus.removeSubscriber(mSubscriber);
+        mSubscriber = bus.addSubscriber(mEventOptions);
+        mReportedDrops = 0;
+        for (const auto& p : patterns) {
+            bus.subscribe(mSubscriber, p);
+        }
+    }
+}
+
+bool CommandShellIO::subscribe(const std::string& pattern)
+{
+    if (mSubscriber == 0) {
+        mSubscriber = mCommandShell.events().addSubscriber(mEventOptions);
+    }
+    return mCommandShell.events().subscribe(mSubscriber, pattern);
+}
+
+bool CommandShellIO::unsubscribe(const std::string& pattern)
+{
+    return mSubscriber != 0 && mCommandShell.events().unsubscribe(mSubscriber, pattern);
+}
+
+EventBus::Stats CommandShellIO::eventStats() const
+{
+    return mSubscriber == 0 ? EventBus::Stats{} : mCommandShell.events().stats(mSubscriber);
+}
+
+uint32_t CommandShellIO::startWatch(const std::string& line, uint32_t intervalMs, uint32_t count, bool diff, std::string* error)
+{
+    auto fail = [error](std::string message) -> uint32_t {
+        if (error) *error = std::move(message);
+        return 0;
+    };
+    if (mWatches.size() >= kMaxWatches) {
+        return fail("Error: too many watches (max " + std::to_string(kMaxWatches) + ")\n");
+    }
+    if (count == 0 && intervalMs < kMinWatchIntervalMs) {
+        return fail("Error: watch interval must be at least " + std::to_string(kMinWatchIntervalMs) + " ms\n");
+    }
+    auto words = splitInput(line);
+    if (!words.empty() && (words[0] == "watch" || words[0] == "repeat" || words[0] == "macro")) {
+        return fail("Error: cannot " + std::string(count == 0 ? "watch" : "repeat") + " '" + std::string(words[0]) + "' commands\n");
+    }
+
+    WatchScheduler::Watch watch;
+    std::string parseError;
+    if (!parseLine(line, watch.command, watch.stages, parseError)) {
+        return fail(parseError.empty() ? std::string{"Error: Incomplete command.\n"} : parseError);
+    }
+    watch.line = line;
+    watch.intervalMs = intervalMs;
+    watch.remaining = count;
+    watch.diff = diff;
+    return mWatches.add(std::move(watch), mCommandShell.nowMicros());
+}
+
+bool CommandShellIO::stopWatch(uint32_t id)
+{
+    return mWatches.stop(id);
+}
+
+size_t CommandShellIO::stopWatches()
+{
+    return mWatches.stopAll();
+}
+
+const WatchScheduler& CommandShellIO::watches() const
+{
+    return mWatches;
+}
+
 /******************** Private methods *******************/
 
+bool CommandShellIO::hasControlBytes(const std::string& chunk)
+{
+    for (char c : chunk) {
+        auto u = static_cast<unsigned char>(c);
+        if ((u < 0x20 && c != '\n' && c != '\r') || u == 0x7f) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CommandShellIO::submitLine(const std::string& line)
+{
+    mHistory.push(line);
+    mHistoryAge = kNoHistory;
+
+    if (mActiveTask) {
+        // A resumable command owns the session; run this line after it
+        if (mPendingLines.size() < kMaxBusyLines) {
+            mPendingLines.push_back(line);
+            ++mAdmissionStats.queued;
+        } else if (mOnOutputCallback) {
+            mOnOutputCallback("Error: busy\n");
+        }
+        return;
+    }
+
+    std::string error;
+    switch (admit(line, error)) {
+    case Admission::Run:
+        runLine(line);
+        break;
+    case Admission::Queued:
+        break; // output and prompt follow when poll() runs it
+    case Admission::Rejected:
+        if(mOnOutputCallback) {
+            mOnOutputCallback(error);
+        }
+        printPrompt();
+        break;
+    case Admission::Dropped:
+        printPrompt();
+        break;
+    }
+}
+
+void CommandShellIO::runLine(const std::string& line)
+{
+    CommandStep task;
+    ++mExecuting;
+    std::string output = executeLine(line, &task);
+    if (task) {
+        // Resumable: poll() advances it and prints the prompt when it finishes
+        mActiveTask = std::move(task);
+        return;
+    }
+    --mExecuting;
+
+    if(mOnOutputCallback) {
+        COMMANDSHELL_TRACE_SCOPE("io.output");
+        mOnOutputCallback(output);
+    }
+
+    printPrompt();
+}
+
+void CommandShellIO::stepActiveTask(uint32_t budgetUs)
+{
+    const uint64_t start = mCommandShell.nowMicros();
+    std::string output;
+    bool done = false;
+    do {
+        done = mActiveTask(output);
+    } while (!done && mCommandShell.nowMicros() - start < budgetUs);
+
+    if (!output.empty() && mOnOutputCallback) {
+        mOnOutputCallback(output);
+    }
+    if (done) {
+        mActiveTask = nullptr;
+        --mExecuting;
+        printPrompt();
+    }
+}
+
+CommandShellIO::Admission CommandShellIO::admit(const std::string& line, std::string& error)
+{
+    auto parts = splitInput(line);
+    if (parts.empty()) {
+        return Admission::Run;
+    }
+    const std::string component(parts[0]);
+    bool perComponent = false;
+    const AdmissionPolicy* policy = mCommandShell.admissionPolicyFor(component, &perComponent);
+    if (policy == nullptr) {
+        ++mAdmissionStats.admitted;
+        return Admission::Run;
+    }
+
+    // Keep order: once lines are parked, later ones queue behind them
+    bool overflow = !mPendingLines.empty() && policy->overflow == AdmissionPolicy::Overflow::Queue;
+    if (!overflow && policy->maxInFlight != 0 && mExecuting >= policy->maxInFlight) {
+        overflow = true;
+        error = "Error: too many commands in flight\n";
+    }
+    if (!overflow && !bucketFor(perComponent ? component : std::string{}).tryTake(*policy, mCommandShell.nowMicros())) {
+        overflow = true;
+        error = "Error: rate limit exceeded\n";
+    }
+    if (!overflow) {
+        ++mAdmissionStats.admitted;
+        return Admission::Run;
+    }
+
+    switch (policy->overflow) {
+    case AdmissionPolicy::Overflow::Queue:
+        if (mPendingLines.size() < policy->maxQueued) {
+            mPendingLines.push_back(line);
+            ++mAdmissionStats.queued;
+            return Admission::Queued;
+        }
+        error = "Error: command queue full\n";
+        ++mAdmissionStats.rejected;
+        return Admission::Rejected;
+    case AdmissionPolicy::Overflow::Drop:
+        ++mAdmissionStats.dropped;
+        return Admission::Dropped;
+    case AdmissionPolicy::Overflow::Reject:
+        break;
+    }
+    ++mAdmissionStats.rejected;
+    return Admission::Rejected;
+}
+
+TokenBucket& CommandShellIO::bucketFor(const std::string& component)
+{
+    return mBuckets[component];
+}
+
+void CommandShellIO::processKeys(const std::string& chunk)
+{
+    using Action = LineEditor::Action;
+
+    std::string echo;
+    auto flushEcho = [this, &echo]() {
+        if (mEchoInput && mOnOutputCallback && !echo.empty()) {
+            mOnOutputCallback(echo);
+        }
+        echo.clear();
+    };
+
+    LineEditor::KeyEvent key;
+    for (char c : chunk) {
+        if (!mEditor.decode(c, key)) {
+            continue;
+        }
+        if (mSearching && !handleSearchKey(key, echo)) {
+            continue;
+        }
+        switch (mEditor.apply(key, echo)) {
+        case Action::Submit:
+            echo += key.ch;
+            flushEcho();
+            submitLine(mEditor.take());
+            break;
+        case Action::HistoryOlder:
+            recallHistory(true, echo);
+            break;
+        case Action::HistoryNewer:
+            recallHistory(false, echo);
+            break;
+        case Action::Search:
+            mSearching = true;
+            mSearchQuery.clear();
+            mSearchAge = 0;
+            renderSearch(echo);
+            break;
+        case Action::Interrupt: {
+            // Ctrl-C drops the line being typed and cancels this session's watches
+            mEditor.take();
+            mHistoryAge = kNoHistory;
+            echo += "^C\n";
+            flushEcho();
+            const size_t stopped = stopWatches();
+            if (stopped != 0 && mOnOutputCallback) {
+                mOnOutputCallback("Stopped " + std::to_string(stopped) + (stopped == 1 ? " watch\n" : " watches\n"));
+            }
+            printPrompt();
+            break;
+        }
+        case Action::None:
+            break;
+        }
+    }
+    flushEcho();
+}
+
+void CommandShellIO::recallHistory(bool older, std::string& echo)
+{
+    if (mHistory.empty()) {
+        return;
+    }
+    if (older) {
+        if (mHistoryAge == kNoHistory) {
+            mSavedInput = mEditor.line();
+            mHistoryAge = 0;
+        } else if (mHistoryAge + 1 < mHistory.size()) {
+            ++mHistoryAge;
+        }
+        mEditor.setLine(std::string(mHistory.at(mHistoryAge)), echo);
+    } else {
+        if (mHistoryAge == kNoHistory) {
+            return;
+        }
+        if (mHistoryAge == 0) {
+            mHistoryAge = kNoHistory;
+            mEditor.setLine(mSavedInput, echo);
+        } else {
+            --mHistoryAge;
+            mEditor.setLine(std::string(mHistory.at(mHistoryAge)), echo);
+        }
+    }
+}
+
+bool CommandShellIO::handleSearchKey(const LineEditor::KeyEvent& key, std::string& echo)
+{
+    using Key = LineEditor::Key;
+
+    auto finish = [this, &echo](bool accept) {
+        auto age = mHistory.searchOlder(mSearchQuery, mSearchAge);
+        if (accept && !mSearchQuery.empty() && age) {
+            mEditor.assign(std::string(mHistory.at(*age)));
+        }
+        mSearching = false;
+        mEditor.redraw(mPromptText, echo);
+    };
+
+    switch (key.key) {
+    case Key::CtrlR: {
+        // Next older match
+        auto age = mHistory.searchOlder(mSearchQuery, mSearchAge + 1);
+        if (age) mSearchAge = *age;
+        break;
+    }
+    case Key::Backspace:
+    case Key::Delete:
+        if (!mSearchQuery.empty()) mSearchQuery.pop_back();
+        mSearchAge = 0;
+        break;
+    case Key::CtrlG:
+        // Abort search, keep the line as it was
+        finish(false);
+        return false;
+    case Key::CtrlC:
+        finish(false);
+        return true;
+    case Key::Escape:
+        finish(true);
+        return false;
+    case Key::Char: {
+        mSearchQuery += key.ch;
+        auto age = mHistory.searchOlder(mSearchQuery, mSearchAge);
+        if (age) mSearchAge = *age;
+        break;
+    }
+    default:
+        // Enter and cursor keys accept the match and then act on it
+        finish(true);
+        return true;
+    }
+    renderSearch(echo);
+    return false;
+}
+
+void CommandShellIO::renderSearch(std::string& echo) const
+{
+    auto age = mHistory.searchOlder(mSearchQuery, mSearchAge);
+    std::string_view match = (!mSearchQuery.empty() && age) ? mHistory.at(*age) : std::string_view{};
+    echo += "\r(reverse-i-search)`" + mSearchQuery + "': ";
+    echo.append(match.data(), match.size());
+    echo += "\x1b[K";
+}
+
+void CommandShellIO::deliverEvents()
+{
+    if (mSubscriber == 0) {
+        return;
+    }
+    std::vector<EventBus::Event> events;
+    mCommandShell.events().collect(mSubscriber, mCommandShell.nowMicros(), events, kMaxEventsPerPoll);
+    const uint64_t dropped = mCommandShell.events().stats(mSubscriber).dropped;
+    if ((events.empty() && dropped == mReportedDrops) || !mOnOutputCallback) {
+        return;
+    }
+
+    std::string out;
+    const OutputFormat format = mExecutionOptions.format;
+    if (dropped != mReportedDrops) {
+        if (format == OutputFormat::Text) {
+            out += "[event] dropped " + std::to_string(dropped - mReportedDrops) + " (slow subscriber)\n";
+        } else {
+            writeStructured(format, out, [&](StructuredWriter& w) {
+                w.beginObject();
+                w.field("dropped", dropped - mReportedDrops);
+                w.endObject();
+            });
+        }
+        mReportedDrops = dropped;
+    }
+    for (const auto& e : events) {
+        if (format == OutputFormat::Text) {
+            out += "[event] " + e.topic;
+            if (!e.payload.empty()) {
+                out += ' ';
+                out.append(e.payload, 0, e.payload.find_last_not_of('\n') + 1);
+            }
+            out += '\n';
+        } else {
+            writeStructured(format, out, [&](StructuredWriter& w) {
+                w.beginObject();
+                w.field("event", e.topic);
+                w.field("payload", e.payload);
+                w.field("coalesced", e.coalesced);
+                w.endObject();
+            });
+        }
+    }
+    mOnOutputCallback(out);
+}
+
+void CommandShellIO::runWatches()
+{
+    if (mWatches.size() == 0) {
+        return;
+    }
+    std::vector<WatchScheduler::Update> updates;
+    mWatches.run(mCommandShell.nowMicros(), kMaxWatchRunsPerPoll, [this](const WatchScheduler::Watch& w) -> std::optional<std::string> {
+        if (!admitWatch(w.command.component)) {
+            return std::nullopt;
+        }
+        return w.stages.empty() ? mCommandShell.executeCommand(w.command, mExecutionOptions)
+                                : mCommandShell.executePipeline(w.command, w.stages, mExecutionOptions);
+    }, updates);
+    if (updates.empty() || !mOnOutputCallback) {
+        return;
+    }
+
+    std::string out;
+    const OutputFormat format = mExecutionOptions.format;
+    for (const auto& u : updates) {
+        if (format != OutputFormat::Text) {
+            writeStructured(format, out, [&](StructuredWriter& w) {
+                w.beginObject();
+                w.field("watch", u.id);
+                w.field("command", u.line);
+                if (u.changed) {
+                    w.field(u.diff ? "diff" : "output", u.text);
+                }
+                if (u.finished) {
+                    w.field("runs", u.runs);
+                    w.field("changes", u.changes);
+                }
+                w.endObject();
+            });
+            continue;
+        }
+        const std::string header = "[watch " + std::to_string(u.id) + "] ";
+        if (u.changed) {
+            out += header + u.line + "\n" + u.text;
+            if (!u.text.empty() && u.text.back() != '\n') {
+                out += '\n';
+            }
+        }
+        if (u.finished) {
+            out += header + "done: " + std::to_string(u.runs) + " runs, " + std::to_string(u.changes) + " changed\n";
+        }
+    }
+    mOnOutputCallback(out);
+}
+
+bool CommandShellIO::admitWatch(const std::string& component)
+{
+    // Watch runs spend the same tokens as typed lines; a refused run waits for a later poll
+    bool perComponent = false;
+    const AdmissionPolicy* policy = mCommandShell.admissionPolicyFor(component, &perComponent);
+    if (policy != nullptr && !bucketFor(perComponent ? component : std::string{}).tryTake(*policy, mCommandShell.nowMicros())) {
+        return false;
+    }
+    ++mAdmissionStats.admitted;
+    return true;
+}
+
+std::string CommandShellIO::executeWatchCommand(const std::vector<std::string_view>& words, const std::string& line)
+{
+    const bool repeat = words[0] == "repeat";
+    const std::string usage = repeat ? "Error: repeat <n> [--every=<ms>] [--diff] <command>\n"
+                                     : "Error: watch <ms> [--diff] <command> | watch list | watch stop [<id>|all]\n";
+    if (words.size() < 2) {
+        return usage;
+    }
+
+    if (!repeat && words[1] == "list") {
+        if (mWatches.size() == 0) {
+            return "No watches\n";
+        }
+        std::string out = "Watches:\n";
+        for (const auto& w : mWatches.watches()) {
+            out += "  " + std::to_string(w.id) + ": " + w.line + " (";
+            out += w.remaining != 0 ? std::to_string(w.remaining) + " runs left" : "every " + std::to_string(w.intervalMs) + " ms";
+            out += ", " + std::to_string(w.runs) + " runs, " + std::to_string(w.changes) + " changed";
+            if (w.deferred != 0) {
+                out += ", " + std::to_string(w.deferred) + " deferred";
+            }
+            out += ")\n";
+        }
+        return out;
+    }
+    if (!repeat && words[1] == "stop") {
+        if (words.size() < 3 || words[2] == "all") {
+            const size_t stopped = stopWatches();
+            return "Stopped " + std::to_string(stopped) + (stopped == 1 ? " watch\n" : " watches\n");
+        }
+        const std::string id(words[2]);
+        return stopWatch(static_cast<uint32_t>(std::strtoul(id.c_str(), nullptr, 10))) ? "Stopped watch " + id + "\n"
+                                                                                       : "Error: no watch " + id + "\n";
+    }
+
+    const std::string number(words[1]);
+    char* end = nullptr;
+    const unsigned long value = std::strtoul(number.c_str(), &end, 10);
+    if (end == number.c_str() || *end != '\0' || value == 0 || value > UINT32_MAX) {
+        return usage;
+    }
+
+    uint32_t intervalMs = repeat ? 0 : static_cast<uint32_t>(value);
+    bool diff = false;
+    size_t i = 2;
+    for (; i < words.size() && words[i].size() > 2 && words[i].substr(0, 2) == "--"; ++i) {
+        if (words[i] == "--diff") {
+            diff = true;
+        } else if (repeat && words[i].substr(0, 8) == "--every=") {
+            intervalMs = static_cast<uint32_t>(std::strtoul(std::string(words[i].substr(8)).c_str(), nullptr, 10));
+        } else {
+            return "Error: unknown option '" + std::string(words[i]) + "'\n";
+        }
+    }
+    if (i >= words.size()) {
+        return usage;
+    }
+
+    const std::string body = line.substr(static_cast<size_t>(words[i].data() - line.data()));
+    std::string error;
+    const uint32_t id = startWatch(body, intervalMs, repeat ? static_cast<uint32_t>(value) : 0, diff, &error);
+    if (id == 0) {
+        return error;
+    }
+    std::string reply = "Watch " + std::to_string(id) + ": '" + body + "' ";
+    if (repeat) {
+        reply += std::to_string(value) + (value == 1 ? " time" : " times");
+        if (intervalMs != 0) reply += ", every " + std::to_string(intervalMs) + " ms";
+    } else {
+        reply += "every " + std::to_string(intervalMs) + " ms";
+    }
+    return reply + (diff ? ", as diff\n" : "\n");
+}
+
+std::string CommandShellIO::executeEventsCommand(const Command& command)
+{
+    const std::string pattern = command.arguments.empty() ? std::string{} : command.arguments[0];
+    if (command.command == "subscribe" || command.command == "unsubscribe") {
+        if (pattern.empty()) {
+            return "Error: events " + command.command + " <topic glob>\n";
+        }
+        const bool changed = command.command == "subscribe" ? subscribe(pattern) : unsubscribe(pattern);
+        if (!changed) {
+            return std::string(command.command == "subscribe" ? "Already subscribed to '" : "Not subscribed to '")
+                + pattern + "'\n";
+        }
+        return (command.command == "subscribe" ? "Subscribed to '" : "Unsubscribed from '") + pattern + "'\n";
+    }
+
+    // events list
+    const auto stats = eventStats();
+    std::string out = "Subscriptions:";
+    if (mSubscriber != 0) {
+        for (const auto& p : mCommandShell.events().subscriptions(mSubscriber)) {
+            out += " " + p;
+        }
+    }
+    out += "\nEvents: " + std::to_string(stats.published) + " published, "
+        + std::to_string(stats.delivered) + " delivered, "
+        + std::to_string(stats.coalesced) + " coalesced, "
+        + std::to_string(stats.dropped) + " dropped\n";
+    return out;
+}
+
+std::string CommandShellIO::executeLine(const std::string& line, CommandStep* task)
+{
+    // The macro body is taken verbatim so options, ';' and '|' reach the parser in place
+    auto words = splitInput(line);
+    if (words.size() >= 2 && words[0] == "macro" && words[1] == "define") {
+        if (words.size() < 4) {
+            return "Error: macro define <name> <step> [; <step>...]\n";
+        }
+        std::string reply;
+        mCommandShell.defineMacro(std::string(words[2]), line.substr(static_cast<size_t>(words[3].data() - line.data())), &reply);
+        return reply;
+    }
+    // Session-scoped periodic commands; the watched line is taken verbatim too
+    if (!words.empty() && (words[0] == "watch" || words[0] == "repeat")) {
+        return executeWatchCommand(words, line);
+    }
+
+    Command command;
+    std::vector<PipelineStage> stages;
+    std::string error;
+    if (!parseLine(line, command, stages, error)) {
+        return error;
+    }
+
+    if (stages.empty()) {
+        // Session-scoped event commands; `events publish` goes to the shell
+        if (command.component == "events"
+            && (command.command == "subscribe" || command.command == "unsubscribe" || command.command == "list")) {
+            return executeEventsCommand(command);
+        }
+        // Execute via CommandShell if a command is registered
+        if (task != nullptr) {
+            std::string output;
+            *task = mCommandShell.startCommand(command, output, mExecutionOptions);
+            return output;
+        }
+        return mCommandShell.executeCommand(command, mExecutionOptions);
+    }
+    return mCommandShell.executePipeline(command, stages, mExecutionOptions);
+}
+
+bool CommandShellIO::parseLine(const std::string& line, Command& command, std::vector<PipelineStage>& stages, std::string& error)
+{
+    // `a x | b y | ...`: a standalone `|` token starts a filter, so `a|b` stays one argument
+    const auto parts = splitInput(line);
+    const auto isBar = [](std::string_view part) { return part == "|"; };
+    auto bar = std::find_if(parts.begin(), parts.end(), isBar);
+    const std::vector<std::string_view> commandParts(parts.begin(), bar);
+
+    if(commandParts.empty()) {
+        // A blank line is not an error
+        error = (bar == parts.end()) ? std::string{} : std::string{"Error: Incomplete command.\n"};
+        return false;
+    }
+    else if(commandParts.size() < 2) {
+        // Allow bare `help` to map to `help list`
+        if (commandParts.size() == 1 && commandParts[0] == "help") {
+            command.component = "help";
+            command.command = "list";
+        } else {
+            error = "Error: Incomplete command.\n";
+            return false;
+        }
+    } else {
+        command = parseCommand(commandParts);
+    }
+
+    while (bar != parts.end()) {
+        auto next = std::find_if(bar + 1, parts.end(), isBar);
+        if (next == bar + 1) {
+            error = "Error: Empty pipeline stage.\n";
+            return false;
+        }
+        stages.push_back(parseStage(std::vector<std::string_view>(bar + 1, next)));
+        bar = next;
+    }
+    return true;
+}
+
 std::vector<std::string_view> CommandShellIO::splitInput(const std::string& input)
 {
+    COMMANDSHELL_TRACE_SCOPE("io.splitInput");
     std::vector<std::string_view> result;
     size_t start = 0;
     size_t end = 0;
@@ -106,6 +877,7 @@ std::vector<std::string_view> CommandShellIO::splitInput(const std::string& inpu
 
 commandshell::Command CommandShellIO::parseCommand(const std::vector<std::string_view>& commandParts)
 {
+    COMMANDSHELL_TRACE_SCOPE("io.parseCommand");
     commandshell::Command command;
     command.component = std::string(commandParts[0]);
     command.command = std::string(commandParts[1]);
@@ -119,3 +891,18 @@ commandshell::Command CommandShellIO::parseCommand(const std::vector<std::string
     }
     return command;
 }
+
+commandshell::PipelineStage CommandShellIO::parseStage(const std::vector<std::string_view>& stageParts)
+{
+    commandshell::PipelineStage stage;
+    stage.name = std::string(stageParts[0]);
+    for(size_t i = 1; i < stageParts.size(); ++i) {
+        const auto& part = stageParts[i];
+        if(part.size() > 1 && part[0] == '-') {
+            stage.options.emplace_back(part);
+        } else {
+            stage.arguments.emplace_back(part);
+        }
+    }
+    return stage;
+}
@@ -4,15 +4,28 @@
 #include <functional>
 #include <vector>
 #include <string_view>
+#include <deque>
+#include <map>
 #include "CommandTypes.hpp"
+#include "CommandPipeline.hpp"
+#include "CommandHistory.hpp"
+#include "AdmissionControl.hpp"
+#include "EventBus.hpp"
+#include "LineEditor.hpp"
+#include "WatchScheduler.hpp"
 // Forward declaration to avoid heavy include and keep coupling low
-namespace commandshell { class CommandShell; }
+namespace commandshell { class CommandShell; class InputRecorder; class OutputQueue; }
 
 namespace commandshell {
 class CommandShellIO {
 public:
     // Constructor
     CommandShellIO(CommandShell& shell, bool echoInput = true, std::string promptText = "cmd> ");
+    ~CommandShellIO();
+
+    // A session owns its event subscription
+    CommandShellIO(const CommandShellIO&) = delete;
+    CommandShellIO& operator=(const CommandShellIO&) = delete;
 
     // Get command input with string prompt
     void input(std::string& promptPart);
@@ -23,8 +36,72 @@ public:
     // Set callback for when input is received
     void setOutputCallback(std::function<void(const std::string&)> callback);
 
+    /* Send output through a bounded queue drained apart from command processing
+    *  (replaces the output callback and prints the prompt into the queue;
+    *  nullptr disconnects). While the queue signals backpressure, input chunks
+    *  are held, up to kMaxHeldInputBytes, and processed by poll() once it
+    *  resumes; bytes beyond that are dropped and counted.
+    */
+    void setOutputQueue(OutputQueue* queue);
+    bool inputPaused() const;
+    uint64_t droppedInputBytes() const;
+
     // Print the prompt via output callback (or stdout if none)
     void printPrompt();
+
+    // Size the history buffer (bytes for line text, max number of lines); clears it.
+    // Up/Down recall entries, Ctrl-R starts an incremental reverse search;
+    // Left/Right/Home/End, Backspace and Delete edit anywhere in the line.
+    void setHistoryLimits(size_t capacityBytes, size_t maxEntries);
+
+    const CommandHistory& history() const;
+
+    // Call from the main loop: delivers due events and watch output, advances a running
+    // resumable command for about budgetUs (at least one step; 0 means exactly one), then
+    // runs lines parked by admission control or typed while the session was busy.
+    void poll(uint32_t budgetUs = 0);
+
+    // True while a resumable command is running
+    bool isBusy() const;
+
+    // Admission counters for this session
+    const AdmissionStats& admissionStats() const;
+
+    // Lines waiting in the admission queue
+    size_t pendingLines() const;
+
+    // Journal every input chunk with its arrival time (nullptr disables recording)
+    void setInputRecorder(InputRecorder* recorder);
+
+    // Bound every command run from this session (0 disables); a late handler is
+    // answered with a timeout error so the session never blocks past the deadline
+    void setCommandDeadline(uint32_t deadlineMs);
+
+    // Encode command responses as text (default), JSON or CBOR for this session;
+    // a `--format=` option on a command line overrides it
+    void setOutputFormat(OutputFormat format);
+
+    /* Push notifications: events on matching topics are written to the output
+    *  callback from poll() as `[event] <topic> <payload>`. Same as typing
+    *  `events subscribe <glob>`. Options set the coalesce window and mailbox
+    *  bound; at most kMaxEventsPerPoll events go out per poll().
+    */
+    void setEventOptions(const EventBus::Options& options);
+    bool subscribe(const std::string& pattern);
+    bool unsubscribe(const std::string& pattern);
+    EventBus::Stats eventStats() const;
+
+    /* Periodic commands, as typed `watch <ms> [--diff] <line>` or
+    *  `repeat <n> [--every=<ms>] [--diff] <line>`: the line is parsed once and
+    *  run from poll() on the session clock; output goes out only when it
+    *  changed since the previous run (`[watch <id>] <line>` header, then the
+    *  output or its line diff). count 0 runs until stopped. Ctrl-C, `watch stop`
+    *  or stopWatches() cancel. Returns the watch id, or 0 with error set.
+    */
+    uint32_t startWatch(const std::string& line, uint32_t intervalMs, uint32_t count, bool diff, std::string* error = nullptr);
+    bool stopWatch(uint32_t id);
+    size_t stopWatches();
+    const WatchScheduler& watches() const;
 
 protected:
     // Split input into parts
@@ -33,12 +110,72 @@ protected:
     // Parse command from input parts
     Command parseCommand(const std::vector<std::string_view>& parts);
 
+    // Parse a pipeline filter stage (`name args...`) from input parts
+    PipelineStage parseStage(const std::vector<std::string_view>& parts);
+
+    // Execute one complete line (without line terminator) and return its output.
+    // With task given, a resumable command is started and its step returned there.
+    std::string executeLine(const std::string& line, CommandStep* task = nullptr);
+
 private:
+    static constexpr size_t kNoHistory = static_cast<size_t>(-1);
+    static constexpr size_t kMaxBusyLines = 16;
+    static constexpr size_t kMaxEventsPerPoll = 8;
+    static constexpr size_t kMaxWatches = 64;
+    static constexpr size_t kMaxWatchRunsPerPoll = 16;
+    static constexpr uint32_t kMinWatchIntervalMs = 10;
+    static constexpr size_t kMaxHeldInputBytes = 1024;
+
+    static bool hasControlBytes(const std::string& chunk);
+    void processInput(std::string& chunk);
+    enum class Admission { Run, Queued, Rejected, Dropped };
+
+    void submitLine(const std::string& line);
+    void runLine(const std::string& line);
+    void stepActiveTask(uint32_t budgetUs);
+    Admission admit(const std::string& line, std::string& error);
+    void deliverEvents();
+    std::string executeEventsCommand(const Command& command);
+    void runWatches();
+    bool admitWatch(const std::string& component);
+    std::string executeWatchCommand(const std::vector<std::string_view>& words, const std::string& line);
+    bool parseLine(const std::string& line, Command& command, std::vector<PipelineStage>& stages, std::string& error);
+    TokenBucket& bucketFor(const std::string& component);
+    void processKeys(const std::string& chunk);
+    void recallHistory(bool older, std::string& echo);
+    bool handleSearchKey(const LineEditor::KeyEvent& key, std::string& echo);
+    void renderSearch(std::string& echo) const;
+
     CommandShell& mCommandShell;
     bool mEchoInput;
-    std::string mCurrentInput;
     std::function<void(const std::string&)> mOnOutputCallback;
     std::string mPromptText;
+
+    InputRecorder* mRecorder = nullptr;
+    OutputQueue* mOutputQueue = nullptr;
+    std::string mHeldInput; // arrived while output was paused
+    uint64_t mDroppedInput = 0;
+    ExecutionOptions mExecutionOptions;
+
+    EventBus::Options mEventOptions;
+    EventBus::SubscriberId mSubscriber = 0; // 0 until the first subscription
+    uint64_t mReportedDrops = 0;
+
+    WatchScheduler mWatches;
+
+    AdmissionStats mAdmissionStats;
+    std::deque<std::string> mPendingLines;
+    std::map<std::string, TokenBucket> mBuckets; // "" is the session-wide bucket
+    size_t mExecuting = 0;
+    CommandStep mActiveTask;
+
+    CommandHistory mHistory;
+    LineEditor mEditor;
+    bool mSearching = false;         // Ctrl-R search in progress
+    size_t mHistoryAge = kNoHistory; // entry being shown by Up/Down
+    std::string mSavedInput;         // line being typed before recall started
+    std::string mSearchQuery;
+    size_t mSearchAge = 0;
 };
 } // namespace commandshell
 #endif // COMMANDSHELL_IO_HPP
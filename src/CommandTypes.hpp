@@ -4,8 +4,16 @@
 #include <vector>
 #include <functional>
 #include <optional>
+#include <cstdint>
 
 namespace commandshell {
+    class LineSink; // CommandPipeline.hpp
+    class CancellationToken; // Cancellation.hpp
+    class StructuredWriter; // StructuredOutput.hpp
+
+    // How responses are encoded: human text, or JSON/CBOR documents
+    enum class OutputFormat : uint8_t { Text, Json, Cbor };
+
     struct Command
     {
         std::string component;
@@ -14,6 +22,32 @@ namespace commandshell {
         std::vector<std::string> options;
     };
 
+    /* Result caching policy for a command
+    *  None - always run the handler (default)
+    *  Pure - output depends only on arguments/options; cached until invalidated
+    *  Ttl  - cached output is reused for ttlMs milliseconds
+    */
+    struct CachePolicy
+    {
+        enum class Kind { None, Pure, Ttl };
+        Kind kind = Kind::None;
+        uint32_t ttlMs = 0;
+
+        static CachePolicy pure() { return CachePolicy{Kind::Pure, 0}; }
+        static CachePolicy ttl(uint32_t ms) { return CachePolicy{Kind::Ttl, ms}; }
+    };
+
+    /* Scheduling lane for queued commands (see CommandQueue)
+    *  High is always served first; lower lanes are protected from starvation.
+    */
+    enum class CommandPriority : uint8_t { Low, Normal, High };
+
+    /* One slice of a resumable command
+    *  Called repeatedly (see CommandShellIO::poll); each call performs a bounded
+    *  amount of work, appends any output and returns true once finished.
+    */
+    using CommandStep = std::function<bool(std::string& output)>;
+
     /* Details of a single command
     *  How to define a command:
     *  CommandDetails myCommand = {
@@ -25,6 +59,7 @@ namespace commandshell {
     *           return "Command executed";
     *       }
     *  };
+    *  myCommand.cache = CachePolicy::ttl(1000); // optional memoization
     */
     struct CommandDetails
     {
@@ -33,6 +68,44 @@ namespace commandshell {
 
         // Function to execute the command (arguments, options) -> output
         std::function<std::string(const std::vector<std::string>&, const std::vector<std::string>&)> execute;
+
+        // Optional memoization of the handler output
+        CachePolicy cache{};
+
+        // Optional streaming form used when the command feeds a pipeline (`cmd | head 5`).
+        // Writes output line by line; stops producing once the sink returns false.
+        // If execute is empty, plain execution collects the stream into a string.
+        // Without it, a pipeline runs execute to completion and filters its whole output as one
+        // string, so commands with large output should provide stream.
+        std::function<void(const std::vector<std::string>&, const std::vector<std::string>&, LineSink&)> stream{};
+
+        // Optional resumable form for long-running work on single-loop targets.
+        // Returns the step function (a small state machine) that the session advances
+        // from poll() so other work in the main loop keeps running between slices.
+        std::function<CommandStep(const std::vector<std::string>&, const std::vector<std::string>&)> resumable{};
+
+        // Optional form that receives a cancellation token; preferred over execute when
+        // a deadline applies. Check token.isCancelled() between units of work.
+        std::function<std::string(const std::vector<std::string>&, const std::vector<std::string>&, const CancellationToken&)> cancellable{};
+
+        // Upper bound on handler time in milliseconds (0 = none); the tighter of this
+        // and the session deadline wins
+        uint32_t deadlineMs = 0;
+
+        // Lane used when the command goes through a CommandQueue (`stop` -> High);
+        // unset means the submitting producer's lane
+        std::optional<CommandPriority> priority{};
+
+        // Optional structured form used for JSON/CBOR output; without it the text
+        // output is wrapped as {"output": "..."}
+        std::function<void(const std::vector<std::string>&, const std::vector<std::string>&, StructuredWriter&)> structured{};
+    };
+
+    // Per-call execution settings supplied by the session
+    struct ExecutionOptions
+    {
+        uint32_t deadlineMs = 0; // 0 = no session deadline
+        OutputFormat format = OutputFormat::Text; // `--format=json|cbor` overrides per command
     };
 
     struct OptionDetails
@@ -87,6 +160,60 @@ namespace commandshell {
             return std::nullopt;
         }
     };
+
+    /* Command shared by all instances of a multi-instance component
+    *  The handler receives the instance index parsed from the component token.
+    */
+    struct InstanceCommandDetails
+    {
+        const std::string command;
+        const std::string description;
+
+        // Function to execute the command (instance, arguments, options) -> output
+        std::function<std::string(size_t, const std::vector<std::string>&, const std::vector<std::string>&)> execute;
+    };
+
+    /* One command table for `count` identical instances
+    *  Instances are addressed as `led[3] on` or `led3 on`; no per-instance
+    *  registry entries or handler copies are created.
+    *  InstanceComponentCommands leds{"led", "Board LEDs", 16};
+    *  leds.addCommand({"on", "Turn LED on",
+    *      [&bank](size_t i, const auto& args, const auto& opts) { return bank[i].on(); }});
+    */
+    struct InstanceComponentCommands
+    {
+        std::string component;
+        std::string description;
+        size_t count;
+        std::vector<InstanceCommandDetails> commands;
+        std::vector<OptionDetails> options;
+
+        InstanceComponentCommands(const std::string& comp, const std::string& desc, size_t instances)
+            : component(comp), description(desc), count(instances) {};
+
+        void addCommand(const InstanceCommandDetails& cmd) {
+            commands.push_back(cmd);
+        }
+
+        void addOption(const OptionDetails& opt) {
+            options.push_back(opt);
+        }
+    };
+
+    /* Lazily built component
+    *  Only the name and description are stored at registration; build() runs
+    *  the first time the component is dispatched to or its help is shown.
+    *  ComponentFactory ledFactory{
+    *      "led", "Control the built-in LED",
+    *      [&led]() { return led.buildCommands(); }
+    *  };
+    */
+    struct ComponentFactory
+    {
+        std::string component;
+        std::string description;
+        std::function<ComponentCommands()> build;
+    };
 }
 
 #endif // COMMAND_TYPES_HPP
@@ -0,0 +1,160 @@
+#include "EventBus.hpp"
+#include "Glob.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+using namespace commandshell;
+
+EventBus::SubscriberId EventBus::addSubscriber(const Options& options)
+{
+    detail::Lock lock(mMutex);
+    const SubscriberId id = mNextId++;
+    mSubscribers[id].options = options;
+    return id;
+}
+
+void EventBus::removeSubscriber(SubscriberId id)
+{
+    detail::Lock lock(mMutex);
+    mSubscribers.erase(id);
+}
+
+bool EventBus::subscribe(SubscriberId id, const std::string& pattern)
+{
+    detail::Lock lock(mMutex);
+    auto it = mSubscribers.find(id);
+    if (it == mSubscribers.end())
+    {
+        return false;
+    }
+    auto& patterns = it->second.patterns;
+    if (std::find(patterns.begin(), patterns.end(), pattern) != patterns.end())
+    {
+        return false;
+    }
+    patterns.push_back(pattern);
+    return true;
+}
+
+bool EventBus::unsubscribe(SubscriberId id, const std::string& pattern)
+{
+    detail::Lock lock(mMutex);
+    auto it = mSubscribers.find(id);
+    if (it == mSubscribers.end())
+    {
+        return false;
+    }
+    auto& patterns = it->second.patterns;
+    auto found = std::find(patterns.begin(), patterns.end(), pattern);
+    if (found == patterns.end())
+    {
+        return false;
+    }
+    patterns.erase(found);
+    return true;
+}
+
+std::vector<std::string> EventBus::subscriptions(SubscriberId id) const
+{
+    detail::Lock lock(mMutex);
+    auto it = mSubscribers.find(id);
+    return it == mSubscribers.end() ? std::vector<std::string>{} : it->second.patterns;
+}
+
+void EventBus::publish(const std::string& topic, const std::string& payload, uint64_t nowUs)
+{
+    detail::Lock lock(mMutex);
+    for (auto& kv : mSubscribers)
+    {
+        Subscriber& sub = kv.second;
+        const bool matches = std::any_of(sub.patterns.begin(), sub.patterns.end(),
+            [&topic](const std::string& p) { return globMatch(p, topic); });
+        if (!matches)
+        {
+            continue;
+        }
+        ++sub.stats.published;
+
+        auto pending = sub.pending.find(topic);
+        if (pending != sub.pending.end())
+        {
+            // Not delivered yet: only the newest state matters
+            pending->second.payload = payload;
+            ++pending->second.coalesced;
+            ++sub.stats.coalesced;
+            continue;
+        }
+
+        if (sub.pending.size() >= std::max<size_t>(sub.options.maxPending, 1))
+        {
+            auto oldest = std::min_element(sub.pending.begin(), sub.pending.end(),
+                [](const auto& a, const auto& b) { return a.second.sequence < b.second.sequence; });
+            sub.pending.erase(oldest);
+            ++sub.stats.dropped;
+        }
+
+        uint64_t dueUs = nowUs;
+        auto last = sub.lastSentUs.find(topic);
+        if (last != sub.lastSentUs.end())
+        {
+            dueUs = std::max(nowUs, last->second + static_cast<uint64_t>(sub.options.coalesceMs) * 1000u);
+        }
+        sub.pending.emplace(topic, Pending{payload, dueUs, ++mSequence, 0});
+    }
+}
+
+size_t EventBus::collect(SubscriberId id, uint64_t nowUs, std::vector<Event>& out, size_t maxEvents)
+{
+    detail::Lock lock(mMutex);
+    auto it = mSubscribers.find(id);
+    if (it == mSubscribers.end() || maxEvents == 0)
+    {
+        return 0;
+    }
+    Subscriber& sub = it->second;
+
+    // A send time whose window has passed no longer delays anything
+    const uint64_t windowUs = static_cast<uint64_t>(sub.options.coalesceMs) * 1000u;
+    for (auto last = sub.lastSentUs.begin(); last != sub.lastSentUs.end();)
+    {
+        last = last->second + windowUs <= nowUs ? sub.lastSentUs.erase(last) : std::next(last);
+    }
+
+    std::vector<std::map<std::string, Pending>::iterator> due;
+    for (auto p = sub.pending.begin(); p != sub.pending.end(); ++p)
+    {
+        if (p->second.dueUs <= nowUs)
+        {
+            due.push_back(p);
+        }
+    }
+    std::sort(due.begin(), due.end(),
+        [](const auto& a, const auto& b) { return a->second.sequence < b->second.sequence; });
+    if (due.size() > maxEvents)
+    {
+        due.resize(maxEvents);
+    }
+
+    for (auto& p : due)
+    {
+        out.push_back(Event{p->first, std::move(p->second.payload), p->second.coalesced});
+        sub.lastSentUs[p->first] = nowUs;
+        sub.pending.erase(p);
+    }
+    sub.stats.delivered += due.size();
+    return due.size();
+}
+
+EventBus::Stats EventBus::stats(SubscriberId id) const
+{
+    detail::Lock lock(mMutex);
+    auto it = mSubscribers.find(id);
+    if (it == mSubscribers.end())
+    {
+        return Stats{};
+    }
+    Stats stats = it->second.stats;
+    stats.windows = it->second.lastSentUs.size();
+    return stats;
+}
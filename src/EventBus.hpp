@@ -0,0 +1,90 @@
+#ifndef EVENT_BUS_HPP
+#define EVENT_BUS_HPP
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "CommandShellConfig.hpp"
+
+namespace commandshell
+{
+    /* Publish/subscribe of component events (e.g. "led.state")
+    *  Components publish(topic, payload); each subscriber (usually a
+    *  CommandShellIO session) holds glob patterns and a small mailbox that it
+    *  empties with collect(). The mailbox keeps only the newest payload per
+    *  topic, and a topic is handed out at most once per coalesce window, so a
+    *  LED blinking at 10 Hz costs a slow client one line per window. When a
+    *  mailbox holds maxPending topics, the oldest pending topic is dropped
+    *  (counted) instead of growing without bound. Send times are forgotten
+    *  once their window has passed, so topics that come and go (per-request
+    *  ids, say) do not accumulate. Safe to publish from any thread.
+    */
+    class EventBus
+    {
+    public:
+        using SubscriberId = uint32_t;
+
+        struct Event
+        {
+            std::string topic;
+            std::string payload;
+            uint32_t coalesced = 0; // updates folded into this one
+        };
+
+        struct Options
+        {
+            uint32_t coalesceMs = 100;
+            size_t maxPending = 32;
+        };
+
+        struct Stats
+        {
+            uint64_t published = 0; // matching publishes
+            uint64_t delivered = 0;
+            uint64_t coalesced = 0;
+            uint64_t dropped = 0;
+            size_t windows = 0; // topics still inside their coalesce window
+        };
+
+        SubscriberId addSubscriber(const Options& options);
+        void removeSubscriber(SubscriberId id);
+
+        // Glob patterns over topics (`led.*`, `*`); returns false if already present
+        bool subscribe(SubscriberId id, const std::string& pattern);
+        bool unsubscribe(SubscriberId id, const std::string& pattern);
+        std::vector<std::string> subscriptions(SubscriberId id) const;
+
+        void publish(const std::string& topic, const std::string& payload, uint64_t nowUs);
+
+        // Move up to maxEvents events that are due at nowUs into out (oldest first);
+        // returns how many were added
+        size_t collect(SubscriberId id, uint64_t nowUs, std::vector<Event>& out, size_t maxEvents);
+
+        Stats stats(SubscriberId id) const;
+
+    private:
+        struct Pending
+        {
+            std::string payload;
+            uint64_t dueUs = 0;
+            uint64_t sequence = 0; // arrival order, for oldest-first
+            uint32_t coalesced = 0;
+        };
+
+        struct Subscriber
+        {
+            Options options;
+            std::vector<std::string> patterns;
+            std::map<std::string, Pending> pending;     // by topic
+            std::map<std::string, uint64_t> lastSentUs; // by topic
+            Stats stats;
+        };
+
+        mutable detail::Mutex mMutex;
+        std::map<SubscriberId, Subscriber> mSubscribers;
+        SubscriberId mNextId = 1;
+        uint64_t mSequence = 0;
+    };
+} // namespace commandshell
+#endif // EVENT_BUS_HPP
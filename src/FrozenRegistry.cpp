@@ -0,0 +1,182 @@
+#include "FrozenRegistry.hpp"
+
+#include <algorithm>
+#include <utility>
+
+using namespace commandshell;
+
+namespace {
+    // Same handlers under new name/description strings (those members are const)
+    CommandDetails rename(CommandDetails&& from, std::string command, std::string description)
+    {
+        return CommandDetails{
+            std::move(command),
+            std::move(description),
+            std::move(from.execute),
+            from.cache,
+            std::move(from.stream),
+            std::move(from.resumable),
+            std::move(from.cancellable),
+            from.deadlineMs,
+            from.priority,
+            std::move(from.structured),
+        };
+    }
+
+    // Rough per-node overhead of a std::map entry (tree links and color) and its block
+    constexpr size_t kMapNodeBytes = 4 * sizeof(void*) + StringPool::kBlockOverhead;
+
+    // Capacity of a vector plus its block header (nothing when unallocated)
+    template <typename T>
+    size_t vectorBytes(const std::vector<T>& v)
+    {
+        return v.capacity() == 0 ? 0 : v.capacity() * sizeof(T) + StringPool::kBlockOverhead;
+    }
+}
+
+FrozenRegistry::FrozenRegistry(std::vector<ComponentCommands>&& components)
+{
+    size_t optionCount = 0;
+    size_t commandCount = 0;
+    for (const auto& comp : components)
+    {
+        optionCount += comp.options.size();
+        commandCount += comp.commands.size();
+    }
+    // Spans point into these arrays, so they must not reallocate below
+    mComponents.reserve(components.size());
+    mOptions.reserve(optionCount);
+    mCommands.reserve(commandCount);
+    mHandlers.reserve(commandCount);
+    mSortedCommands.reserve(commandCount);
+
+    std::vector<std::pair<StringPool::Handle, StringPool::Handle>> names; // component, description
+    names.reserve(components.size());
+    for (auto& comp : components)
+    {
+        const size_t pooledBefore = mStrings.stats().bytes;
+        names.emplace_back(mStrings.intern(comp.component), mStrings.intern(comp.description));
+
+        Component record;
+        const size_t firstOption = mOptions.size();
+        for (const auto& opt : comp.options)
+        {
+            mOptions.push_back(Option::Record{
+                mStrings.intern(opt.shortOpt), mStrings.intern(opt.longOpt), mStrings.intern(opt.description)});
+        }
+        record.options = PooledSpan<Option>(&mStrings, mOptions.data() + firstOption, mOptions.data() + mOptions.size());
+
+        const size_t firstCommand = mCommands.size();
+        for (auto& cd : comp.commands)
+        {
+            mCommands.push_back(Command::Record{mStrings.intern(cd.command), mStrings.intern(cd.description)});
+            mHandlers.push_back(rename(std::move(cd), std::string{}, std::string{}));
+            mSortedCommands.push_back(static_cast<uint32_t>(mCommands.size() - 1));
+        }
+        record.commands = PooledSpan<Command>(&mStrings, mCommands.data() + firstCommand, mCommands.data() + mCommands.size());
+        // Stable, so the first of duplicate names wins as in ComponentCommands
+        std::stable_sort(mSortedCommands.begin() + static_cast<std::ptrdiff_t>(firstCommand), mSortedCommands.end(),
+            [this](uint32_t a, uint32_t b) { return mStrings.view(mCommands[a].command) < mStrings.view(mCommands[b].command); });
+        record.stringBytes = static_cast<uint32_t>(mStrings.stats().bytes - pooledBefore);
+        mComponents.push_back(record);
+    }
+
+    // Drop spare arena capacity and the hash index; views taken from here on stay valid
+    mStrings.shrinkToFit();
+    for (size_t i = 0; i < mComponents.size(); ++i)
+    {
+        mComponents[i].component = mStrings.view(names[i].first);
+        mComponents[i].description = mStrings.view(names[i].second);
+    }
+
+    mStats.components = mComponents.size();
+    mStats.commands = mCommands.size();
+    mStats.blobBytes = mStrings.stats().bytes;
+    mStats.bytesAfter = sizeof(FrozenRegistry) + StringPool::kBlockOverhead + mStrings.memoryFootprint()
+        + vectorBytes(mComponents) + vectorBytes(mOptions) + vectorBytes(mCommands)
+        + vectorBytes(mHandlers) + vectorBytes(mSortedCommands);
+}
+
+const FrozenRegistry::Component* FrozenRegistry::findComponent(std::string_view name) const
+{
+    auto it = std::lower_bound(mComponents.begin(), mComponents.end(), name,
+        [](const Component& c, std::string_view n) { return c.component < n; });
+    return (it != mComponents.end() && it->component == name) ? &*it : nullptr;
+}
+
+const CommandDetails* FrozenRegistry::findCommand(const Component& component, std::string_view name) const
+{
+    auto begin = mSortedCommands.begin() + static_cast<std::ptrdiff_t>(commandIndex(component));
+    auto end = begin + static_cast<std::ptrdiff_t>(component.commands.size());
+    auto it = std::lower_bound(begin, end, name,
+        [this](uint32_t index, std::string_view n) { return mStrings.view(mCommands[index].command) < n; });
+    return (it != end && mStrings.view(mCommands[*it].command) == name) ? &mHandlers[*it] : nullptr;
+}
+
+Span<FrozenRegistry::Component> FrozenRegistry::components() const
+{
+    return Span<Component>{mComponents.data(), mComponents.data() + mComponents.size()};
+}
+
+size_t FrozenRegistry::footprint(const ComponentCommands& comp)
+{
+    // Map node holding the name and entry, plus the separately allocated command set
+    size_t bytes = kMapNodeBytes + sizeof(std::string) + 2 * StringPool::heapBytes(comp.component)
+        + sizeof(ComponentCommands) + StringPool::kBlockOverhead;
+    bytes += StringPool::heapBytes(comp.description);
+    bytes += vectorBytes(comp.options);
+    for (const auto& opt : comp.options)
+    {
+        bytes += StringPool::heapBytes(opt.shortOpt) + StringPool::heapBytes(opt.longOpt) + StringPool::heapBytes(opt.description);
+    }
+    bytes += vectorBytes(comp.commands);
+    for (const auto& cd : comp.commands)
+    {
+        bytes += StringPool::heapBytes(cd.command) + StringPool::heapBytes(cd.description);
+    }
+    return bytes;
+}
+
+size_t FrozenRegistry::footprint(const std::vector<ComponentCommands>& components)
+{
+    size_t bytes = 0;
+    for (const auto& comp : components)
+    {
+        bytes += footprint(comp);
+    }
+    return bytes;
+}
+
+size_t FrozenRegistry::footprint(const Component& component) const
+{
+    return sizeof(Component)
+        + component.options.size() * sizeof(Option::Record)
+        + component.commands.size() * (sizeof(Command::Record) + sizeof(CommandDetails) + sizeof(uint32_t));
+}
+
+std::vector<ComponentCommands> FrozenRegistry::thaw()
+{
+    std::vector<ComponentCommands> components;
+    components.reserve(mComponents.size());
+    for (const auto& record : mComponents)
+    {
+        ComponentCommands comp{std::string(record.component), std::string(record.description)};
+        for (const auto& opt : record.options)
+        {
+            comp.addOption(OptionDetails{std::string(opt.shortOpt), std::string(opt.longOpt), std::string(opt.description)});
+        }
+        comp.commands.reserve(record.commands.size());
+        size_t index = commandIndex(record);
+        for (const auto& cmd : record.commands)
+        {
+            comp.commands.push_back(rename(std::move(mHandlers[index++]), std::string(cmd.command), std::string(cmd.description)));
+        }
+        components.push_back(std::move(comp));
+    }
+    return components;
+}
+
+size_t FrozenRegistry::commandIndex(const Component& component) const
+{
+    return static_cast<size_t>(component.commands.begin().record() - mCommands.data());
+}
@@ -0,0 +1,168 @@
+#ifndef FROZEN_REGISTRY_HPP
+#define FROZEN_REGISTRY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "CommandTypes.hpp"
+#include "StringPool.hpp"
+
+namespace commandshell
+{
+    // Contiguous read-only range into one of the registry arrays
+    template <typename T>
+    struct Span
+    {
+        const T* first = nullptr;
+        const T* last = nullptr;
+
+        const T* begin() const { return first; }
+        const T* end() const { return last; }
+        size_t size() const { return static_cast<size_t>(last - first); }
+        bool empty() const { return first == last; }
+    };
+
+    // Range of pooled records that yields View values (string_views into the pool)
+    template <typename View>
+    class PooledSpan
+    {
+    public:
+        using Record = typename View::Record;
+
+        class Iterator
+        {
+        public:
+            Iterator(const StringPool* pool, const Record* at) : mPool(pool), mAt(at) {}
+            View operator*() const { return View::from(*mPool, *mAt); }
+            Iterator& operator++() { ++mAt; return *this; }
+            bool operator==(const Iterator& other) const { return mAt == other.mAt; }
+            bool operator!=(const Iterator& other) const { return mAt != other.mAt; }
+            const Record* record() const { return mAt; }
+
+        private:
+            const StringPool* mPool;
+            const Record* mAt;
+        };
+
+        PooledSpan() = default;
+        PooledSpan(const StringPool* pool, const Record* first, const Record* last)
+            : mPool(pool), mFirst(first), mLast(last) {}
+
+        Iterator begin() const { return Iterator(mPool, mFirst); }
+        Iterator end() const { return Iterator(mPool, mLast); }
+        size_t size() const { return static_cast<size_t>(mLast - mFirst); }
+        bool empty() const { return mFirst == mLast; }
+
+    private:
+        const StringPool* mPool = nullptr;
+        const Record* mFirst = nullptr;
+        const Record* mLast = nullptr;
+    };
+
+    /* Read-only, compacted copy of the component registry (CommandShell::freeze)
+    *  Every name, description and option text is interned once in a StringPool;
+    *  option and command records are pairs/triples of 8-byte pool handles in
+    *  flat arrays, and handlers sit in a dense table parallel to the commands.
+    *  Components are sorted by name; commands keep registration order for
+    *  help, and a per-component array of sorted offsets serves lookup by binary
+    *  search. Iterating yields views with the member names of ComponentCommands,
+    *  so the help renderers work on both.
+    */
+    class FrozenRegistry
+    {
+    public:
+        struct Option
+        {
+            std::string_view shortOpt;
+            std::string_view longOpt;
+            std::string_view description;
+
+            struct Record
+            {
+                StringPool::Handle shortOpt;
+                StringPool::Handle longOpt;
+                StringPool::Handle description;
+            };
+            static Option from(const StringPool& pool, const Record& r)
+            {
+                return Option{pool.view(r.shortOpt), pool.view(r.longOpt), pool.view(r.description)};
+            }
+        };
+
+        struct Command
+        {
+            std::string_view command;
+            std::string_view description;
+
+            struct Record
+            {
+                StringPool::Handle command;
+                StringPool::Handle description;
+            };
+            static Command from(const StringPool& pool, const Record& r)
+            {
+                return Command{pool.view(r.command), pool.view(r.description)};
+            }
+        };
+
+        struct Component
+        {
+            std::string_view component;
+            std::string_view description;
+            PooledSpan<Option> options;
+            PooledSpan<Command> commands;
+            uint32_t stringBytes = 0; // pool bytes this component added
+        };
+
+        struct Stats
+        {
+            size_t components = 0;
+            size_t commands = 0;
+            size_t blobBytes = 0;   // pooled strings after de-duplication
+            size_t bytesBefore = 0; // estimated footprint of the mutable registry
+            size_t bytesAfter = 0;  // footprint of this layout
+        };
+
+        // Components must be sorted by name; handlers are moved into the table
+        explicit FrozenRegistry(std::vector<ComponentCommands>&& components);
+
+        FrozenRegistry(const FrozenRegistry&) = delete;
+        FrozenRegistry& operator=(const FrozenRegistry&) = delete;
+
+        const Component* findComponent(std::string_view name) const;
+        const CommandDetails* findCommand(const Component& component, std::string_view name) const;
+
+        Span<Component> components() const;
+
+        // Estimated heap + object bytes of mutable components
+        static size_t footprint(const ComponentCommands& component);
+        static size_t footprint(const std::vector<ComponentCommands>& components);
+
+        // Bytes of one component's records and handlers in this layout; its strings
+        // are in strings() (Component::stringBytes, shared ones count for the first user)
+        size_t footprint(const Component& component) const;
+
+        const StringPool& strings() const { return mStrings; }
+
+        // bytesBefore is supplied by the caller, which measured the registry it replaced
+        Stats stats() const { return mStats; }
+        void setBytesBefore(size_t bytes) { mStats.bytesBefore = bytes; }
+
+        // Move handlers back out into ordinary command sets (CommandShell::thaw)
+        std::vector<ComponentCommands> thaw();
+
+    private:
+        size_t commandIndex(const Component& component) const;
+
+        StringPool mStrings;
+        std::vector<Component> mComponents;
+        std::vector<Option::Record> mOptions;
+        std::vector<Command::Record> mCommands;
+        std::vector<CommandDetails> mHandlers; // parallel to mCommands, names left empty
+        std::vector<uint32_t> mSortedCommands; // per component: indices into mCommands by name
+        Stats mStats;
+    };
+} // namespace commandshell
+#endif // FROZEN_REGISTRY_HPP
@@ -0,0 +1,43 @@
+#ifndef GLOB_HPP
+#define GLOB_HPP
+
+#include <string>
+
+namespace commandshell
+{
+    // Shell-style glob with '*' and '?'
+    inline bool globMatch(const std::string& pattern, const std::string& text)
+    {
+        size_t p = 0, t = 0, star = std::string::npos, mark = 0;
+        while (t < text.size())
+        {
+            if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t]))
+            {
+                ++p;
+                ++t;
+            }
+            else if (p < pattern.size() && pattern[p] == '*')
+            {
+                star = p++;
+                mark = t;
+            }
+            else if (star != std::string::npos)
+            {
+                p = star + 1;
+                t = ++mark;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        while (p < pattern.size() && pattern[p] == '*') ++p;
+        return p == pattern.size();
+    }
+
+    inline bool isGlob(const std::string& token)
+    {
+        return token.find_first_of("*?") != std::string::npos;
+    }
+} // namespace commandshell
+#endif // GLOB_HPP
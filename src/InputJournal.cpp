@@ -0,0 +1,228 @@
+#include "InputJournal.hpp"
+#include "CommandShell.hpp"
+#include "CommandShellIO.hpp"
+#include "CommandShellConfig.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <sstream>
+
+#if COMMANDSHELL_THREADS
+#include <chrono>
+#include <thread>
+#endif
+
+using namespace commandshell;
+
+namespace {
+    constexpr char kMagic[] = {'C', 'S', 'J', '1'};
+
+    void appendVarint(std::string& out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out += static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    bool readVarint(std::string_view data, size_t& pos, uint64_t& value)
+    {
+        value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7)
+        {
+            if (pos >= data.size())
+            {
+                return false;
+            }
+            auto byte = static_cast<unsigned char>(data[pos++]);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+InputRecorder::InputRecorder(Writer writer)
+    : mWriter(std::move(writer)) {}
+
+void InputRecorder::record(const char* data, size_t size, uint64_t nowUs)
+{
+    std::string out;
+    if (!mStarted)
+    {
+        out.append(kMagic, sizeof(kMagic));
+        mStarted = true;
+        mLastUs = nowUs;
+    }
+    appendVarint(out, nowUs >= mLastUs ? nowUs - mLastUs : 0);
+    appendVarint(out, size);
+    out.append(data, size);
+    mLastUs = nowUs;
+    ++mRecords;
+    write(out);
+}
+
+void InputRecorder::write(const std::string& bytes)
+{
+    if (mWriter)
+    {
+        mWriter(bytes.data(), bytes.size());
+    }
+    mBytesWritten += bytes.size();
+}
+
+InputRecorder::Writer commandshell::journalFileWriter(const std::string& path)
+{
+    std::shared_ptr<std::FILE> file(std::fopen(path.c_str(), "a+b"), [](std::FILE* f) {
+        if (f) std::fclose(f);
+    });
+    if (!file)
+    {
+        return InputRecorder::Writer{};
+    }
+
+    // A non-empty file must already be a journal; continue it without a second header
+    auto skip = std::make_shared<size_t>(0);
+    std::fseek(file.get(), 0, SEEK_END);
+    if (std::ftell(file.get()) > 0)
+    {
+        char magic[sizeof(kMagic)] = {};
+        std::fseek(file.get(), 0, SEEK_SET);
+        if (std::fread(magic, 1, sizeof(magic), file.get()) != sizeof(magic)
+            || std::string_view(magic, sizeof(magic)) != std::string_view(kMagic, sizeof(kMagic)))
+        {
+            return InputRecorder::Writer{};
+        }
+        *skip = sizeof(kMagic);
+        // Output may not follow input on an update stream without repositioning
+        std::fseek(file.get(), 0, SEEK_END);
+    }
+    return [file, skip](const char* data, size_t size) {
+        // The recorder's first write starts with the header
+        const size_t drop = std::min(*skip, size);
+        *skip -= drop;
+        std::fwrite(data + drop, 1, size - drop, file.get());
+        std::fflush(file.get());
+    };
+}
+
+bool commandshell::parseJournal(std::string_view data, std::vector<JournalRecord>& records)
+{
+    if (data.empty())
+    {
+        return true;
+    }
+    if (data.size() < sizeof(kMagic) || data.substr(0, sizeof(kMagic)) != std::string_view(kMagic, sizeof(kMagic)))
+    {
+        return false;
+    }
+
+    size_t pos = sizeof(kMagic);
+    while (pos < data.size())
+    {
+        uint64_t delta = 0;
+        uint64_t length = 0;
+        if (!readVarint(data, pos, delta) || !readVarint(data, pos, length) || length > data.size() - pos)
+        {
+            return false;
+        }
+        records.push_back(JournalRecord{delta, std::string(data.substr(pos, static_cast<size_t>(length)))});
+        pos += static_cast<size_t>(length);
+    }
+    return true;
+}
+
+bool commandshell::loadJournal(const std::string& path, std::vector<JournalRecord>& records)
+{
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> file(std::fopen(path.c_str(), "rb"), std::fclose);
+    if (!file)
+    {
+        return false;
+    }
+    std::string data;
+    char buf[4096];
+    size_t n = 0;
+    while ((n = std::fread(buf, 1, sizeof(buf), file.get())) > 0)
+    {
+        data.append(buf, n);
+    }
+    return parseJournal(data, records);
+}
+
+double ReplayReport::chunksPerSecond() const
+{
+    return elapsedUs == 0 ? 0.0 : static_cast<double>(chunks) * 1e6 / static_cast<double>(elapsedUs);
+}
+
+double ReplayReport::bytesPerSecond() const
+{
+    return elapsedUs == 0 ? 0.0 : static_cast<double>(bytes) * 1e6 / static_cast<double>(elapsedUs);
+}
+
+std::string ReplayReport::summary() const
+{
+    std::ostringstream os;
+    os << "chunks: " << chunks << "\n";
+    os << "bytes: " << bytes << "\n";
+    os << "elapsed_us: " << elapsedUs << "\n";
+    os << "chunks_per_s: " << chunksPerSecond() << "\n";
+    os << "bytes_per_s: " << bytesPerSecond() << "\n";
+    os << "input_latency_us: p50=" << inputLatency.percentile(50) << " p90=" << inputLatency.percentile(90)
+       << " p99=" << inputLatency.percentile(99) << " p99.9=" << inputLatency.percentile(99.9)
+       << " max=" << inputLatency.max() << "\n";
+    return os.str();
+}
+
+ReplayReport commandshell::replayJournal(const std::vector<JournalRecord>& records, CommandShell& shell,
+                                         const ReplayOptions& options)
+{
+    auto sleep = options.sleep;
+    if (!sleep)
+    {
+#if COMMANDSHELL_THREADS
+        sleep = [](uint64_t us) { std::this_thread::sleep_for(std::chrono::microseconds(us)); };
+#else
+        sleep = [&shell](uint64_t us) {
+            const uint64_t until = shell.nowMicros() + us;
+            while (shell.nowMicros() < until) {}
+        };
+#endif
+    }
+
+    CommandShellIO io(shell, options.echoInput);
+    io.setOutputCallback(options.output ? options.output : [](const std::string&) {});
+
+    ReplayReport report;
+    const uint64_t start = shell.nowMicros();
+    for (const auto& rec : records)
+    {
+        uint64_t wait = 0;
+        if (options.speed == ReplayOptions::Speed::Original)
+        {
+            wait = rec.deltaUs;
+        }
+        else if (options.speed == ReplayOptions::Speed::Scaled && options.scale > 0.0)
+        {
+            wait = static_cast<uint64_t>(static_cast<double>(rec.deltaUs) / options.scale);
+        }
+        if (wait > 0)
+        {
+            sleep(wait);
+        }
+
+        std::string chunk = rec.bytes;
+        const uint64_t before = shell.nowMicros();
+        io.input(chunk);
+        report.inputLatency.add(shell.nowMicros() - before);
+        ++report.chunks;
+        report.bytes += rec.bytes.size();
+    }
+    report.elapsedUs = shell.nowMicros() - start;
+    return report;
+}
@@ -0,0 +1,90 @@
+#ifndef INPUT_JOURNAL_HPP
+#define INPUT_JOURNAL_HPP
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "LatencyStats.hpp"
+
+namespace commandshell
+{
+    class CommandShell;
+
+    /* Input journal format
+    *  "CSJ1" magic, then one record per input chunk:
+    *    varint  microseconds since the previous chunk
+    *    varint  chunk length
+    *    bytes   chunk exactly as passed to CommandShellIO::input
+    */
+    struct JournalRecord
+    {
+        uint64_t deltaUs;
+        std::string bytes;
+    };
+
+    // Appends journal records through a writer callback
+    class InputRecorder
+    {
+    public:
+        using Writer = std::function<void(const char* data, size_t size)>;
+
+        explicit InputRecorder(Writer writer);
+
+        // Record one chunk that arrived at nowUs
+        void record(const char* data, size_t size, uint64_t nowUs);
+
+        uint64_t recordCount() const { return mRecords; }
+        uint64_t bytesWritten() const { return mBytesWritten; }
+
+    private:
+        void write(const std::string& bytes);
+
+        Writer mWriter;
+        bool mStarted = false;
+        uint64_t mLastUs = 0;
+        uint64_t mRecords = 0;
+        uint64_t mBytesWritten = 0;
+    };
+
+    // Writer appending to a file. An existing journal is continued (the new
+    // recorder's header is not repeated), so one file can hold several sessions.
+    // Returns an empty writer if the file cannot be opened or is not a journal.
+    InputRecorder::Writer journalFileWriter(const std::string& path);
+
+    // Decode a journal; returns false on a bad header or truncated record
+    bool parseJournal(std::string_view data, std::vector<JournalRecord>& records);
+
+    // Read and decode a journal file
+    bool loadJournal(const std::string& path, std::vector<JournalRecord>& records);
+
+    struct ReplayOptions
+    {
+        enum class Speed { Original, Scaled, Max };
+        Speed speed = Speed::Original;
+        double scale = 1.0; // Scaled: 2.0 replays twice as fast
+        bool echoInput = false;
+        // Waits the given microseconds; defaults to sleeping (or spinning on the shell clock)
+        std::function<void(uint64_t)> sleep{};
+        // Receives all output produced during replay
+        std::function<void(const std::string&)> output{};
+    };
+
+    struct ReplayReport
+    {
+        uint64_t chunks = 0;
+        uint64_t bytes = 0;
+        uint64_t elapsedUs = 0;
+        LatencyStats inputLatency; // time spent inside CommandShellIO::input per chunk
+
+        double chunksPerSecond() const;
+        double bytesPerSecond() const;
+        std::string summary() const;
+    };
+
+    // Feed recorded chunks into a fresh CommandShellIO bound to shell
+    ReplayReport replayJournal(const std::vector<JournalRecord>& records, CommandShell& shell,
+                               const ReplayOptions& options = ReplayOptions{});
+} // namespace commandshell
+#endif // INPUT_JOURNAL_HPP
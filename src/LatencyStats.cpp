@@ -0,0 +1,121 @@
+#include "LatencyStats.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace commandshell;
+
+uint64_t LatencyStats::percentile(double p) const
+{
+    if (mSamples.empty())
+    {
+        return 0;
+    }
+    if (mSortedCount != mSamples.size())
+    {
+        std::sort(mSamples.begin(), mSamples.end());
+        mSortedCount = mSamples.size();
+    }
+    p = std::min(100.0, std::max(0.0, p));
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(mSamples.size())));
+    return mSamples[rank == 0 ? 0 : rank - 1];
+}
+
+uint64_t LatencyStats::max() const
+{
+    return percentile(100.0);
+}
+
+double LatencyStats::mean() const
+{
+    if (mSamples.empty())
+    {
+        return 0.0;
+    }
+    double total = 0.0;
+    for (auto s : mSamples)
+    {
+        total += static_cast<double>(s);
+    }
+    return total / static_cast<double>(mSamples.size());
+}
+
+void LatencyHistogram::add(uint64_t us)
+{
+    ++mCounts[bucketOf(us)];
+    ++mCount;
+    mMax = std::max(mMax, us);
+    mTotal += static_cast<double>(us);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+    for (size_t i = 0; i < kBuckets; ++i)
+    {
+        mCounts[i] += other.mCounts[i];
+    }
+    mCount += other.mCount;
+    mMax = std::max(mMax, other.mMax);
+    mTotal += other.mTotal;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const
+{
+    if (mCount == 0)
+    {
+        return 0;
+    }
+    p = std::min(100.0, std::max(0.0, p));
+    const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p / 100.0 * static_cast<double>(mCount))));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i)
+    {
+        seen += mCounts[i];
+        if (seen >= rank)
+        {
+            return std::min(bucketUpper(i), mMax);
+        }
+    }
+    return mMax;
+}
+
+double LatencyHistogram::mean() const
+{
+    return mCount == 0 ? 0.0 : mTotal / static_cast<double>(mCount);
+}
+
+size_t LatencyHistogram::bucketOf(uint64_t us)
+{
+    if (us < kExact)
+    {
+        return static_cast<size_t>(us);
+    }
+    unsigned exponent = 4; // highest set bit; us >= 16
+    while (exponent < 63 && (us >> (exponent + 1)) != 0)
+    {
+        ++exponent;
+    }
+    if (exponent >= kMaxExponent)
+    {
+        return kBuckets - 1;
+    }
+    const size_t sub = static_cast<size_t>(us >> (exponent - 3)) & (kSubBuckets - 1);
+    return kExact + (exponent - 4) * kSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::bucketUpper(size_t bucket)
+{
+    if (bucket < kExact)
+    {
+        return bucket;
+    }
+    if (bucket == kBuckets - 1)
+    {
+        return std::numeric_limits<uint64_t>::max();
+    }
+    const unsigned exponent = static_cast<unsigned>((bucket - kExact) / kSubBuckets) + 4;
+    const uint64_t sub = (bucket - kExact) % kSubBuckets;
+    const uint64_t width = uint64_t{1} << (exponent - 3);
+    return ((kSubBuckets + sub) << (exponent - 3)) + width - 1;
+}
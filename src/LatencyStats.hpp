@@ -0,0 +1,71 @@
+#ifndef LATENCY_STATS_HPP
+#define LATENCY_STATS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace commandshell
+{
+    // Collects latency samples (microseconds) and reports nearest-rank percentiles
+    class LatencyStats
+    {
+    public:
+        void add(uint64_t us) { mSamples.push_back(us); }
+        void merge(const LatencyStats& other)
+        {
+            mSamples.insert(mSamples.end(), other.mSamples.begin(), other.mSamples.end());
+        }
+        void clear()
+        {
+            mSamples.clear();
+            mSortedCount = 0;
+        }
+        size_t count() const { return mSamples.size(); }
+
+        // p in [0, 100]; returns 0 when there are no samples
+        uint64_t percentile(double p) const;
+        uint64_t max() const;
+        double mean() const;
+
+    private:
+        mutable std::vector<uint64_t> mSamples;
+        mutable size_t mSortedCount = 0; // samples are sorted while this equals size()
+    };
+
+    /* Fixed-size latency histogram for long-running counters
+    *  Log-linear buckets: exact below 16, then 8 buckets per power of two, so a
+    *  percentile is within 12.5% of the true value. add() is O(1), memory never
+    *  grows, and percentile() walks the buckets instead of sorting samples.
+    *  count(), max() and mean() are exact.
+    */
+    class LatencyHistogram
+    {
+    public:
+        void add(uint64_t us);
+        void merge(const LatencyHistogram& other);
+        void clear() { *this = LatencyHistogram{}; }
+        uint64_t count() const { return mCount; }
+
+        // p in [0, 100]; upper bound of the bucket holding the nearest-rank sample
+        uint64_t percentile(double p) const;
+        uint64_t max() const { return mMax; }
+        double mean() const;
+
+    private:
+        static constexpr size_t kExact = 16;
+        static constexpr size_t kSubBuckets = 8;
+        static constexpr unsigned kMaxExponent = 40; // larger values share the last bucket
+        static constexpr size_t kBuckets = kExact + (kMaxExponent - 4) * kSubBuckets + 1;
+
+        static size_t bucketOf(uint64_t us);
+        static uint64_t bucketUpper(size_t bucket);
+
+        std::array<uint64_t, kBuckets> mCounts{};
+        uint64_t mCount = 0;
+        uint64_t mMax = 0;
+        double mTotal = 0.0;
+    };
+} // namespace commandshell
+#endif // LATENCY_STATS_HPP
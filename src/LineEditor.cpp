@@ -0,0 +1,268 @@
+#include "LineEditor.hpp"
+
+#include <utility>
+
+using namespace commandshell;
+
+namespace {
+    constexpr char kEsc = '\x1b';
+
+    std::string csi(size_t n, char final)
+    {
+        return std::string("\x1b[") + std::to_string(n) + final;
+    }
+
+    // Append whichever candidate is shorter
+    void appendShorter(std::string& echo, const std::string& a, const std::string& b)
+    {
+        echo += (b.size() < a.size()) ? b : a;
+    }
+}
+
+bool LineEditor::decode(char c, KeyEvent& key)
+{
+    const bool afterCr = mSkipLf;
+    mSkipLf = false;
+
+    switch (mDecode)
+    {
+    case DecodeState::Escape:
+        if (c == '[')
+        {
+            mDecode = DecodeState::Csi;
+            mParam = 0;
+            return false;
+        }
+        mDecode = (c == 'O') ? DecodeState::Ss3 : DecodeState::Ground;
+        if (mDecode == DecodeState::Ground)
+        {
+            key.key = Key::Escape; // a lone ESC; the byte after it is dropped
+            return true;
+        }
+        return false;
+    case DecodeState::Csi:
+        if (c >= '0' && c <= '9')
+        {
+            mParam = mParam * 10 + static_cast<uint32_t>(c - '0');
+            return false;
+        }
+        if (static_cast<unsigned char>(c) < 0x40 || static_cast<unsigned char>(c) > 0x7e)
+        {
+            return false; // other parameter/intermediate bytes
+        }
+        mDecode = DecodeState::Ground;
+        switch (c)
+        {
+        case 'A': key.key = Key::Up; return true;
+        case 'B': key.key = Key::Down; return true;
+        case 'C': key.key = Key::Right; return true;
+        case 'D': key.key = Key::Left; return true;
+        case 'H': key.key = Key::Home; return true;
+        case 'F': key.key = Key::End; return true;
+        case '~':
+            if (mParam == 1 || mParam == 7) { key.key = Key::Home; return true; }
+            if (mParam == 4 || mParam == 8) { key.key = Key::End; return true; }
+            if (mParam == 3) { key.key = Key::Delete; return true; }
+            return false;
+        default:
+            return false;
+        }
+    case DecodeState::Ss3:
+        mDecode = DecodeState::Ground;
+        switch (c)
+        {
+        case 'A': key.key = Key::Up; return true;
+        case 'B': key.key = Key::Down; return true;
+        case 'C': key.key = Key::Right; return true;
+        case 'D': key.key = Key::Left; return true;
+        case 'H': key.key = Key::Home; return true;
+        case 'F': key.key = Key::End; return true;
+        default: return false;
+        }
+    case DecodeState::Ground:
+        break;
+    }
+
+    switch (c)
+    {
+    case kEsc: mDecode = DecodeState::Escape; return false;
+    case '\r':
+        mSkipLf = true;
+        key.key = Key::Enter;
+        key.ch = c;
+        return true;
+    case '\n':
+        if (afterCr) return false;
+        key.key = Key::Enter;
+        key.ch = c;
+        return true;
+    case '\x08':
+    case '\x7f': key.key = Key::Backspace; return true;
+    case '\x01': key.key = Key::Home; return true;   // Ctrl-A
+    case '\x05': key.key = Key::End; return true;    // Ctrl-E
+    case '\x02': key.key = Key::Left; return true;   // Ctrl-B
+    case '\x06': key.key = Key::Right; return true;  // Ctrl-F
+    case '\x04': key.key = Key::Delete; return true; // Ctrl-D
+    case '\x03': key.key = Key::CtrlC; return true;
+    case '\x07': key.key = Key::CtrlG; return true;
+    case '\x12': key.key = Key::CtrlR; return true;
+    default:
+        if (static_cast<unsigned char>(c) < 0x20)
+        {
+            return false; // other control bytes never reach the line
+        }
+        key.key = Key::Char;
+        key.ch = c;
+        return true;
+    }
+}
+
+LineEditor::Action LineEditor::apply(const KeyEvent& key, std::string& echo)
+{
+    switch (key.key)
+    {
+    case Key::Char:
+        insertChar(key.ch, echo);
+        break;
+    case Key::Backspace:
+        if (mCursor > 0) eraseAt(mCursor - 1, true, echo);
+        break;
+    case Key::Delete:
+        if (mCursor < mLine.size()) eraseAt(mCursor, false, echo);
+        break;
+    case Key::Left:
+        if (mCursor > 0)
+        {
+            --mCursor;
+            echo += '\b';
+        }
+        break;
+    case Key::Right:
+        if (mCursor < mLine.size())
+        {
+            echo += mLine[mCursor++]; // re-sending the character is one byte
+        }
+        break;
+    case Key::Home:
+        cursorLeft(mCursor, echo);
+        mCursor = 0;
+        break;
+    case Key::End:
+        cursorRight(mLine.size() - mCursor, echo);
+        mCursor = mLine.size();
+        break;
+    case Key::Enter: return Action::Submit;
+    case Key::Up: return Action::HistoryOlder;
+    case Key::Down: return Action::HistoryNewer;
+    case Key::CtrlR: return Action::Search;
+    case Key::CtrlC: return Action::Interrupt;
+    case Key::CtrlG:
+    case Key::Escape:
+        break;
+    }
+    return Action::None;
+}
+
+void LineEditor::append(std::string_view text)
+{
+    mLine.append(text.data(), text.size());
+    mCursor = mLine.size();
+}
+
+std::string LineEditor::take()
+{
+    std::string line;
+    line.swap(mLine);
+    mCursor = 0;
+    return line;
+}
+
+void LineEditor::assign(std::string text)
+{
+    mLine = std::move(text);
+    mCursor = mLine.size();
+}
+
+void LineEditor::setLine(const std::string& text, std::string& echo)
+{
+    size_t common = 0;
+    while (common < mLine.size() && common < text.size() && mLine[common] == text[common])
+    {
+        ++common;
+    }
+    if (mCursor > common)
+    {
+        cursorLeft(mCursor - common, echo);
+    }
+    else
+    {
+        cursorRight(common - mCursor, echo);
+    }
+    echo.append(text, common, std::string::npos);
+    if (mLine.size() > text.size())
+    {
+        echo += "\x1b[K";
+    }
+    mLine = text;
+    mCursor = mLine.size();
+}
+
+void LineEditor::redraw(const std::string& prompt, std::string& echo) const
+{
+    echo += '\r';
+    echo += prompt;
+    echo += mLine;
+    echo += "\x1b[K";
+    cursorLeft(mLine.size() - mCursor, echo);
+}
+
+void LineEditor::cursorLeft(size_t n, std::string& echo)
+{
+    if (n == 0) return;
+    const std::string move = csi(n, 'D');
+    if (n <= move.size()) echo.append(n, '\b');
+    else echo += move;
+}
+
+void LineEditor::cursorRight(size_t n, std::string& echo) const
+{
+    if (n == 0) return;
+    // Re-sending the characters under the cursor moves it right too
+    appendShorter(echo, mLine.substr(mCursor, n), csi(n, 'C'));
+}
+
+void LineEditor::insertChar(char c, std::string& echo)
+{
+    mLine.insert(mCursor, 1, c);
+    ++mCursor;
+    const size_t tail = mLine.size() - mCursor;
+    if (tail == 0)
+    {
+        echo += c;
+        return;
+    }
+    // Rewrite the tail and come back, or open a cell with ICH (ESC [ @)
+    std::string rewrite(1, c);
+    rewrite.append(mLine, mCursor, std::string::npos);
+    cursorLeft(tail, rewrite);
+    appendShorter(echo, rewrite, std::string("\x1b[@") + c);
+}
+
+void LineEditor::eraseAt(size_t pos, bool backspace, std::string& echo)
+{
+    mLine.erase(pos, 1);
+    mCursor = pos;
+    const size_t tail = mLine.size() - mCursor;
+    std::string prefix = backspace ? "\b" : "";
+    if (tail == 0)
+    {
+        echo += prefix + " \b";
+        return;
+    }
+    // Rewrite the tail plus a blank and come back, or delete the cell with DCH (ESC [ P)
+    std::string rewrite = prefix;
+    rewrite.append(mLine, mCursor, std::string::npos);
+    rewrite += ' ';
+    cursorLeft(tail + 1, rewrite);
+    appendShorter(echo, rewrite, prefix + "\x1b[P");
+}
@@ -0,0 +1,83 @@
+#ifndef LINE_EDITOR_HPP
+#define LINE_EDITOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace commandshell
+{
+    /* Terminal line editing for one input line
+    *  decode() turns raw bytes into keys (VT100/xterm escape sequences, CSI and
+    *  SS3 forms, Ctrl-A/E/B/F/D shortcuts, Ctrl-C; CR LF counts as one Enter)
+    *  and swallows everything it does not understand, so no control bytes
+    *  reach the line. apply() edits the line and appends to echo the shortest byte
+    *  sequence that brings the terminal up to date: each edit picks between
+    *  rewriting the tail and an insert/delete-character sequence, and cursor
+    *  moves pick between backspaces/re-sent text and a CSI move.
+    */
+    class LineEditor
+    {
+    public:
+        enum class Key : uint8_t
+        {
+            Char, Enter, Backspace, Delete, Left, Right, Home, End,
+            Up, Down, CtrlR, CtrlG, CtrlC, Escape
+        };
+
+        struct KeyEvent
+        {
+            Key key = Key::Char;
+            char ch = 0; // typed byte for Key::Char and Key::Enter
+        };
+
+        // What the owner has to do after apply()
+        enum class Action { None, Submit, HistoryOlder, HistoryNewer, Search, Interrupt };
+
+        // Feed one byte; true when it completed a key
+        bool decode(char c, KeyEvent& key);
+
+        Action apply(const KeyEvent& key, std::string& echo);
+
+        const std::string& line() const { return mLine; }
+        size_t cursor() const { return mCursor; }
+
+        // No escape sequence or CR LF pair in progress and the cursor at the end
+        // of the line: plain text may then be appended and echoed verbatim
+        bool atRest() const
+        {
+            return mDecode == DecodeState::Ground && !mSkipLf && mCursor == mLine.size();
+        }
+
+        // Append text the caller already echoed (plain fast path)
+        void append(std::string_view text);
+
+        // Return the line and start a new empty one
+        std::string take();
+
+        // Replace the line without output (cursor at end); pair with redraw()
+        void assign(std::string text);
+
+        // Replace the line, emitting only what differs from the current display
+        void setLine(const std::string& text, std::string& echo);
+
+        // Repaint prompt and line from column 0
+        void redraw(const std::string& prompt, std::string& echo) const;
+
+    private:
+        enum class DecodeState : uint8_t { Ground, Escape, Csi, Ss3 };
+
+        static void cursorLeft(size_t n, std::string& echo);
+        void cursorRight(size_t n, std::string& echo) const;
+        void insertChar(char c, std::string& echo);
+        void eraseAt(size_t pos, bool backspace, std::string& echo);
+
+        std::string mLine;
+        size_t mCursor = 0;
+        DecodeState mDecode = DecodeState::Ground;
+        uint32_t mParam = 0;  // numeric CSI parameter
+        bool mSkipLf = false; // previous byte was CR
+    };
+} // namespace commandshell
+#endif // LINE_EDITOR_HPP
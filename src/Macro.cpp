@@ -0,0 +1,126 @@
+#include "Macro.hpp"
+
+#include <algorithm>
+
+using namespace commandshell;
+
+namespace {
+    bool isPlaceholder(const std::string& text, size_t pos)
+    {
+        return text[pos] == '$' && pos + 1 < text.size() && text[pos + 1] >= '1' && text[pos + 1] <= '9';
+    }
+
+    // Highest `$N` in text (0 if none)
+    size_t highestPlaceholder(const std::string& text)
+    {
+        size_t highest = 0;
+        for (size_t i = 0; i + 1 < text.size(); ++i)
+        {
+            if (isPlaceholder(text, i))
+            {
+                highest = std::max(highest, static_cast<size_t>(text[i + 1] - '0'));
+            }
+        }
+        return highest;
+    }
+
+    std::string substitute(const std::string& text, const std::vector<std::string>& args)
+    {
+        std::string out;
+        out.reserve(text.size());
+        for (size_t i = 0; i < text.size(); ++i)
+        {
+            if (isPlaceholder(text, i))
+            {
+                const size_t index = static_cast<size_t>(text[i + 1] - '1');
+                if (index < args.size()) out += args[index];
+                ++i;
+            }
+            else
+            {
+                out += text[i];
+            }
+        }
+        return out;
+    }
+
+    std::vector<std::string> splitWords(const std::string& text)
+    {
+        std::vector<std::string> words;
+        size_t start = 0;
+        while (start < text.size())
+        {
+            size_t end = text.find(' ', start);
+            if (end == std::string::npos) end = text.size();
+            if (end > start) words.emplace_back(text, start, end - start);
+            start = end + 1;
+        }
+        return words;
+    }
+}
+
+bool MacroDefinition::parse(const std::string& body, MacroDefinition& out, std::string& error)
+{
+    MacroDefinition def;
+    def.mBody = body;
+    size_t start = 0;
+    while (start <= body.size())
+    {
+        size_t end = body.find(';', start);
+        if (end == std::string::npos) end = body.size();
+        const std::string line = body.substr(start, end - start);
+        start = end + 1;
+
+        const auto words = splitWords(line);
+        if (words.empty())
+        {
+            continue; // tolerate `a b ; ; c d` and a trailing `;`
+        }
+        const std::string stepNo = std::to_string(def.mSteps.size() + 1);
+        if (std::find(words.begin(), words.end(), "|") != words.end())
+        {
+            error = "Error: macro step " + stepNo + ": pipelines are not supported\n";
+            return false;
+        }
+        if (words.size() < 2)
+        {
+            error = "Error: macro step " + stepNo + " is incomplete: '" + words[0] + "'\n";
+            return false;
+        }
+
+        // Same split as a typed line: `-x` tokens are options, the rest arguments
+        Step step;
+        step.command.component = words[0];
+        step.command.command = words[1];
+        for (size_t i = 2; i < words.size(); ++i)
+        {
+            auto& target = (words[i][0] == '-') ? step.command.options : step.command.arguments;
+            target.push_back(words[i]);
+        }
+        for (size_t i = 0; i < words.size(); ++i)
+        {
+            const size_t highest = highestPlaceholder(words[i]);
+            step.templated = step.templated || highest != 0;
+            step.dynamicTarget = step.dynamicTarget || (i < 2 && highest != 0);
+            def.mArity = std::max(def.mArity, highest);
+        }
+        def.mSteps.push_back(std::move(step));
+    }
+    if (def.mSteps.empty())
+    {
+        error = "Error: macro has no steps\n";
+        return false;
+    }
+    out = std::move(def);
+    return true;
+}
+
+Command MacroDefinition::expand(size_t step, const std::vector<std::string>& args) const
+{
+    Command command = mSteps[step].command;
+    command.component = substitute(command.component, args);
+    command.command = substitute(command.command, args);
+    for (auto& word : command.arguments) word = substitute(word, args);
+    for (auto& word : command.options) word = substitute(word, args);
+    return command;
+}
@@ -0,0 +1,48 @@
+#ifndef MACRO_HPP
+#define MACRO_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "CommandTypes.hpp"
+
+namespace commandshell
+{
+    /* Parsed body of a server-side macro
+    *  A body is a `;`-separated list of command lines, parsed once at
+    *  definition: `led on $1 ; sys delay 100 ; led off $1`. `$1`..`$9` anywhere
+    *  in a word are replaced by the invocation arguments; steps without
+    *  placeholders are used as stored, with no copy or re-parse. A placeholder
+    *  in the component or command word (`led$1 on`) makes the target dynamic,
+    *  so that step is looked up per run instead of once.
+    *  Pipelines are not allowed inside steps.
+    */
+    class MacroDefinition
+    {
+    public:
+        struct Step
+        {
+            Command command;
+            bool templated = false;     // has placeholders, expand() before running
+            bool dynamicTarget = false; // placeholder in component or command
+        };
+
+        // Returns false with an "Error: ..." message when the body is malformed
+        static bool parse(const std::string& body, MacroDefinition& out, std::string& error);
+
+        const std::vector<Step>& steps() const { return mSteps; }
+        const std::string& body() const { return mBody; }
+
+        // Highest placeholder used, i.e. the number of arguments required
+        size_t arity() const { return mArity; }
+
+        // Copy of a templated step with placeholders replaced
+        Command expand(size_t step, const std::vector<std::string>& args) const;
+
+    private:
+        std::string mBody;
+        std::vector<Step> mSteps;
+        size_t mArity = 0;
+    };
+} // namespace commandshell
+#endif // MACRO_HPP
@@ -0,0 +1,113 @@
+#ifndef MPSC_QUEUE_HPP
+#define MPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace commandshell
+{
+    /* Bounded lock-free multi-producer single-consumer queue
+    *  Array of cells each carrying a sequence number (Vyukov's bounded queue):
+    *  producers claim a slot with one CAS on the enqueue position and publish it
+    *  by bumping the cell sequence; the single consumer needs no CAS at all.
+    *  Capacity is rounded up to a power of two. tryPush fails instead of
+    *  waiting when the queue is full. T must be default-constructible.
+    */
+    template <typename T>
+    class MpscQueue
+    {
+    public:
+        explicit MpscQueue(size_t capacity)
+            : mMask(roundUp(capacity) - 1), mCells(new Cell[mMask + 1])
+        {
+            for (size_t i = 0; i <= mMask; ++i)
+            {
+                mCells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        MpscQueue(const MpscQueue&) = delete;
+        MpscQueue& operator=(const MpscQueue&) = delete;
+
+        // Any thread
+        bool tryPush(T&& value)
+        {
+            size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+            Cell* cell;
+            for (;;)
+            {
+                cell = &mCells[pos & mMask];
+                const size_t seq = cell->sequence.load(std::memory_order_acquire);
+                const intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                if (dif == 0)
+                {
+                    if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (dif < 0)
+                {
+                    return false; // full: the consumer has not freed this cell yet
+                }
+                else
+                {
+                    pos = mEnqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+            cell->value = std::move(value);
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer thread only
+        bool tryPop(T& out)
+        {
+            Cell& cell = mCells[mDequeuePos & mMask];
+            const size_t seq = cell.sequence.load(std::memory_order_acquire);
+            if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(mDequeuePos + 1) < 0)
+            {
+                return false; // empty, or the producer has not published yet
+            }
+            out = std::move(cell.value);
+            cell.value = T{};
+            cell.sequence.store(mDequeuePos + mMask + 1, std::memory_order_release);
+            ++mDequeuePos;
+            return true;
+        }
+
+        size_t capacity() const { return mMask + 1; }
+
+        // Approximate when producers are active
+        bool empty() const
+        {
+            return mEnqueuePos.load(std::memory_order_acquire) == mDequeuePos;
+        }
+
+    private:
+        static constexpr size_t kCacheLine = 64;
+
+        struct Cell
+        {
+            std::atomic<size_t> sequence{0};
+            T value{};
+        };
+
+        static size_t roundUp(size_t n)
+        {
+            size_t p = 2;
+            while (p < n) p <<= 1;
+            return p;
+        }
+
+        const size_t mMask;
+        std::unique_ptr<Cell[]> mCells;
+        // Kept on separate cache lines so producers and the consumer do not false-share
+        alignas(kCacheLine) std::atomic<size_t> mEnqueuePos{0};
+        alignas(kCacheLine) size_t mDequeuePos = 0;
+    };
+} // namespace commandshell
+#endif // MPSC_QUEUE_HPP
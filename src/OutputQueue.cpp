@@ -0,0 +1,247 @@
+#include "OutputQueue.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#if COMMANDSHELL_THREADS
+#include <chrono>
+#endif
+
+using namespace commandshell;
+
+OutputQueue::OutputQueue(Writer writer)
+    : OutputQueue(std::move(writer), Options{})
+{
+}
+
+OutputQueue::OutputQueue(Writer writer, Options options)
+    : mWriter(std::move(writer)), mOptions(options)
+{
+    mOptions.capacityBytes = std::max<size_t>(mOptions.capacityBytes, 1);
+    mOptions.resumeBytes = std::min(mOptions.resumeBytes, mOptions.capacityBytes - 1);
+}
+
+OutputQueue::~OutputQueue()
+{
+#if COMMANDSHELL_THREADS
+    stop();
+#endif
+}
+
+void OutputQueue::push(std::string_view data)
+{
+    bool waited = false;
+    while (!data.empty())
+    {
+        size_t take = data.size();
+        {
+            detail::Lock lock(mMutex);
+            const size_t pending = mBuffer.size() - mHead;
+            if (mOptions.policy == Policy::Block)
+            {
+                take = std::min(take, mOptions.capacityBytes - std::min(pending, mOptions.capacityBytes));
+            }
+            if (take != 0)
+            {
+                append(data.substr(0, take));
+                data.remove_prefix(take);
+            }
+            if (!data.empty() && !waited)
+            {
+                waited = true;
+                ++mStats.blockedPushes;
+            }
+        }
+#if COMMANDSHELL_THREADS
+        if (take != 0 && mRunning.load(std::memory_order_acquire))
+        {
+            mDataReady.notify_one();
+        }
+#endif
+        if (!data.empty())
+        {
+            waitForRoom();
+        }
+    }
+}
+
+size_t OutputQueue::drain(size_t maxBytes)
+{
+    detail::Lock consumer(mDrainMutex);
+    size_t written = 0;
+    while (written < maxBytes)
+    {
+        // Copy the front out so the writer runs without blocking pushes
+        uint64_t from = 0;
+        {
+            detail::Lock lock(mMutex);
+            const size_t n = std::min({mBuffer.size() - mHead, maxBytes - written, mOptions.capacityBytes});
+            if (n == 0)
+            {
+                break;
+            }
+            mScratch.assign(mBuffer, mHead, n);
+            from = mConsumed;
+        }
+        const size_t took = std::min(mWriter ? mWriter(mScratch.data(), mScratch.size()) : mScratch.size(), mScratch.size());
+
+        detail::Lock lock(mMutex);
+        // DropOldest may have discarded some of these bytes meanwhile
+        if (from + took > mConsumed)
+        {
+            const size_t advance = static_cast<size_t>(from + took - mConsumed);
+            mHead += advance;
+            mConsumed += advance;
+        }
+        written += took;
+        mStats.writtenBytes += took;
+        if (mHead == mBuffer.size())
+        {
+            mBuffer.clear();
+            mHead = 0;
+        }
+        else if (mHead > mBuffer.size() / 2)
+        {
+            mBuffer.erase(0, mHead);
+            mHead = 0;
+        }
+        if (mPaused && mBuffer.size() - mHead <= mOptions.resumeBytes)
+        {
+            mPaused = false;
+        }
+        if (took == 0)
+        {
+            break; // sink busy; try again on the next drain
+        }
+    }
+#if COMMANDSHELL_THREADS
+    if (written != 0)
+    {
+        mRoomMade.notify_all(); // a blocked push may continue
+    }
+#endif
+    return written;
+}
+
+bool OutputQueue::paused() const
+{
+    detail::Lock lock(mMutex);
+    return mPaused;
+}
+
+size_t OutputQueue::pendingBytes() const
+{
+    detail::Lock lock(mMutex);
+    return mBuffer.size() - mHead;
+}
+
+OutputQueue::Stats OutputQueue::stats() const
+{
+    detail::Lock lock(mMutex);
+    Stats stats = mStats;
+    stats.pendingBytes = mBuffer.size() - mHead;
+    return stats;
+}
+
+#if COMMANDSHELL_THREADS
+void OutputQueue::start()
+{
+    if (mRunning.exchange(true))
+    {
+        return;
+    }
+    mDrainer = std::thread([this]() { runDrainer(); });
+}
+
+void OutputQueue::stop()
+{
+    {
+        detail::Lock lock(mMutex);
+        if (!mRunning.exchange(false))
+        {
+            return;
+        }
+    }
+    mDataReady.notify_all();
+    mRoomMade.notify_all();
+    mDrainer.join();
+}
+
+void OutputQueue::runDrainer()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (;;)
+    {
+        mDataReady.wait(lock, [this]() { return !mRunning.load(std::memory_order_relaxed) || mHead < mBuffer.size(); });
+        if (!mRunning.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+        lock.unlock();
+        const size_t written = drain();
+        lock.lock();
+        if (written == 0 && mHead < mBuffer.size())
+        {
+            // The sink refused bytes and will not say when it has room: retry on a timer
+            mDataReady.wait_for(lock, std::chrono::milliseconds(kBusyRetryMs),
+                [this]() { return !mRunning.load(std::memory_order_relaxed); });
+        }
+    }
+}
+#endif
+
+/******************** Private methods *******************/
+
+void OutputQueue::append(std::string_view data)
+{
+    mStats.queuedBytes += data.size();
+    const size_t pending = mBuffer.size() - mHead;
+    if (mOptions.policy == Policy::DropOldest && pending + data.size() > mOptions.capacityBytes)
+    {
+        // Oldest first: queued bytes, then the front of data itself
+        const size_t excess = pending + data.size() - mOptions.capacityBytes;
+        const size_t fromQueue = std::min(excess, pending);
+        mHead += fromQueue;
+        mConsumed += fromQueue;
+        data.remove_prefix(excess - fromQueue);
+        mStats.droppedBytes += excess;
+        mBuffer.erase(0, mHead);
+        mHead = 0;
+    }
+    mBuffer.append(data.data(), data.size());
+    if (mOptions.policy == Policy::Backpressure && !mPaused && mBuffer.size() - mHead >= mOptions.capacityBytes)
+    {
+        mPaused = true;
+        ++mStats.pauses;
+    }
+}
+
+bool OutputQueue::drainThreadRunning() const
+{
+#if COMMANDSHELL_THREADS
+    return mRunning.load(std::memory_order_acquire);
+#else
+    return false;
+#endif
+}
+
+void OutputQueue::waitForRoom()
+{
+#if COMMANDSHELL_THREADS
+    if (drainThreadRunning())
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mRoomMade.wait(lock, [this]() {
+            return !mRunning.load(std::memory_order_relaxed) || mBuffer.size() - mHead < mOptions.capacityBytes;
+        });
+        return;
+    }
+#endif
+    // No drain thread: the pushing caller writes to the sink itself
+    if (drain() == 0)
+    {
+#if COMMANDSHELL_THREADS
+        std::this_thread::yield();
+#endif
+    }
+}
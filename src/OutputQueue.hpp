@@ -0,0 +1,118 @@
+#ifndef OUTPUT_QUEUE_HPP
+#define OUTPUT_QUEUE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include "CommandShellConfig.hpp"
+
+#if COMMANDSHELL_THREADS
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace commandshell
+{
+    /* Bounded output between a session and a slow sink (UART, socket)
+    *  push() copies a reply into the queue and returns, so command processing
+    *  does not wait for the link. The bytes reach the sink from drain() - the
+    *  main loop on embedded targets - or from the thread started with start().
+    *  The Writer is non-blocking: it takes what it can and returns how many
+    *  bytes it accepted (0 while the sink is busy). It is called without the
+    *  queue lock held, on a copy of the pending bytes, so pushes never wait
+    *  for the sink. The drain thread sleeps until bytes are pushed; only while
+    *  the sink refuses bytes does it retry on a short timer.
+    *
+    *  When the queue holds capacityBytes, the policy decides:
+    *    Block         push() waits for room (drains inline when no thread runs)
+    *    DropOldest    the oldest queued bytes are discarded and counted
+    *    Backpressure  nothing is dropped; paused() is true from capacity until
+    *                  the queue drains to resumeBytes, and a CommandShellIO
+    *                  using the queue holds further input meanwhile
+    *
+    *  Usage:
+    *    OutputQueue out([](const char* d, size_t n) { return uartWrite(d, n); });
+    *    io.setOutputQueue(&out);
+    *    loop: io.poll(); out.drain();   // or out.start() once
+    */
+    class OutputQueue
+    {
+    public:
+        using Writer = std::function<size_t(const char* data, size_t size)>;
+
+        enum class Policy { Block, DropOldest, Backpressure };
+
+        struct Options
+        {
+            size_t capacityBytes = 4096;
+            size_t resumeBytes = 1024; // Backpressure: paused() clears at or below this
+            Policy policy = Policy::Backpressure;
+        };
+
+        struct Stats
+        {
+            uint64_t queuedBytes = 0;   // accepted by push()
+            uint64_t writtenBytes = 0;  // taken by the writer
+            uint64_t droppedBytes = 0;  // DropOldest only
+            uint64_t blockedPushes = 0; // Block: pushes that had to wait
+            uint64_t pauses = 0;        // Backpressure: times paused() turned true
+            size_t pendingBytes = 0;
+        };
+
+        explicit OutputQueue(Writer writer);
+        OutputQueue(Writer writer, Options options);
+        ~OutputQueue();
+
+        OutputQueue(const OutputQueue&) = delete;
+        OutputQueue& operator=(const OutputQueue&) = delete;
+
+        // Any thread
+        void push(std::string_view data);
+
+        // Consumer: hand up to maxBytes to the writer until it stops accepting;
+        // returns the bytes written. Calls are serialized, so bytes stay in order.
+        size_t drain(size_t maxBytes = static_cast<size_t>(-1));
+
+        bool paused() const;
+        size_t pendingBytes() const;
+        Stats stats() const;
+
+#if COMMANDSHELL_THREADS
+        // Drain on a dedicated thread; do not call drain() meanwhile.
+        // stop() returns once the thread has ended; queued bytes stay queued.
+        void start();
+        void stop();
+#endif
+
+    private:
+        static constexpr uint32_t kBusyRetryMs = 1; // drain thread, while the sink refuses bytes
+
+        void append(std::string_view data); // caller holds mMutex
+        bool drainThreadRunning() const;
+        void waitForRoom();
+
+        Writer mWriter;
+        Options mOptions;
+        mutable detail::Mutex mMutex;
+        std::string mBuffer;
+        size_t mHead = 0;       // first pending byte in mBuffer
+        uint64_t mConsumed = 0; // bytes ever written or dropped from the front
+        bool mPaused = false;
+        Stats mStats;
+        detail::Mutex mDrainMutex; // one consumer at a time; guards mScratch
+        std::string mScratch;      // pending bytes copied out for the writer
+#if COMMANDSHELL_THREADS
+        void runDrainer();
+
+        std::thread mDrainer;
+        std::atomic<bool> mRunning{false};
+        std::condition_variable mDataReady; // bytes pushed or stopping; waited on with mMutex
+        std::condition_variable mRoomMade;  // bytes written or stopping; waited on with mMutex
+#endif
+    };
+} // namespace commandshell
+#endif // OUTPUT_QUEUE_HPP
@@ -0,0 +1,226 @@
+#include "SessionMux.hpp"
+#include "CommandShell.hpp"
+
+#include <algorithm>
+#include <utility>
+
+using namespace commandshell;
+
+SessionMux::SessionMux(CommandShell& shell, Writer writer)
+    : SessionMux(shell, std::move(writer), Limits{})
+{
+}
+
+SessionMux::SessionMux(CommandShell& shell, Writer writer, Limits limits)
+    : mShell(shell), mWriter(std::move(writer)), mLimits(limits)
+{
+    // The length field is 16 bits wide
+    mLimits.maxFrameBytes = std::min<size_t>(std::max<size_t>(mLimits.maxFrameBytes, 1), 0xffff);
+}
+
+SessionMux::~SessionMux() = default;
+
+CommandShellIO* SessionMux::open(uint8_t channel, bool echoInput, std::string promptText)
+{
+    auto inserted = mChannels.emplace(channel, Channel{});
+    if (!inserted.second)
+    {
+        return nullptr;
+    }
+    Channel& c = inserted.first->second;
+    c.session = std::make_unique<CommandShellIO>(mShell, echoInput, std::move(promptText));
+    c.session->setOutputCallback([this, &c](const std::string& output) { enqueue(c, output); });
+    return c.session.get();
+}
+
+bool SessionMux::close(uint8_t channel)
+{
+    return mChannels.erase(channel) != 0;
+}
+
+CommandShellIO* SessionMux::session(uint8_t channel)
+{
+    auto it = mChannels.find(channel);
+    return it == mChannels.end() ? nullptr : it->second.session.get();
+}
+
+void SessionMux::input(const char* data, size_t size)
+{
+    mPartial.append(data, size);
+
+    // Anything that does not check out costs one byte and a fresh look for a
+    // sync byte, so a corrupted length cannot swallow the frames behind it
+    size_t pos = 0;
+    while (mPartial.size() - pos >= kHeaderBytes)
+    {
+        if (static_cast<uint8_t>(mPartial[pos]) != kSync)
+        {
+            ++mStats.skippedBytes;
+            ++pos;
+            continue;
+        }
+        const auto channel = static_cast<uint8_t>(mPartial[pos + 1]);
+        const size_t length = (static_cast<size_t>(static_cast<uint8_t>(mPartial[pos + 2])) << 8)
+            | static_cast<uint8_t>(mPartial[pos + 3]);
+        if (length > mLimits.maxFrameBytes)
+        {
+            ++mStats.oversized;
+            ++pos;
+            continue;
+        }
+        if (mPartial.size() - pos < kHeaderBytes + length + kTrailerBytes)
+        {
+            break;
+        }
+        if (crc8(mPartial.data() + pos + 1, kHeaderBytes - 1 + length)
+            != static_cast<uint8_t>(mPartial[pos + kHeaderBytes + length]))
+        {
+            ++mStats.badChecksum;
+            ++pos;
+            continue;
+        }
+        dispatch(channel, mPartial.substr(pos + kHeaderBytes, length));
+        pos += kHeaderBytes + length + kTrailerBytes;
+    }
+    mPartial.erase(0, pos);
+    flush();
+}
+
+void SessionMux::poll(uint32_t budgetUs)
+{
+    for (auto& kv : mChannels)
+    {
+        kv.second.session->poll(budgetUs);
+    }
+    flush();
+}
+
+size_t SessionMux::flush(size_t maxFrames)
+{
+    size_t written = 0;
+    bool progress = true;
+    while (progress && written < maxFrames)
+    {
+        // One frame per channel per turn, continuing after the channel served last
+        progress = false;
+        auto it = mChannels.lower_bound(mNextTurn);
+        for (size_t n = 0; n < mChannels.size() && written < maxFrames; ++n, ++it)
+        {
+            if (it == mChannels.end())
+            {
+                it = mChannels.begin();
+            }
+            Channel& c = it->second;
+            if (c.sent == 0 && c.unreported != 0)
+            {
+                // In place of what was dropped, once no output is half sent
+                std::string marker = "[output] dropped " + std::to_string(c.unreported) + " bytes (slow reader)\n";
+                c.queuedBytes += marker.size();
+                c.queue.push_front(std::move(marker));
+                c.unreported = 0;
+            }
+            if (c.queue.empty())
+            {
+                continue;
+            }
+            const std::string& front = c.queue.front();
+            const size_t length = std::min(front.size() - c.sent, mLimits.maxFrameBytes);
+            const std::string frame = encodeFrame(it->first, std::string_view(front).substr(c.sent, length));
+            c.sent += length;
+            c.queuedBytes -= length;
+            if (c.sent == front.size())
+            {
+                c.queue.pop_front();
+                c.sent = 0;
+            }
+            ++c.stats.framesOut;
+            c.stats.bytesOut += length;
+            if (mWriter)
+            {
+                mWriter(frame.data(), frame.size());
+            }
+            mNextTurn = static_cast<uint8_t>(it->first + 1);
+            ++written;
+            progress = true;
+        }
+    }
+    return written;
+}
+
+SessionMux::ChannelStats SessionMux::stats(uint8_t channel) const
+{
+    auto it = mChannels.find(channel);
+    if (it == mChannels.end())
+    {
+        return ChannelStats{};
+    }
+    ChannelStats stats = it->second.stats;
+    stats.queuedBytes = it->second.queuedBytes;
+    return stats;
+}
+
+std::string SessionMux::encodeFrame(uint8_t channel, std::string_view payload)
+{
+    std::string frame;
+    frame.reserve(kHeaderBytes + payload.size() + kTrailerBytes);
+    frame += static_cast<char>(kSync);
+    frame += static_cast<char>(channel);
+    frame += static_cast<char>((payload.size() >> 8) & 0xff);
+    frame += static_cast<char>(payload.size() & 0xff);
+    frame.append(payload.data(), payload.size());
+    frame += static_cast<char>(crc8(frame.data() + 1, frame.size() - 1));
+    return frame;
+}
+
+uint8_t SessionMux::crc8(const char* data, size_t size, uint8_t crc)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        crc ^= static_cast<uint8_t>(data[i]);
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            crc = static_cast<uint8_t>((crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1);
+        }
+    }
+    return crc;
+}
+
+/******************** Private methods *******************/
+
+void SessionMux::enqueue(Channel& channel, const std::string& output)
+{
+    if (output.empty())
+    {
+        return;
+    }
+    channel.queue.push_back(output);
+    channel.queuedBytes += output.size();
+
+    // Drop whole outputs, oldest first; one already half sent is finished instead
+    while (channel.queuedBytes > mLimits.maxQueuedBytes)
+    {
+        auto victim = channel.queue.begin() + (channel.sent != 0 ? 1 : 0);
+        if (victim == channel.queue.end())
+        {
+            break;
+        }
+        channel.queuedBytes -= victim->size();
+        channel.stats.droppedBytes += victim->size();
+        ++channel.stats.droppedOutputs;
+        channel.unreported += victim->size();
+        channel.queue.erase(victim);
+    }
+}
+
+void SessionMux::dispatch(uint8_t channel, std::string payload)
+{
+    auto it = mChannels.find(channel);
+    if (it == mChannels.end())
+    {
+        ++mStats.unknownChannel;
+        return;
+    }
+    ++it->second.stats.framesIn;
+    it->second.stats.bytesIn += payload.size();
+    it->second.session->input(payload);
+}
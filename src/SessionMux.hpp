@@ -0,0 +1,126 @@
+#ifndef SESSION_MUX_HPP
+#define SESSION_MUX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "CommandShellIO.hpp"
+
+namespace commandshell
+{
+    class CommandShell;
+
+    /* Several logical sessions over one byte stream (e.g. a single UART)
+    *  Frame format, both directions:
+    *    u8      sync, 0xA5
+    *    u8      channel
+    *    u16     payload length, big-endian
+    *    bytes   payload
+    *    u8      CRC-8 (polynomial 0x07) of channel, length and payload
+    *  Each opened channel owns a CommandShellIO with its own line editor,
+    *  history, echo and prompt, so a console, an automation client and an
+    *  event subscriber can share the link. Input frames are fed to their
+    *  channel's session as they complete. A lost or corrupted byte costs the
+    *  frames it touches: the parser drops them (bad CRC, length over the
+    *  limit) and hunts for the next sync byte. Session output is queued per
+    *  channel as whole outputs, up to maxQueuedBytes; when a queue is full its
+    *  oldest outputs are dropped and counted, and the reader gets a
+    *  "[output] dropped N bytes (slow reader)" line in their place, so one
+    *  stalled reader cannot hold memory for the rest and no output arrives
+    *  cut. flush() sends queued output round-robin, one frame per channel per
+    *  turn, and starts each call one channel after the previous one.
+    *  Single-threaded: call input(), poll() and flush() from the same loop.
+    */
+    class SessionMux
+    {
+    public:
+        using Writer = std::function<void(const char* data, size_t size)>;
+
+        static constexpr uint8_t kSync = 0xA5;
+        static constexpr size_t kHeaderBytes = 4;
+        static constexpr size_t kTrailerBytes = 1;
+
+        struct Limits
+        {
+            size_t maxFrameBytes = 256;   // payload limit, both directions
+            size_t maxQueuedBytes = 4096; // output queued per channel
+        };
+
+        struct ChannelStats
+        {
+            uint64_t framesIn = 0;
+            uint64_t bytesIn = 0;
+            uint64_t framesOut = 0;
+            uint64_t bytesOut = 0;
+            uint64_t droppedBytes = 0;   // output lost to a full queue
+            uint64_t droppedOutputs = 0; // whole outputs those bytes belonged to
+            size_t queuedBytes = 0;
+        };
+
+        struct Stats
+        {
+            uint64_t unknownChannel = 0; // frames for channels not open
+            uint64_t oversized = 0;      // headers over maxFrameBytes, skipped
+            uint64_t badChecksum = 0;    // frames failing the CRC, skipped
+            uint64_t skippedBytes = 0;   // discarded while hunting for a sync byte
+        };
+
+        SessionMux(CommandShell& shell, Writer writer);
+        SessionMux(CommandShell& shell, Writer writer, Limits limits);
+        ~SessionMux();
+
+        SessionMux(const SessionMux&) = delete;
+        SessionMux& operator=(const SessionMux&) = delete;
+
+        // Open a channel with its own session (nullptr if already open); the prompt is queued
+        CommandShellIO* open(uint8_t channel, bool echoInput = true, std::string promptText = "cmd> ");
+        bool close(uint8_t channel);
+        CommandShellIO* session(uint8_t channel);
+
+        // Feed raw link bytes; frames may be split or batched arbitrarily
+        void input(const char* data, size_t size);
+
+        // Poll every session (events, watches, resumable commands), then flush()
+        void poll(uint32_t budgetUs = 0);
+
+        // Write up to maxFrames queued frames; returns how many were written
+        size_t flush(size_t maxFrames = static_cast<size_t>(-1));
+
+        ChannelStats stats(uint8_t channel) const;
+        Stats stats() const { return mStats; }
+
+        // One frame as it appears on the link (payload must fit in 16 bits)
+        static std::string encodeFrame(uint8_t channel, std::string_view payload);
+
+        // CRC-8, polynomial 0x07, initial value 0
+        static uint8_t crc8(const char* data, size_t size, uint8_t crc = 0);
+
+    private:
+        struct Channel
+        {
+            std::unique_ptr<CommandShellIO> session;
+            std::deque<std::string> queue; // whole session outputs, oldest first
+            size_t sent = 0;               // bytes of queue.front() already framed
+            size_t queuedBytes = 0;        // not yet framed
+            uint64_t unreported = 0;       // dropped bytes the reader was not told about
+            ChannelStats stats;
+        };
+
+        void enqueue(Channel& channel, const std::string& output);
+        void dispatch(uint8_t channel, std::string payload);
+
+        CommandShell& mShell;
+        Writer mWriter;
+        Limits mLimits;
+        Stats mStats;
+        std::map<uint8_t, Channel> mChannels;
+        std::string mPartial;   // bytes of an incomplete frame
+        uint8_t mNextTurn = 0;  // first channel considered by the next flush()
+    };
+} // namespace commandshell
+#endif // SESSION_MUX_HPP
@@ -0,0 +1,101 @@
+#include "StringPool.hpp"
+
+using namespace commandshell;
+
+void StringPool::reserve(size_t bytes, size_t strings)
+{
+    mArena.reserve(bytes);
+    mHandles.reserve(strings);
+    if (strings * 2 > mSlots.size())
+    {
+        rehash(strings * 2);
+    }
+}
+
+StringPool::Handle StringPool::intern(std::string_view text)
+{
+    ++mStats.requests;
+    if (text.empty())
+    {
+        return Handle{};
+    }
+    // Keep the index at most half full
+    if ((mHandles.size() + 1) * 2 > mSlots.size())
+    {
+        rehash((mHandles.size() + 1) * 4);
+    }
+
+    const size_t mask = mSlots.size() - 1;
+    for (size_t slot = hashOf(text) & mask;; slot = (slot + 1) & mask)
+    {
+        const uint32_t index = mSlots[slot];
+        if (index == 0)
+        {
+            Handle handle{static_cast<uint32_t>(mArena.size()), static_cast<uint32_t>(text.size())};
+            mArena.append(text.data(), text.size());
+            mHandles.push_back(handle);
+            mSlots[slot] = static_cast<uint32_t>(mHandles.size());
+            ++mStats.strings;
+            mStats.bytes = mArena.size();
+            return handle;
+        }
+        const Handle existing = mHandles[index - 1];
+        if (view(existing) == text)
+        {
+            mStats.savedBytes += text.size();
+            return existing;
+        }
+    }
+}
+
+void StringPool::shrinkToFit()
+{
+    mArena.shrink_to_fit();
+    mHandles.shrink_to_fit();
+    mSlots.clear();
+    mSlots.shrink_to_fit();
+}
+
+size_t StringPool::memoryFootprint() const
+{
+    auto block = [](size_t bytes) { return bytes == 0 ? 0 : bytes + kBlockOverhead; };
+    return block(mArena.capacity()) + block(mHandles.capacity() * sizeof(Handle)) + block(mSlots.capacity() * sizeof(uint32_t));
+}
+
+size_t StringPool::heapBytes(const std::string& text)
+{
+    static const size_t kInline = std::string().capacity();
+    return text.capacity() > kInline ? text.capacity() + 1 + kBlockOverhead : 0;
+}
+
+uint32_t StringPool::hashOf(std::string_view text)
+{
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (char c : text)
+    {
+        h ^= static_cast<unsigned char>(c);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void StringPool::rehash(size_t slots)
+{
+    size_t size = 16;
+    while (size < slots)
+    {
+        size *= 2;
+    }
+    mSlots.assign(size, 0);
+    const size_t mask = size - 1;
+    for (size_t i = 0; i < mHandles.size(); ++i)
+    {
+        size_t slot = hashOf(view(mHandles[i])) & mask;
+        while (mSlots[slot] != 0)
+        {
+            slot = (slot + 1) & mask;
+        }
+        mSlots[slot] = static_cast<uint32_t>(i + 1);
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef STRING_POOL_HPP
+#define STRING_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace commandshell
+{
+    /* Append-only pool of interned strings
+    *  Each distinct string is stored once in a contiguous arena and referred to
+    *  by an 8-byte Handle {offset, size} instead of a 32-byte std::string plus
+    *  its heap block. Interning the same text again returns the same handle
+    *  (open-addressing hash index over the handles). Views are valid until the
+    *  next intern() that grows the arena; reserve() up front to keep them stable.
+    */
+    class StringPool
+    {
+    public:
+        struct Handle
+        {
+            uint32_t offset = 0;
+            uint32_t size = 0;
+
+            bool empty() const { return size == 0; }
+        };
+
+        struct Stats
+        {
+            size_t strings = 0;    // distinct non-empty strings stored
+            size_t bytes = 0;      // arena bytes in use
+            size_t requests = 0;   // intern() calls
+            size_t savedBytes = 0; // bytes not stored because the text was already pooled
+        };
+
+        void reserve(size_t bytes, size_t strings);
+
+        Handle intern(std::string_view text);
+
+        std::string_view view(Handle handle) const
+        {
+            return std::string_view(mArena.data() + handle.offset, handle.size);
+        }
+
+        Stats stats() const { return mStats; }
+
+        // Release spare arena capacity and the hash index (views are invalidated);
+        // a later intern() rebuilds the index
+        void shrinkToFit();
+
+        // Bytes reserved by the arena and the index
+        size_t memoryFootprint() const;
+
+        // Allocator bookkeeping charged per heap block in footprint estimates
+        static constexpr size_t kBlockOverhead = 2 * sizeof(void*);
+
+        // Heap bytes a std::string owns beyond its object, block header included
+        // (0 while it fits the small buffer)
+        static size_t heapBytes(const std::string& text);
+
+    private:
+        static uint32_t hashOf(std::string_view text);
+        void rehash(size_t slots);
+
+        std::string mArena;
+        std::vector<Handle> mHandles; // one per distinct string
+        std::vector<uint32_t> mSlots; // index into mHandles + 1; 0 = free
+        Stats mStats;
+    };
+} // namespace commandshell
+#endif // STRING_POOL_HPP
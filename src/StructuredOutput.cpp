@@ -0,0 +1,178 @@
+#include "StructuredOutput.hpp"
+
+using namespace commandshell;
+
+/******************** JSON *******************/
+
+void JsonWriter::separate()
+{
+    if (mAfterKey)
+    {
+        mAfterKey = false;
+        return;
+    }
+    if (!mHasItems.empty())
+    {
+        if (mHasItems.back()) mOut += ',';
+        mHasItems.back() = true;
+    }
+}
+
+void JsonWriter::appendString(std::string_view text)
+{
+    static const char kHex[] = "0123456789abcdef";
+    mOut += '"';
+    for (char c : text)
+    {
+        switch (c)
+        {
+        case '"': mOut += "\\\""; break;
+        case '\\': mOut += "\\\\"; break;
+        case '\n': mOut += "\\n"; break;
+        case '\r': mOut += "\\r"; break;
+        case '\t': mOut += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                mOut += "\\u00";
+                mOut += kHex[(c >> 4) & 0xF];
+                mOut += kHex[c & 0xF];
+            }
+            else
+            {
+                mOut += c;
+            }
+        }
+    }
+    mOut += '"';
+}
+
+void JsonWriter::beginObject()
+{
+    separate();
+    mOut += '{';
+    mHasItems.push_back(false);
+}
+
+void JsonWriter::endObject()
+{
+    mHasItems.pop_back();
+    mOut += '}';
+}
+
+void JsonWriter::beginArray()
+{
+    separate();
+    mOut += '[';
+    mHasItems.push_back(false);
+}
+
+void JsonWriter::endArray()
+{
+    mHasItems.pop_back();
+    mOut += ']';
+}
+
+void JsonWriter::key(std::string_view name)
+{
+    separate();
+    appendString(name);
+    mOut += ':';
+    mAfterKey = true;
+}
+
+void JsonWriter::value(std::string_view text)
+{
+    separate();
+    appendString(text);
+}
+
+void JsonWriter::value(uint64_t number)
+{
+    separate();
+    mOut += std::to_string(number);
+}
+
+void JsonWriter::value(bool flag)
+{
+    separate();
+    mOut += flag ? "true" : "false";
+}
+
+void JsonWriter::null()
+{
+    separate();
+    mOut += "null";
+}
+
+/******************** CBOR *******************/
+
+namespace {
+    constexpr uint8_t kMajorUnsigned = 0;
+    constexpr uint8_t kMajorText = 3;
+    constexpr char kIndefiniteArray = static_cast<char>(0x9F);
+    constexpr char kIndefiniteMap = static_cast<char>(0xBF);
+    constexpr char kBreak = static_cast<char>(0xFF);
+    constexpr char kFalse = static_cast<char>(0xF4);
+    constexpr char kTrue = static_cast<char>(0xF5);
+    constexpr char kNull = static_cast<char>(0xF6);
+}
+
+void CborWriter::head(uint8_t major, uint64_t argument)
+{
+    const uint8_t type = static_cast<uint8_t>(major << 5);
+    int bytes = 0;
+    if (argument < 24)
+    {
+        mOut += static_cast<char>(type | argument);
+        return;
+    }
+    if (argument <= 0xFF) { mOut += static_cast<char>(type | 24); bytes = 1; }
+    else if (argument <= 0xFFFF) { mOut += static_cast<char>(type | 25); bytes = 2; }
+    else if (argument <= 0xFFFFFFFFull) { mOut += static_cast<char>(type | 26); bytes = 4; }
+    else { mOut += static_cast<char>(type | 27); bytes = 8; }
+    for (int i = bytes - 1; i >= 0; --i)
+    {
+        mOut += static_cast<char>((argument >> (8 * i)) & 0xFF);
+    }
+}
+
+void CborWriter::beginObject() { mOut += kIndefiniteMap; }
+void CborWriter::endObject() { mOut += kBreak; }
+void CborWriter::beginArray() { mOut += kIndefiniteArray; }
+void CborWriter::endArray() { mOut += kBreak; }
+
+void CborWriter::key(std::string_view name)
+{
+    value(name);
+}
+
+void CborWriter::value(std::string_view text)
+{
+    head(kMajorText, text.size());
+    mOut.append(text.data(), text.size());
+}
+
+void CborWriter::value(uint64_t number)
+{
+    head(kMajorUnsigned, number);
+}
+
+void CborWriter::value(bool flag)
+{
+    mOut += flag ? kTrue : kFalse;
+}
+
+void CborWriter::null()
+{
+    mOut += kNull;
+}
+
+bool commandshell::parseOutputFormat(std::string_view name, OutputFormat& format)
+{
+    if (name == "text") format = OutputFormat::Text;
+    else if (name == "json") format = OutputFormat::Json;
+    else if (name == "cbor") format = OutputFormat::Cbor;
+    else return false;
+    return true;
+}
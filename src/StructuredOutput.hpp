@@ -0,0 +1,116 @@
+#ifndef STRUCTURED_OUTPUT_HPP
+#define STRUCTURED_OUTPUT_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "CommandTypes.hpp"
+
+namespace commandshell
+{
+    /* Streaming encoder for machine-readable output
+    *  Values are appended straight to the caller's output string as they are
+    *  written - no document tree and no ostringstream. Inside an object each
+    *  value is preceded by key(). Example:
+    *    w.beginObject(); w.key("name"); w.value("led"); w.endObject();
+    */
+    class StructuredWriter
+    {
+    public:
+        virtual ~StructuredWriter() = default;
+
+        virtual void beginObject() = 0;
+        virtual void endObject() = 0;
+        virtual void beginArray() = 0;
+        virtual void endArray() = 0;
+        virtual void key(std::string_view name) = 0;
+        virtual void value(std::string_view text) = 0;
+        virtual void value(uint64_t number) = 0;
+        virtual void value(bool flag) = 0;
+        virtual void null() = 0;
+
+        void value(const char* text) { value(std::string_view(text)); }
+        void value(const std::string& text) { value(std::string_view(text)); }
+        void value(uint32_t number) { value(static_cast<uint64_t>(number)); }
+
+        // key(name) followed by value(v)
+        template <typename T>
+        void field(std::string_view name, const T& v)
+        {
+            key(name);
+            value(v);
+        }
+    };
+
+    // Compact JSON (UTF-8 passed through, control characters escaped)
+    class JsonWriter : public StructuredWriter
+    {
+    public:
+        explicit JsonWriter(std::string& out) : mOut(out) {}
+
+        void beginObject() override;
+        void endObject() override;
+        void beginArray() override;
+        void endArray() override;
+        void key(std::string_view name) override;
+        void value(std::string_view text) override;
+        void value(uint64_t number) override;
+        void value(bool flag) override;
+        void null() override;
+        using StructuredWriter::value;
+
+    private:
+        void separate();
+        void appendString(std::string_view text);
+
+        std::string& mOut;
+        std::vector<bool> mHasItems; // per open container
+        bool mAfterKey = false;
+    };
+
+    // CBOR (RFC 8949) using indefinite-length maps and arrays, so nothing is buffered
+    class CborWriter : public StructuredWriter
+    {
+    public:
+        explicit CborWriter(std::string& out) : mOut(out) {}
+
+        void beginObject() override;
+        void endObject() override;
+        void beginArray() override;
+        void endArray() override;
+        void key(std::string_view name) override;
+        void value(std::string_view text) override;
+        void value(uint64_t number) override;
+        void value(bool flag) override;
+        void null() override;
+        using StructuredWriter::value;
+
+    private:
+        void head(uint8_t major, uint64_t argument);
+
+        std::string& mOut;
+    };
+
+    // "text", "json" or "cbor"; false for anything else
+    bool parseOutputFormat(std::string_view name, OutputFormat& format);
+
+    // Run fn with a writer for format appending to out. JSON documents end with
+    // a newline so line-oriented clients can frame them. format must not be Text.
+    template <typename Fn>
+    void writeStructured(OutputFormat format, std::string& out, Fn&& fn)
+    {
+        if (format == OutputFormat::Cbor)
+        {
+            CborWriter writer(out);
+            fn(static_cast<StructuredWriter&>(writer));
+        }
+        else
+        {
+            JsonWriter writer(out);
+            fn(static_cast<StructuredWriter&>(writer));
+            out += '\n';
+        }
+    }
+} // namespace commandshell
+#endif // STRUCTURED_OUTPUT_HPP
@@ -0,0 +1,71 @@
+#include "ThreadPool.hpp"
+
+#if COMMANDSHELL_THREADS
+
+using namespace commandshell;
+
+namespace {
+    thread_local bool tOnWorker = false;
+}
+
+ThreadPool::ThreadPool(size_t threads)
+{
+    if (threads == 0)
+    {
+        threads = 1;
+    }
+    mWorkers.reserve(threads);
+    for (size_t i = 0; i < threads; ++i)
+    {
+        mWorkers.emplace_back([this]() { run(); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mWake.notify_all();
+    for (auto& worker : mWorkers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTasks.push_back(std::move(task));
+    }
+    mWake.notify_one();
+}
+
+bool ThreadPool::onWorkerThread()
+{
+    return tOnWorker;
+}
+
+void ThreadPool::run()
+{
+    tOnWorker = true;
+    for (;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWake.wait(lock, [this]() { return mStopping || !mTasks.empty(); });
+            if (mTasks.empty())
+            {
+                return; // stopping and drained
+            }
+            task = std::move(mTasks.front());
+            mTasks.pop_front();
+        }
+        task();
+    }
+}
+
+#endif // COMMANDSHELL_THREADS
@@ -0,0 +1,43 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include "CommandShellConfig.hpp"
+
+#if COMMANDSHELL_THREADS
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace commandshell
+{
+    // Fixed-size worker pool; the destructor finishes queued tasks and joins
+    class ThreadPool
+    {
+    public:
+        explicit ThreadPool(size_t threads);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        void submit(std::function<void()> task);
+        size_t size() const { return mWorkers.size(); }
+
+        // True when called from any ThreadPool worker
+        static bool onWorkerThread();
+
+    private:
+        void run();
+
+        std::vector<std::thread> mWorkers;
+        std::deque<std::function<void()>> mTasks;
+        std::mutex mMutex;
+        std::condition_variable mWake;
+        bool mStopping = false;
+    };
+} // namespace commandshell
+#endif // COMMANDSHELL_THREADS
+#endif // THREAD_POOL_HPP
@@ -0,0 +1,147 @@
+#include "Trace.hpp"
+
+#if COMMANDSHELL_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+using namespace commandshell;
+
+namespace {
+    struct Span
+    {
+        const char* name;
+        uint64_t startUs;
+        uint64_t durationUs;
+    };
+
+    // Written only by its thread; readers use the published counters
+    struct Ring
+    {
+        uint32_t tid = 0;
+        std::atomic<uint64_t> written{0};
+        std::atomic<uint64_t> clearedAt{0};
+        Span spans[trace::kRingCapacity];
+    };
+
+    struct Registry
+    {
+        detail::Mutex mutex;
+        std::vector<std::shared_ptr<Ring>> rings; // rings outlive their threads
+    };
+
+    Registry& registry()
+    {
+        static Registry r;
+        return r;
+    }
+
+    Ring& threadRing()
+    {
+        // The registry lock is taken once per thread, on its first span
+        thread_local std::shared_ptr<Ring> ring = []() {
+            auto r = std::make_shared<Ring>();
+            auto& reg = registry();
+            detail::Lock lock(reg.mutex);
+            r->tid = static_cast<uint32_t>(reg.rings.size() + 1);
+            reg.rings.push_back(r);
+            return r;
+        }();
+        return *ring;
+    }
+
+    uint64_t nowMicros()
+    {
+        using namespace std::chrono;
+        return static_cast<uint64_t>(duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count());
+    }
+
+    void appendJsonString(std::ostringstream& os, const char* s)
+    {
+        os << '"';
+        for (; *s != '\0'; ++s)
+        {
+            if (*s == '"' || *s == '\\') os << '\\';
+            os << *s;
+        }
+        os << '"';
+    }
+
+    template <typename Fn>
+    void forEachSpan(Fn&& fn)
+    {
+        auto& reg = registry();
+        detail::Lock lock(reg.mutex);
+        for (const auto& ring : reg.rings)
+        {
+            const uint64_t end = ring->written.load(std::memory_order_acquire);
+            uint64_t begin = ring->clearedAt.load(std::memory_order_relaxed);
+            if (end - begin > trace::kRingCapacity) begin = end - trace::kRingCapacity;
+            for (uint64_t i = begin; i < end; ++i)
+            {
+                fn(ring->tid, ring->spans[i % trace::kRingCapacity]);
+            }
+        }
+    }
+}
+
+trace::ScopedSpan::ScopedSpan(const char* name)
+    : mName(name), mStartUs(nowMicros()) {}
+
+trace::ScopedSpan::~ScopedSpan()
+{
+    Ring& ring = threadRing();
+    const uint64_t n = ring.written.load(std::memory_order_relaxed);
+    ring.spans[n % kRingCapacity] = Span{mName, mStartUs, nowMicros() - mStartUs};
+    ring.written.store(n + 1, std::memory_order_release);
+}
+
+std::string trace::dumpChromeTrace()
+{
+    std::ostringstream os;
+    os << "{\"traceEvents\":[";
+    bool first = true;
+    forEachSpan([&](uint32_t tid, const Span& span) {
+        os << (first ? "\n" : ",\n") << "{\"name\":";
+        appendJsonString(os, span.name);
+        os << ",\"ph\":\"X\",\"ts\":" << span.startUs << ",\"dur\":" << span.durationUs
+           << ",\"pid\":1,\"tid\":" << tid << "}";
+        first = false;
+    });
+    os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return os.str();
+}
+
+bool trace::writeChromeTrace(const std::string& path)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        return false;
+    }
+    out << dumpChromeTrace();
+    return static_cast<bool>(out);
+}
+
+void trace::clearTrace()
+{
+    auto& reg = registry();
+    detail::Lock lock(reg.mutex);
+    for (const auto& ring : reg.rings)
+    {
+        ring->clearedAt.store(ring->written.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+}
+
+size_t trace::spanCount()
+{
+    size_t count = 0;
+    forEachSpan([&count](uint32_t, const Span&) { ++count; });
+    return count;
+}
+
+#endif // COMMANDSHELL_TRACE
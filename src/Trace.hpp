@@ -0,0 +1,64 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include "CommandShellConfig.hpp"
+
+/* Span instrumentation exported as Chrome trace-event JSON (Perfetto, chrome://tracing)
+*  Enabled with COMMANDSHELL_TRACE=1 (CMake: -DENABLE_TRACE=ON). When disabled,
+*  COMMANDSHELL_TRACE_SCOPE expands to nothing and none of the API below exists.
+*
+*  Usage:
+*    void work() { COMMANDSHELL_TRACE_SCOPE("work"); ... }
+*    commandshell::trace::writeChromeTrace("shell.trace.json");
+*/
+#if COMMANDSHELL_TRACE
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace commandshell {
+namespace trace {
+    // Spans kept per thread; older ones are overwritten
+    constexpr size_t kRingCapacity = 4096;
+
+    // Records [construction, destruction) into the calling thread's ring.
+    // name must outlive the trace (use string literals).
+    class ScopedSpan
+    {
+    public:
+        explicit ScopedSpan(const char* name);
+        ~ScopedSpan();
+
+        ScopedSpan(const ScopedSpan&) = delete;
+        ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+    private:
+        const char* mName;
+        uint64_t mStartUs;
+    };
+
+    // All recorded spans as {"traceEvents":[...]} complete ("X") events. Dump while
+    // instrumented threads are quiet; a span written during the dump may be torn.
+    std::string dumpChromeTrace();
+    bool writeChromeTrace(const std::string& path);
+
+    // Forget recorded spans on every thread
+    void clearTrace();
+
+    // Spans currently held across all rings
+    size_t spanCount();
+} // namespace trace
+} // namespace commandshell
+
+#define COMMANDSHELL_TRACE_CONCAT_(a, b) a##b
+#define COMMANDSHELL_TRACE_CONCAT(a, b) COMMANDSHELL_TRACE_CONCAT_(a, b)
+#define COMMANDSHELL_TRACE_SCOPE(name) \
+    ::commandshell::trace::ScopedSpan COMMANDSHELL_TRACE_CONCAT(csTraceSpan_, __LINE__)(name)
+
+#else
+
+#define COMMANDSHELL_TRACE_SCOPE(name) ((void)0)
+
+#endif // COMMANDSHELL_TRACE
+#endif // TRACE_HPP
@@ -0,0 +1,180 @@
+#include "WatchScheduler.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <string_view>
+#include <utility>
+
+using namespace commandshell;
+
+namespace {
+    std::vector<std::string_view> splitLines(const std::string& text)
+    {
+        std::vector<std::string_view> lines;
+        size_t start = 0;
+        while (start < text.size())
+        {
+            size_t end = text.find('\n', start);
+            if (end == std::string::npos) end = text.size();
+            lines.emplace_back(text.data() + start, end - start);
+            start = end + 1;
+        }
+        return lines;
+    }
+
+    void appendLine(std::string& out, char mark, std::string_view line)
+    {
+        out += mark;
+        out += ' ';
+        out.append(line.data(), line.size());
+        out += '\n';
+    }
+}
+
+uint32_t WatchScheduler::add(Watch watch, uint64_t nowUs)
+{
+    watch.id = mNextId++;
+    watch.nextDueUs = nowUs;
+    watch.lastPoll = 0;
+    mWatches.push_back(std::move(watch));
+    return mWatches.back().id;
+}
+
+bool WatchScheduler::stop(uint32_t id)
+{
+    auto it = std::find_if(mWatches.begin(), mWatches.end(), [id](const Watch& w) { return w.id == id; });
+    if (it == mWatches.end())
+    {
+        return false;
+    }
+    mWatches.erase(it);
+    return true;
+}
+
+size_t WatchScheduler::stopAll()
+{
+    const size_t count = mWatches.size();
+    mWatches.clear();
+    return count;
+}
+
+uint64_t WatchScheduler::nextDueUs() const
+{
+    uint64_t due = std::numeric_limits<uint64_t>::max();
+    for (const auto& w : mWatches)
+    {
+        due = std::min(due, w.nextDueUs);
+    }
+    return due;
+}
+
+void WatchScheduler::run(uint64_t nowUs, size_t maxRuns, const Runner& runner, std::vector<Update>& updates)
+{
+    ++mPolls;
+    for (size_t n = 0; n < maxRuns; ++n)
+    {
+        // Dozens of watches at most, so a scan beats keeping a heap in order
+        Watch* next = nullptr;
+        for (auto& w : mWatches)
+        {
+            if (w.lastPoll != mPolls && w.nextDueUs <= nowUs && (next == nullptr || w.nextDueUs < next->nextDueUs))
+            {
+                next = &w;
+            }
+        }
+        if (next == nullptr)
+        {
+            return;
+        }
+
+        Watch& w = *next;
+        auto ran = runner(w);
+        w.lastPoll = mPolls;
+        if (!ran)
+        {
+            ++w.deferred; // still due: retried on the next call
+            continue;
+        }
+        std::string output = std::move(*ran);
+        ++w.runs;
+        const uint64_t intervalUs = static_cast<uint64_t>(w.intervalMs) * 1000;
+        w.nextDueUs += intervalUs;
+        if (w.nextDueUs < nowUs)
+        {
+            w.nextDueUs = nowUs + intervalUs;
+        }
+
+        Update update;
+        update.changed = w.runs == 1 || output != w.last;
+        if (update.changed)
+        {
+            update.diff = w.diff && w.runs > 1;
+            update.text = update.diff ? diffLines(w.last, output) : output;
+            w.last = std::move(output);
+            // Outputs that differ only in line endings leave nothing to show as a diff
+            update.changed = !update.diff || !update.text.empty();
+        }
+        if (update.changed)
+        {
+            ++w.changes;
+        }
+        update.finished = w.remaining != 0 && --w.remaining == 0;
+        if (!update.changed && !update.finished)
+        {
+            continue;
+        }
+        update.id = w.id;
+        update.line = w.line;
+        update.runs = w.runs;
+        update.changes = w.changes;
+        updates.push_back(std::move(update));
+        if (updates.back().finished)
+        {
+            stop(w.id);
+        }
+    }
+}
+
+std::string WatchScheduler::diffLines(const std::string& before, const std::string& after)
+{
+    const auto a = splitLines(before);
+    const auto b = splitLines(after);
+
+    // Unchanged head and tail are left out
+    size_t head = 0;
+    while (head < a.size() && head < b.size() && a[head] == b[head])
+    {
+        ++head;
+    }
+    size_t tail = 0;
+    while (tail < a.size() - head && tail < b.size() - head && a[a.size() - 1 - tail] == b[b.size() - 1 - tail])
+    {
+        ++tail;
+    }
+
+    std::string out;
+    const size_t removed = a.size() - head - tail;
+    const size_t added = b.size() - head - tail;
+    if (removed == added)
+    {
+        // Same shape (typical for status tables): only the lines that changed
+        for (size_t i = head; i < head + removed; ++i)
+        {
+            if (a[i] != b[i])
+            {
+                appendLine(out, '-', a[i]);
+                appendLine(out, '+', b[i]);
+            }
+        }
+        return out;
+    }
+    for (size_t i = head; i < head + removed; ++i)
+    {
+        appendLine(out, '-', a[i]);
+    }
+    for (size_t i = head; i < head + added; ++i)
+    {
+        appendLine(out, '+', b[i]);
+    }
+    return out;
+}
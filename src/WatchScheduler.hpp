@@ -0,0 +1,87 @@
+#ifndef WATCH_SCHEDULER_HPP
+#define WATCH_SCHEDULER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+#include "CommandPipeline.hpp"
+#include "CommandTypes.hpp"
+
+namespace commandshell
+{
+    /* Periodic commands of one CommandShellIO session (`watch`, `repeat`)
+    *  Each watch holds its command line parsed once and runs on the session's
+    *  own clock from run(). The previous output is kept, and an update is
+    *  produced only when the new output differs: the full text, or with diff
+    *  set a line diff against the last one. A run that changes nothing costs
+    *  the handler call and one compare. A repeat finishes after its count;
+    *  a watch runs until stopped. The runner may defer a run (the session's
+    *  admission limit refused it): the watch stays due and is tried again on
+    *  the next run(). Not thread-safe; owned by the session.
+    */
+    class WatchScheduler
+    {
+    public:
+        struct Watch
+        {
+            uint32_t id = 0;
+            std::string line; // as typed, for listings
+            Command command;
+            std::vector<PipelineStage> stages;
+            uint32_t intervalMs = 0;
+            uint32_t remaining = 0; // runs left for a repeat; 0 runs until stopped
+            bool diff = false;
+            uint64_t runs = 0;
+            uint64_t changes = 0;
+            uint64_t deferred = 0; // runs the runner put off
+            uint64_t nextDueUs = 0;
+            uint64_t lastPoll = 0; // run() call that last ran it
+            std::string last;
+        };
+
+        struct Update
+        {
+            uint32_t id = 0;
+            std::string line;
+            std::string text;      // full output, or a line diff when diff is set
+            bool changed = false;  // text is set (a finished repeat may not have changed)
+            bool diff = false;
+            bool finished = false; // repeat done; runs/changes are final
+            uint64_t runs = 0;
+            uint64_t changes = 0;
+        };
+
+        // Output of one run, or nullopt to defer it
+        using Runner = std::function<std::optional<std::string>(const Watch&)>;
+
+        // First run is due immediately; returns the watch id
+        uint32_t add(Watch watch, uint64_t nowUs);
+
+        bool stop(uint32_t id);
+        size_t stopAll();
+
+        size_t size() const { return mWatches.size(); }
+        const std::vector<Watch>& watches() const { return mWatches; }
+
+        // Earliest due time, or UINT64_MAX with no watches (for sleeping main loops)
+        uint64_t nextDueUs() const;
+
+        /* Run up to maxRuns due watches, most overdue first, each at most once per
+        *  call, and append an Update for every changed output or finished repeat.
+        *  Ticks missed while the loop was late are skipped, not replayed.
+        */
+        void run(uint64_t nowUs, size_t maxRuns, const Runner& runner, std::vector<Update>& updates);
+
+        // `- old` / `+ new` lines for what changed between two outputs
+        static std::string diffLines(const std::string& before, const std::string& after);
+
+    private:
+        std::vector<Watch> mWatches;
+        uint32_t mNextId = 1;
+        uint64_t mPolls = 0;
+    };
+} // namespace commandshell
+#endif // WATCH_SCHEDULER_HPP
@@ -0,0 +1,290 @@
+#include "Watchdog.hpp"
+
+#include <algorithm>
+
+using namespace commandshell;
+
+#if COMMANDSHELL_THREADS
+
+namespace {
+    // State of the watchdog whose worker runs on this thread, if any
+    thread_local const void* tWorkerOf = nullptr;
+}
+
+Watchdog::Watchdog(uint32_t graceMs, size_t maxWorkers)
+    : mState(std::make_shared<State>())
+{
+    mState->graceMs = graceMs;
+    mState->maxWorkers = maxWorkers == 0 ? 1 : maxWorkers;
+}
+
+Watchdog::~Watchdog()
+{
+    std::unique_lock<std::mutex> lock(mState->mutex);
+    mState->stopping = true;
+    mState->queue.clear();
+    for (const auto& job : mState->running)
+    {
+        job->token.cancel();
+    }
+    // The clock may capture the owner's state; late work falls back to the steady clock
+    mState->clock = nullptr;
+    mState->wake.notify_all();
+    // Work that ignores cancellation must not block shutdown: each worker owns
+    // a reference to the shared state and exits once its work returns
+    mState->jobDone.wait_for(lock, std::chrono::milliseconds(mState->graceMs),
+        [this]() { return mState->workers == 0; });
+}
+
+void Watchdog::setClock(std::function<uint64_t()> nowUs)
+{
+    std::lock_guard<std::mutex> lock(mState->mutex);
+    mState->clock = std::move(nowUs);
+}
+
+std::optional<std::string> Watchdog::run(const std::string& key, const std::string& name, uint32_t deadlineMs,
+                                         std::function<std::string(const CancellationToken&)> work)
+{
+    auto job = std::make_shared<Job>();
+    job->key = key;
+    job->name = name;
+    job->work = std::move(work);
+
+    State& state = *mState;
+    std::unique_lock<std::mutex> lock(state.mutex);
+    job->token = CancellationToken::withDeadline(deadlineMs, state.clock);
+    ++state.stats.started;
+    if (tWorkerOf == &state)
+    {
+        // Called from bounded work, which may hold this key: run inline (the
+        // caller's own deadline still bounds both) and drop late output
+        lock.unlock();
+        auto out = job->work(job->token);
+        if (!job->token.isCancelled())
+        {
+            return out;
+        }
+        lock.lock();
+        ++state.stats.timeouts;
+        return std::nullopt;
+    }
+
+    state.queue.push_back(job);
+    startWorkers(mState);
+    state.wake.notify_all();
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(deadlineMs);
+    if (state.jobDone.wait_until(lock, deadline, [&job]() { return job->finished; }) && !job->late)
+    {
+        return std::move(job->output);
+    }
+
+    ++state.stats.timeouts;
+    job->abandoned = true;
+    auto queued = std::find(state.queue.begin(), state.queue.end(), job);
+    if (queued != state.queue.end())
+    {
+        state.queue.erase(queued); // never started: drop it rather than run it late
+    }
+    else if (!job->finished)
+    {
+        job->token.cancel();
+        ++state.stats.cancelled;
+        // Its worker is held until the work returns; other keys get a replacement
+        startWorkers(mState);
+    }
+    return std::nullopt;
+}
+
+std::optional<std::string> Watchdog::abandoned(const std::string& key) const
+{
+    std::lock_guard<std::mutex> lock(mState->mutex);
+    for (const auto& job : mState->running)
+    {
+        if (job->abandoned && job->key == key)
+        {
+            mState->flagOverdue(*job, mState->now());
+            return job->name;
+        }
+    }
+    return std::nullopt;
+}
+
+Watchdog::Stats Watchdog::stats() const
+{
+    std::lock_guard<std::mutex> lock(mState->mutex);
+    mState->flagAllOverdue();
+    Stats s = mState->stats;
+    s.running = mState->running.size();
+    return s;
+}
+
+std::vector<std::string> Watchdog::unresponsive() const
+{
+    std::lock_guard<std::mutex> lock(mState->mutex);
+    mState->flagAllOverdue();
+    return mState->unresponsive;
+}
+
+/******************** Private methods *******************/
+
+void Watchdog::startWorkers(const std::shared_ptr<State>& state)
+{
+    // Started workers count as idle until they take a job
+    while (state->idle < state->runnableKeys() && state->responsiveWorkers() < state->maxWorkers)
+    {
+        ++state->workers;
+        ++state->idle;
+        std::thread([state]() { runWorker(state); }).detach();
+    }
+}
+
+void Watchdog::runWorker(const std::shared_ptr<State>& shared)
+{
+    State& state = *shared;
+    tWorkerOf = &state;
+    std::unique_lock<std::mutex> lock(state.mutex);
+    for (;;)
+    {
+        // Sleeps until work for a free key arrives; overdue work is noticed by the waiting caller
+        state.wake.wait(lock, [&state]() { return state.stopping || state.nextRunnable() != state.queue.end(); });
+        if (state.stopping)
+        {
+            --state.idle;
+            break;
+        }
+        --state.idle;
+        auto next = state.nextRunnable();
+        auto job = *next;
+        state.queue.erase(next);
+        state.running.push_back(job);
+        lock.unlock();
+
+        auto out = job->work(job->token);
+
+        lock.lock();
+        job->work = nullptr;
+        job->output = std::move(out);
+        job->late = job->token.isCancelled(); // stopped by (or after) its deadline
+        job->finished = true;
+        state.flagOverdue(*job, state.now());
+        state.running.erase(std::find(state.running.begin(), state.running.end(), job));
+        state.jobDone.notify_all();
+        state.wake.notify_all(); // work queued behind this key may run now
+        if (job->abandoned && state.workers > state.maxWorkers)
+        {
+            break; // a replacement took over while this one was held
+        }
+        ++state.idle;
+    }
+    --state.workers;
+    state.jobDone.notify_all();
+}
+
+uint64_t Watchdog::State::now() const
+{
+    return clock ? clock() : CancellationToken::steadyMicros();
+}
+
+bool Watchdog::State::keyBusy(const std::string& key) const
+{
+    return std::any_of(running.begin(), running.end(), [&key](const std::shared_ptr<Job>& job) { return job->key == key; });
+}
+
+std::deque<std::shared_ptr<Watchdog::Job>>::iterator Watchdog::State::nextRunnable()
+{
+    return std::find_if(queue.begin(), queue.end(), [this](const std::shared_ptr<Job>& job) { return !keyBusy(job->key); });
+}
+
+size_t Watchdog::State::runnableKeys() const
+{
+    std::vector<const std::string*> keys;
+    for (const auto& job : queue)
+    {
+        if (!keyBusy(job->key)
+            && std::none_of(keys.begin(), keys.end(), [&job](const std::string* k) { return *k == job->key; }))
+        {
+            keys.push_back(&job->key);
+        }
+    }
+    return keys.size();
+}
+
+size_t Watchdog::State::responsiveWorkers() const
+{
+    const auto held = static_cast<size_t>(std::count_if(running.begin(), running.end(),
+        [](const std::shared_ptr<Job>& job) { return job->abandoned; }));
+    return workers - held;
+}
+
+void Watchdog::State::flagOverdue(Job& job, uint64_t nowUs)
+{
+    if (job.flagged || nowUs < job.token.deadlineUs() + static_cast<uint64_t>(graceMs) * 1000u)
+    {
+        return;
+    }
+    job.flagged = true;
+    ++stats.unresponsive;
+    unresponsive.push_back(job.name);
+    if (unresponsive.size() > kMaxUnresponsiveNames)
+    {
+        unresponsive.erase(unresponsive.begin());
+    }
+}
+
+void Watchdog::State::flagAllOverdue()
+{
+    const uint64_t nowUs = now();
+    for (const auto& job : running)
+    {
+        flagOverdue(*job, nowUs);
+    }
+}
+
+#else // !COMMANDSHELL_THREADS
+
+Watchdog::Watchdog(uint32_t graceMs, size_t)
+    : mGraceMs(graceMs) {}
+
+Watchdog::~Watchdog() = default;
+
+void Watchdog::setClock(std::function<uint64_t()> nowUs)
+{
+    mClock = std::move(nowUs);
+}
+
+std::optional<std::string> Watchdog::run(const std::string&, const std::string& name, uint32_t deadlineMs,
+                                         std::function<std::string(const CancellationToken&)> work)
+{
+    auto token = CancellationToken::withDeadline(deadlineMs, mClock);
+    ++mStats.started;
+    auto out = work(token);
+    if (token.isCancelled())
+    {
+        // Cannot preempt inline work; report the overrun instead
+        ++mStats.timeouts;
+        mUnresponsive.push_back(name);
+        if (mUnresponsive.size() > kMaxUnresponsiveNames)
+        {
+            mUnresponsive.erase(mUnresponsive.begin());
+        }
+    }
+    return out;
+}
+
+std::optional<std::string> Watchdog::abandoned(const std::string&) const
+{
+    return std::nullopt;
+}
+
+Watchdog::Stats Watchdog::stats() const
+{
+    return mStats;
+}
+
+std::vector<std::string> Watchdog::unresponsive() const
+{
+    return mUnresponsive;
+}
+
+#endif // COMMANDSHELL_THREADS
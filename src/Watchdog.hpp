@@ -0,0 +1,127 @@
+#ifndef WATCHDOG_HPP
+#define WATCHDOG_HPP
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#include "Cancellation.hpp"
+#include "CommandShellConfig.hpp"
+
+#if COMMANDSHELL_THREADS
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace commandshell
+{
+    /* Runs deadline-bound work and polices it
+    *  run() hands the work to a small pool of long-lived worker threads and
+    *  waits at most until the deadline, so the caller always gets a prompt
+    *  answer. Work for one key never overlaps; work for different keys runs on
+    *  up to maxWorkers threads at once. Work that misses its deadline has its
+    *  token cancelled and is abandoned; it keeps its worker until it returns
+    *  (a replacement worker is started), work queued behind it on the same key
+    *  waits (and times out rather than running late), and abandoned(key) lets
+    *  the caller refuse new work on that key meanwhile. Work still running
+    *  graceMs after its deadline is flagged unresponsive. Deadlines follow the
+    *  clock given to setClock(); waiting for the answer always takes real time.
+    *  Without threads the work runs inline and overruns are only counted.
+    */
+    class Watchdog
+    {
+    public:
+        struct Stats
+        {
+            uint64_t started = 0;
+            uint64_t timeouts = 0;     // caller answered with a timeout
+            uint64_t cancelled = 0;    // running work whose token was cancelled
+            uint64_t unresponsive = 0; // still running graceMs after its deadline
+            size_t running = 0;
+        };
+
+        explicit Watchdog(uint32_t graceMs = 100, size_t maxWorkers = 4);
+        // Waits up to graceMs for running work, then leaves it to finish on its own
+        ~Watchdog();
+
+        Watchdog(const Watchdog&) = delete;
+        Watchdog& operator=(const Watchdog&) = delete;
+
+        // Output of work, or nullopt if it missed the deadline. key groups work
+        // that must not overlap (the component), name is used in reports.
+        std::optional<std::string> run(const std::string& key, const std::string& name, uint32_t deadlineMs,
+                                       std::function<std::string(const CancellationToken&)> work);
+
+        // Clock (microseconds) for deadlines and the grace period; empty restores
+        // the steady clock. Called from worker threads, so it must be thread-safe.
+        void setClock(std::function<uint64_t()> nowUs);
+
+        // Name of abandoned work for key that is still running, if any
+        std::optional<std::string> abandoned(const std::string& key) const;
+
+        Stats stats() const;
+
+        // Names of work that ignored cancellation (most recent last, bounded)
+        std::vector<std::string> unresponsive() const;
+
+    private:
+        static constexpr size_t kMaxUnresponsiveNames = 16;
+
+#if COMMANDSHELL_THREADS
+        struct Job
+        {
+            std::string key;
+            std::string name;
+            CancellationToken token;
+            std::function<std::string(const CancellationToken&)> work;
+            std::string output;
+            bool finished = false;
+            bool late = false;
+            bool abandoned = false; // the caller stopped waiting
+            bool flagged = false;
+        };
+
+        // Shared with the workers, which may outlive the Watchdog (see destructor)
+        struct State
+        {
+            std::mutex mutex;
+            std::condition_variable wake;    // job queued, key freed or stopping
+            std::condition_variable jobDone; // job finished or worker exited
+            std::deque<std::shared_ptr<Job>> queue;
+            std::vector<std::shared_ptr<Job>> running;
+            std::function<uint64_t()> clock;
+            size_t maxWorkers = 0;
+            size_t workers = 0;
+            size_t idle = 0; // workers waiting for a job, or starting up
+            bool stopping = false;
+            uint32_t graceMs = 0;
+            Stats stats;
+            std::vector<std::string> unresponsive;
+
+            // All caller holds mutex
+            uint64_t now() const;
+            bool keyBusy(const std::string& key) const;
+            std::deque<std::shared_ptr<Job>>::iterator nextRunnable();
+            size_t runnableKeys() const;      // distinct free keys with queued work
+            size_t responsiveWorkers() const; // workers not held by abandoned work
+            void flagOverdue(Job& job, uint64_t nowUs);
+            void flagAllOverdue();
+        };
+
+        static void startWorkers(const std::shared_ptr<State>& state); // caller holds mutex
+        static void runWorker(const std::shared_ptr<State>& state);
+
+        std::shared_ptr<State> mState;
+#else
+        std::function<uint64_t()> mClock;
+        uint32_t mGraceMs;
+        Stats mStats;
+        std::vector<std::string> mUnresponsive;
+#endif
+    };
+} // namespace commandshell
+#endif // WATCHDOG_HPP
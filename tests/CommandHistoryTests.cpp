@@ -0,0 +1,93 @@
+// Unit tests for CommandHistory (ring arena and entry table)
+#include "../src/CommandHistory.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+
+using commandshell::CommandHistory;
+
+TEST(CommandHistoryTests, NewestFirstAndRepeatsMoveToNewest)
+{
+    CommandHistory history(64, 8);
+    history.push("led on");
+    history.push("led on");
+    history.push("led off");
+    history.push("led on");
+
+    ASSERT_EQ(history.size(), 2u);
+    EXPECT_EQ(history.at(0), "led on");
+    EXPECT_EQ(history.at(1), "led off");
+    EXPECT_EQ(history.at(2), "");
+}
+
+TEST(CommandHistoryTests, RepeatedLineCostsNoArenaBytes)
+{
+    // Exactly four 4-byte lines fit; a copy of "aaaa" would evict "bbbb"
+    CommandHistory history(16, 8);
+    history.push("aaaa");
+    history.push("bbbb");
+    history.push("cccc");
+    history.push("aaaa");
+    history.push("dddd");
+    ASSERT_EQ(history.size(), 4u);
+    EXPECT_EQ(history.at(0), "dddd");
+    EXPECT_EQ(history.at(1), "aaaa");
+    EXPECT_EQ(history.at(2), "cccc");
+    EXPECT_EQ(history.at(3), "bbbb");
+
+    // "aaaa" holds the oldest bytes: it slides over the evicted "bbbb" and stays
+    history.push("eeee");
+    ASSERT_EQ(history.size(), 4u);
+    EXPECT_EQ(history.at(0), "eeee");
+    EXPECT_EQ(history.at(1), "dddd");
+    EXPECT_EQ(history.at(2), "aaaa");
+    EXPECT_EQ(history.at(3), "cccc");
+    EXPECT_EQ(history.searchOlder("aaaa"), std::optional<size_t>(2));
+}
+
+TEST(CommandHistoryTests, EvictsOldestWhenArenaOrTableIsFull)
+{
+    CommandHistory bytes(16, 8);
+    bytes.push("aaaaaa");
+    bytes.push("bbbbbb");
+    bytes.push("cccccc"); // wraps to offset 0, over "aaaaaa"
+    ASSERT_EQ(bytes.size(), 2u);
+    EXPECT_EQ(bytes.at(0), "cccccc");
+    EXPECT_EQ(bytes.at(1), "bbbbbb");
+    bytes.push("dd"); // no gap after "cccccc": evicts "bbbbbb"
+    ASSERT_EQ(bytes.size(), 2u);
+    bytes.push("eeeee"); // follows "dd" without evicting
+    ASSERT_EQ(bytes.size(), 3u);
+    EXPECT_EQ(bytes.at(0), "eeeee");
+    EXPECT_EQ(bytes.at(1), "dd");
+    EXPECT_EQ(bytes.at(2), "cccccc");
+
+    CommandHistory entries(1024, 2);
+    entries.push("one");
+    entries.push("two");
+    entries.push("three");
+    ASSERT_EQ(entries.size(), 2u);
+    EXPECT_EQ(entries.at(1), "two");
+
+    // Lines larger than the arena are not stored
+    entries.push(std::string(2000, 'x'));
+    EXPECT_EQ(entries.at(0), "three");
+}
+
+TEST(CommandHistoryTests, SearchOlderFindsSuccessiveMatches)
+{
+    CommandHistory history(4096, 4096);
+    for (int i = 0; i < 3000; ++i) {
+        history.push("sys echo " + std::to_string(i));
+    }
+    history.push("led blink 100 200");
+
+    auto first = history.searchOlder("echo 29");
+    ASSERT_TRUE(first.has_value());
+    EXPECT_EQ(history.at(*first).substr(0, 9), "sys echo ");
+    auto next = history.searchOlder("echo 29", *first + 1);
+    ASSERT_TRUE(next.has_value());
+    EXPECT_GT(*next, *first);
+    EXPECT_FALSE(history.searchOlder("nothing").has_value());
+    EXPECT_EQ(history.memoryFootprint(), 4096u + 4096u * (16u + 4u));
+}
@@ -0,0 +1,282 @@
+// Unit tests for MpscQueue and CommandQueue
+#include "../src/CommandQueue.hpp"
+#include "../src/CommandShell.hpp"
+#include "../src/MpscQueue.hpp"
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using commandshell::Command;
+using commandshell::CommandDetails;
+using commandshell::CommandQueue;
+using commandshell::CommandShell;
+using commandshell::ComponentCommands;
+using commandshell::MpscQueue;
+
+namespace {
+    Command makeEcho(const std::string& text)
+    {
+        Command c;
+        c.component = "sys";
+        c.command = "echo";
+        c.arguments = {text};
+        return c;
+    }
+
+    void registerEcho(CommandShell& shell)
+    {
+        ComponentCommands sys{"sys", "System commands"};
+        sys.addCommand(CommandDetails{
+            "echo", "Echo first argument",
+            [](const std::vector<std::string>& args, const std::vector<std::string>&) -> std::string {
+                return (args.empty() ? std::string{} : args[0]) + "\n";
+            }
+        });
+        shell.registerComponent(sys);
+    }
+}
+
+TEST(MpscQueueTests, RoundsCapacityAndRejectsWhenFull)
+{
+    MpscQueue<int> q(3);
+    EXPECT_EQ(q.capacity(), 4u);
+    for (int i = 0; i < 4; ++i) EXPECT_TRUE(q.tryPush(int{i}));
+    EXPECT_FALSE(q.tryPush(99));
+
+    int v = -1;
+    ASSERT_TRUE(q.tryPop(v));
+    EXPECT_EQ(v, 0);
+    EXPECT_TRUE(q.tryPush(4)); // the freed cell is reused
+    for (int expected = 1; expected <= 4; ++expected)
+    {
+        ASSERT_TRUE(q.tryPop(v));
+        EXPECT_EQ(v, expected);
+    }
+    EXPECT_FALSE(q.tryPop(v));
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(MpscQueueTests, ConcurrentProducersDeliverEveryItemInProducerOrder)
+{
+    constexpr int kProducers = 4;
+    constexpr int kPerProducer = 5000;
+    MpscQueue<int> q(64);
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p)
+    {
+        producers.emplace_back([&q, p]() {
+            for (int i = 0; i < kPerProducer; ++i)
+            {
+                while (!q.tryPush(p * kPerProducer + i)) std::this_thread::yield();
+            }
+        });
+    }
+
+    std::vector<int> next(kProducers, 0);
+    int received = 0;
+    while (received < kProducers * kPerProducer)
+    {
+        int v = 0;
+        if (!q.tryPop(v))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        const int p = v / kPerProducer;
+        ASSERT_EQ(v % kPerProducer, next[p]) << "out of order for producer " << p;
+        ++next[p];
+        ++received;
+    }
+    for (auto& t : producers) t.join();
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(CommandQueueTests, DrainRoutesRepliesToSubmittingProducer)
+{
+    CommandShell shell;
+    registerEcho(shell);
+    CommandQueue queue(shell, 8);
+
+    std::string uart, net;
+    auto uartId = queue.addProducer([&uart](const std::string& r) { uart += r; });
+    auto netId = queue.addProducer([&net](const std::string& r) { net += r; });
+
+    EXPECT_TRUE(queue.submit(uartId, makeEcho("a")));
+    EXPECT_TRUE(queue.submit(netId, makeEcho("b")));
+    EXPECT_TRUE(queue.submit(uartId, makeEcho("c")));
+    EXPECT_FALSE(queue.submit(7, makeEcho("x"))); // unknown producer
+
+    EXPECT_EQ(queue.drain(2), 2u);
+    EXPECT_EQ(uart, "a\n");
+    EXPECT_EQ(net, "b\n");
+    EXPECT_EQ(queue.drain(), 1u);
+    EXPECT_EQ(uart, "a\nc\n");
+
+    const auto stats = queue.stats();
+    EXPECT_EQ(stats.submitted, 3u);
+    EXPECT_EQ(stats.rejected, 1u);
+    EXPECT_EQ(stats.executed, 3u);
+}
+
+TEST(CommandQueueTests, ExecutorThreadServesConcurrentProducers)
+{
+    CommandShell shell;
+    registerEcho(shell);
+    CommandQueue queue(shell, 16);
+
+    constexpr int kProducers = 3;
+    constexpr int kPerProducer = 200;
+    std::vector<std::atomic<int>> replies(kProducers);
+    std::vector<CommandQueue::ProducerId> ids;
+    for (int p = 0; p < kProducers; ++p)
+    {
+        ids.push_back(queue.addProducer([&replies, p](const std::string& r) {
+            if (r == std::to_string(p) + "\n") replies[p].fetch_add(1);
+        }));
+    }
+    queue.start();
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p)
+    {
+        producers.emplace_back([&queue, &ids, p]() {
+            for (int i = 0; i < kPerProducer; ++i)
+            {
+                while (!queue.submit(ids[p], makeEcho(std::to_string(p)))) std::this_thread::yield();
+            }
+        });
+    }
+    for (auto& t : producers) t.join();
+    queue.stop();
+
+    for (int p = 0; p < kProducers; ++p) EXPECT_EQ(replies[p].load(), kPerProducer);
+    EXPECT_EQ(queue.stats().executed, static_cast<uint64_t>(kProducers * kPerProducer));
+}
+
+TEST(CommandQueueTests, HighPriorityCommandsBypassQueuedBulkWork)
+{
+    CommandShell shell;
+    registerEcho(shell);
+    ComponentCommands led{"led", "LED"};
+    CommandDetails off{
+        "off", "Turn off",
+        [](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string { return "off\n"; }
+    };
+    off.priority = commandshell::CommandPriority::High;
+    led.addCommand(off);
+    shell.registerComponent(led);
+
+    CommandQueue queue(shell, 16);
+    std::vector<std::string> order;
+    auto sink = [&order](const std::string& r) { order.push_back(r); };
+    auto config = queue.addProducer(sink, commandshell::CommandPriority::Low);
+    auto console = queue.addProducer(sink);
+
+    for (int i = 0; i < 4; ++i) ASSERT_TRUE(queue.submit(config, makeEcho("cfg" + std::to_string(i))));
+    ASSERT_TRUE(queue.submit(console, makeEcho("status")));
+    Command stop;
+    stop.component = "led";
+    stop.command = "off";
+    ASSERT_TRUE(queue.submit(config, stop)); // a declared command lane wins over the producer's
+
+    EXPECT_EQ(queue.drain(), 6u);
+    std::vector<std::string> expected{"off\n", "status\n", "cfg0\n", "cfg1\n", "cfg2\n", "cfg3\n"};
+    EXPECT_EQ(order, expected);
+
+    EXPECT_EQ(queue.laneLatency(commandshell::CommandPriority::High).count(), 1u);
+    EXPECT_EQ(queue.laneLatency(commandshell::CommandPriority::Normal).count(), 1u);
+    EXPECT_EQ(queue.laneLatency(commandshell::CommandPriority::Low).count(), 4u);
+}
+
+TEST(CommandQueueTests, DeclaredLaneIsLookedUpByTheConsumer)
+{
+    CommandShell shell;
+    registerEcho(shell);
+    CommandQueue queue(shell, 16);
+    std::vector<std::string> order;
+    auto sink = [&order](const std::string& r) { order.push_back(r); };
+    auto config = queue.addProducer(sink, commandshell::CommandPriority::Low);
+
+    // Submitted before its component exists: submit() never consults the registry
+    Command stop;
+    stop.component = "led";
+    stop.command = "off";
+    ASSERT_TRUE(queue.submit(config, makeEcho("cfg")));
+    ASSERT_TRUE(queue.submit(config, stop));
+    ASSERT_TRUE(queue.submit(config, stop, commandshell::CommandPriority::Low)); // caller's lane is kept
+
+    ComponentCommands led{"led", "LED"};
+    CommandDetails off{
+        "off", "Turn off",
+        [](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string { return "off\n"; }
+    };
+    off.priority = commandshell::CommandPriority::High;
+    led.addCommand(off);
+    shell.registerComponent(led);
+
+    EXPECT_EQ(queue.drain(), 3u);
+    EXPECT_EQ(order, (std::vector<std::string>{"off\n", "cfg\n", "off\n"}));
+}
+
+TEST(CommandQueueTests, StarvationLimitLetsLowLaneThrough)
+{
+    CommandShell shell;
+    registerEcho(shell);
+    CommandQueue queue(shell, 16);
+    queue.setStarvationLimit(2);
+    std::vector<std::string> order;
+    auto sink = [&order](const std::string& r) { order.push_back(r); };
+    auto bulk = queue.addProducer(sink, commandshell::CommandPriority::Low);
+    auto urgent = queue.addProducer(sink, commandshell::CommandPriority::High);
+
+    ASSERT_TRUE(queue.submit(bulk, makeEcho("low")));
+    for (int i = 0; i < 4; ++i) ASSERT_TRUE(queue.submit(urgent, makeEcho("high" + std::to_string(i))));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    EXPECT_EQ(queue.drain(), 5u);
+    std::vector<std::string> expected{"high0\n", "high1\n", "low\n", "high2\n", "high3\n"};
+    EXPECT_EQ(order, expected);
+    EXPECT_GE(queue.laneLatency(commandshell::CommandPriority::Low).max(), 2000u);
+}
+
+TEST(CommandQueueTests, PreResolvedLaneSkipsLookup)
+{
+    CommandShell shell;
+    registerEcho(shell);
+    CommandQueue queue(shell, 16);
+    std::vector<std::string> order;
+    auto sink = [&order](const std::string& r) { order.push_back(r); };
+    auto producer = queue.addProducer(sink, commandshell::CommandPriority::Low);
+
+    const auto lane = queue.laneFor(producer, makeEcho("x"));
+    EXPECT_EQ(lane, commandshell::CommandPriority::Low);
+    ASSERT_TRUE(queue.submit(producer, makeEcho("bulk"), lane));
+    ASSERT_TRUE(queue.submit(producer, makeEcho("urgent"), commandshell::CommandPriority::High));
+    EXPECT_FALSE(queue.submit(producer, makeEcho("bad"), static_cast<commandshell::CommandPriority>(7)));
+
+    EXPECT_EQ(queue.drain(), 2u);
+    EXPECT_EQ(order, (std::vector<std::string>{"urgent\n", "bulk\n"}));
+}
+
+TEST(CommandQueueTests, LatencyHistogramIsBoundedAndApproximate)
+{
+    commandshell::LatencyHistogram histogram;
+    for (uint64_t us = 1; us <= 100000; ++us) histogram.add(us);
+    EXPECT_EQ(histogram.count(), 100000u);
+    EXPECT_EQ(histogram.max(), 100000u);
+    EXPECT_DOUBLE_EQ(histogram.mean(), 50000.5);
+    EXPECT_EQ(histogram.percentile(0.001), 1u); // exact below 16
+    for (double p : {50.0, 99.0, 99.9})
+    {
+        const double exact = p * 1000.0;
+        EXPECT_GE(static_cast<double>(histogram.percentile(p)), exact);
+        EXPECT_LE(static_cast<double>(histogram.percentile(p)), exact * 1.125);
+    }
+    EXPECT_EQ(histogram.percentile(100), 100000u);
+    EXPECT_LT(sizeof(histogram), 4096u);
+}
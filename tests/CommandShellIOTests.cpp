@@ -11,6 +11,8 @@
 #include <sstream>
 #include <vector>
 #include <cstring>
+#include <chrono>
+#include <thread>
 
 using commandshell::CommandShell;
 using commandshell::CommandShellIO;
@@ -255,3 +257,313 @@ TEST_F(CommandShellIOTest, PrintPrompt_IgnoresEchoSetting) {
         EXPECT_EQ(captured[1], std::string("B> "));
     }
 }
+
+TEST_F(CommandShellIOTest, UpArrowRecallsPreviousLine) {
+    ASSERT_NE(shell, nullptr);
+    ComponentCommands sys{"sys", "System commands"};
+    sys.addCommand(CommandDetails{"id", "Print id", [](const std::vector<std::string>& args, const std::vector<std::string>&) {
+        return std::string("id:") + (args.empty() ? "" : args[0]) + "\n";
+    }});
+    shell->registerComponent(sys);
+
+    CommandShellIO io(*shell, /*echoInput=*/false);
+    io.setOutputCallback([this](const std::string& s) { appendCapture(s); });
+
+    std::string l1 = "sys id 1\n";
+    std::string l2 = "sys id 2\n";
+    io.input(l1);
+    io.input(l2);
+    ASSERT_EQ(io.history().size(), 2u);
+
+    captured.clear();
+    std::string up2 = "\x1b[A\x1b[A";
+    std::string enter = "\r";
+    io.input(up2);
+    io.input(enter);
+    ASSERT_GE(captured.size(), 1u);
+    EXPECT_EQ(captured[0], "id:1\n");
+}
+
+TEST_F(CommandShellIOTest, CtrlRSearchesHistoryIncrementally) {
+    ASSERT_NE(shell, nullptr);
+    ComponentCommands sys{"sys", "System commands"};
+    sys.addCommand(CommandDetails{"id", "Print id", [](const std::vector<std::string>& args, const std::vector<std::string>&) {
+        return std::string("id:") + (args.empty() ? "" : args[0]) + "\n";
+    }});
+    shell->registerComponent(sys);
+
+    CommandShellIO io(*shell, /*echoInput=*/true);
+    io.setOutputCallback([this](const std::string& s) { appendCapture(s); });
+    io.setHistoryLimits(256, 16);
+
+    std::string a = "sys id alpha\n";
+    std::string b = "sys id beta\n";
+    io.input(a);
+    io.input(b);
+
+    captured.clear();
+    std::string search = "\x12" "al";
+    io.input(search);
+    EXPECT_NE(joined().find("(reverse-i-search)`al': sys id alpha"), std::string::npos);
+
+    captured.clear();
+    std::string enter = "\n";
+    io.input(enter);
+    EXPECT_NE(joined().find("id:alpha\n"), std::string::npos);
+    EXPECT_EQ(io.history().at(0), "sys id alpha");
+}
+
+namespace {
+    ComponentCommands makeIdComponent(const std::string& name)
+    {
+        ComponentCommands comp{name, "Id commands"};
+        comp.addCommand(CommandDetails{"id", "Print id", [name](const std::vector<std::string>& args, const std::vector<std::string>&) {
+            return name + ":" + (args.empty() ? "" : args[0]) + "\n";
+        }});
+        return comp;
+    }
+}
+
+TEST_F(CommandShellIOTest, AdmissionRejectsOverRateAndRecovers) {
+    ASSERT_NE(shell, nullptr);
+    uint64_t now = 0;
+    shell->setClock([&now]() { return now; });
+    shell->registerComponent(makeIdComponent("sys"));
+
+    commandshell::AdmissionPolicy policy;
+    policy.ratePerSecond = 1;
+    policy.burst = 2;
+    policy.overflow = commandshell::AdmissionPolicy::Overflow::Reject;
+    shell->setAdmissionPolicy(policy);
+
+    CommandShellIO io(*shell, /*echoInput=*/false);
+    io.setOutputCallback([this](const std::string& s) { appendCapture(s); });
+
+    for (int i = 0; i < 3; ++i) {
+        std::string line = "sys id " + std::to_string(i) + "\n";
+        io.input(line);
+    }
+    EXPECT_NE(joined().find("sys:1\n"), std::string::npos);
+    EXPECT_NE(joined().find("Error: rate limit exceeded\n"), std::string::npos);
+    EXPECT_EQ(io.admissionStats().admitted, 2u);
+    EXPECT_EQ(io.admissionStats().rejected, 1u);
+
+    now += 1000000; // one token refilled
+    std::string again = "sys id 3\n";
+    io.input(again);
+    EXPECT_NE(joined().find("sys:3\n"), std::string::npos);
+}
+
+TEST_F(CommandShellIOTest, AdmissionQueuesAndDrainsFromPoll) {
+    ASSERT_NE(shell, nullptr);
+    uint64_t now = 0;
+    shell->setClock([&now]() { return now; });
+    shell->registerComponent(makeIdComponent("sys"));
+    shell->registerComponent(makeIdComponent("led"));
+
+    commandshell::AdmissionPolicy queued;
+    queued.ratePerSecond = 10;
+    queued.burst = 1;
+    queued.maxQueued = 1;
+    queued.overflow = commandshell::AdmissionPolicy::Overflow::Queue;
+    shell->setAdmissionPolicy("sys", queued);
+
+    CommandShellIO io(*shell, /*echoInput=*/false);
+    io.setOutputCallback([this](const std::string& s) { appendCapture(s); });
+
+    std::string l1 = "sys id a\n", l2 = "sys id b\n", l3 = "sys id c\n", l4 = "led id x\n";
+    io.input(l1);
+    io.input(l2); // parked
+    io.input(l3); // queue full
+    io.input(l4); // other component is unlimited
+    EXPECT_EQ(io.pendingLines(), 1u);
+    EXPECT_NE(joined().find("Error: command queue full\n"), std::string::npos);
+    EXPECT_NE(joined().find("led:x\n"), std::string::npos);
+    EXPECT_EQ(joined().find("sys:b\n"), std::string::npos);
+
+    io.poll(); // no token yet
+    EXPECT_EQ(io.pendingLines(), 1u);
+    now += 100000;
+    io.poll();
+    EXPECT_EQ(io.pendingLines(), 0u);
+    EXPECT_NE(joined().find("sys:b\n"), std::string::npos);
+    EXPECT_EQ(io.admissionStats().queued, 1u);
+}
+
+TEST_F(CommandShellIOTest, AdmissionDropsWhenInFlightCapReached) {
+    ASSERT_NE(shell, nullptr);
+    shell->registerComponent(makeIdComponent("sys"));
+
+    commandshell::AdmissionPolicy drop;
+    drop.maxInFlight = 1;
+    drop.overflow = commandshell::AdmissionPolicy::Overflow::Drop;
+    shell->setAdmissionPolicy(drop);
+
+    // A handler that feeds input back re-enters the session while in flight
+    CommandShellIO* ioPtr = nullptr;
+    ComponentCommands nested{"nested", "Re-entrant input"};
+    nested.addCommand(CommandDetails{"run", "Feed a line back", [&ioPtr](const std::vector<std::string>&, const std::vector<std::string>&) {
+        std::string line = "sys id inner\n";
+        ioPtr->input(line);
+        return std::string("outer\n");
+    }});
+    shell->registerComponent(nested);
+
+    CommandShellIO io(*shell, /*echoInput=*/false);
+    ioPtr = &io;
+    io.setOutputCallback([this](const std::string& s) { appendCapture(s); });
+    std::string line = "nested run\n";
+    io.input(line);
+
+    EXPECT_EQ(joined().find("sys:inner"), std::string::npos);
+    EXPECT_EQ(io.admissionStats().dropped, 1u);
+}
+
+TEST_F(CommandShellIOTest, AdmissionInFlightCapIgnoresParkedLines) {
+    ASSERT_NE(shell, nullptr);
+    uint64_t now = 0;
+    shell->setClock([&now]() { return now; });
+    shell->registerComponent(makeIdComponent("sys"));
+    shell->registerComponent(makeIdComponent("led"));
+
+    commandshell::AdmissionPolicy queued;
+    queued.ratePerSecond = 1;
+    queued.burst = 1;
+    queued.overflow = commandshell::AdmissionPolicy::Overflow::Queue;
+    shell->setAdmissionPolicy("sys", queued);
+    commandshell::AdmissionPolicy single;
+    single.maxInFlight = 1;
+    shell->setAdmissionPolicy("led", single);
+
+    CommandShellIO io(*shell, /*echoInput=*/false);
+    io.setOutputCallback([this](const std::string& s) { appendCapture(s); });
+
+    std::string l1 = "sys id a\n", l2 = "sys id b\n", l3 = "led id x\n";
+    io.input(l1);
+    io.input(l2); // parked, waiting for a token
+    ASSERT_EQ(io.pendingLines(), 1u);
+    // Nothing is executing, so a parked line does not use up led's single slot
+    io.input(l3);
+    EXPECT_NE(joined().find("led:x\n"), std::string::npos);
+    EXPECT_EQ(joined().find("too many commands in flight"), std::string::npos);
+}
+
+namespace {
+    // Resumable "sweep N": one output line per step, each step costs 300us of simulated time
+    ComponentCommands makeSweepComponent(uint64_t& now)
+    {
+        ComponentCommands sweep{"sweep", "Long running sweeps"};
+        CommandDetails run{"run", "Sweep N points", nullptr};
+        run.resumable = [&now](const std::vector<std::string>& args, const std::vector<std::string>&) -> commandshell::CommandStep {
+            int total = args.empty() ? 3 : std::stoi(args[0]);
+            int i = 0;
+            return [&now, total, i](std::string& out) mutable {
+                now += 300;
+                out += "point " + std::to_string(i++) + "\n";
+                return i >= total;
+            };
+        };
+        sweep.addCommand(run);
+        return sweep;
+    }
+}
+
+TEST_F(CommandShellIOTest, ResumableCommandIsTimeSlicedByPoll) {
+    ASSERT_NE(shell, nullptr);
+    uint64_t now = 0;
+    shell->setClock([&now]() { return now; });
+    shell->registerComponent(makeSweepComponent(now));
+
+    CommandShellIO io(*shell, /*echoInput=*/false);
+    io.setOutputCallback([this](const std::string& s) { appendCapture(s); });
+
+    std::string line = "sweep run 10\n";
+    io.input(line);
+    EXPECT_TRUE(io.isBusy());
+    EXPECT_EQ(joined(), prompt); // nothing ran inside input()
+
+    // Lines typed while busy run after the sweep finishes
+    std::string help = "help\n";
+    io.input(help);
+
+    captured.clear();
+    io.poll(1000); // steps at t=0,300,600,900 fit in the budget
+    EXPECT_EQ(joined(), "point 0\npoint 1\npoint 2\npoint 3\n");
+
+    captured.clear();
+    io.poll(); // exactly one step
+    EXPECT_EQ(joined(), "point 4\n");
+
+    io.poll(100000);
+    EXPECT_FALSE(io.isBusy());
+    EXPECT_NE(joined().find("point 9\ncmd> "), std::string::npos);
+    EXPECT_NE(joined().find("Available components:"), std::string::npos);
+}
+
+TEST_F(CommandShellIOTest, ResumableCommandRunsToCompletionWhenExecutedDirectly) {
+    ASSERT_NE(shell, nullptr);
+    uint64_t now = 0;
+    shell->registerComponent(makeSweepComponent(now));
+
+    Command cmd;
+    cmd.component = "sweep";
+    cmd.command = "run";
+    cmd.arguments = {"2"};
+    EXPECT_EQ(shell->executeCommand(cmd), "point 0\npoint 1\n");
+}
+
+TEST_F(CommandShellIOTest, SessionDeadlineBoundsSlowHandlers) {
+    ASSERT_NE(shell, nullptr);
+    ComponentCommands dev{"dev", "Device"};
+    dev.addCommand(CommandDetails{
+        "slow", "Takes 200 ms",
+        [](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            return "done\n";
+        }
+    });
+    CommandDetails tight{
+        "tight", "Has its own 10 ms deadline",
+        [](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            return "done\n";
+        }
+    };
+    tight.deadlineMs = 10;
+    dev.addCommand(tight);
+    shell->registerComponent(dev);
+
+    CommandShellIO io(*shell, /*echoInput=*/false);
+    io.setOutputCallback([this](const std::string& s) { appendCapture(s); });
+    io.setCommandDeadline(50);
+
+    auto waitForLateHandler = [this]() {
+        for (int i = 0; i < 200 && shell->watchdogStats().running != 0; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    };
+
+    std::string line = "dev slow\n";
+    io.input(line);
+    EXPECT_NE(joined().find("Error: command timed out after 50 ms\n"), std::string::npos);
+
+    // The late handler still owns the component
+    captured.clear();
+    line = "dev tight\n";
+    io.input(line);
+    EXPECT_NE(joined().find("Error: 'dev slow' missed its deadline and is still running; 'dev' is unavailable until it returns\n"),
+              std::string::npos);
+    waitForLateHandler();
+
+    // The tighter of command and session deadline applies
+    captured.clear();
+    io.input(line);
+    EXPECT_NE(joined().find("Error: command timed out after 10 ms\n"), std::string::npos);
+    waitForLateHandler();
+
+    // Without deadlines the handler runs to completion
+    captured.clear();
+    io.setCommandDeadline(0);
+    line = "dev slow\n";
+    io.input(line);
+    EXPECT_NE(joined().find("done\n"), std::string::npos);
+}
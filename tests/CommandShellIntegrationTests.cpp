@@ -97,3 +97,64 @@ TEST(CommandShellIntegrationTests, EndToEndExecutesWithNoNewlineOption)
     EXPECT_EQ(cap.out[0], std::string("cmd> "));
     EXPECT_EQ(cap.out[1], std::string("hello")); // no trailing newline
 }
+
+namespace {
+    ComponentCommands makeDumpComponent(int& linesProduced)
+    {
+        ComponentCommands dump{"dump", "Bulk dumps"};
+        CommandDetails regs{"regs", "Dump registers", nullptr};
+        regs.stream = [&linesProduced](const std::vector<std::string>&, const std::vector<std::string>&,
+                                       commandshell::LineSink& out) {
+            for (int i = 0; i < 1000; ++i) {
+                ++linesProduced;
+                if (!out.writeLine("reg" + std::to_string(i) + (i % 2 ? " odd\n" : " even\n"))) return;
+            }
+        };
+        dump.addCommand(regs);
+        return dump;
+    }
+
+    std::string runLine(CommandShell& shell, const std::string& text)
+    {
+        Capture cap;
+        CommandShellIO io(shell, /*echoInput=*/false);
+        io.setOutputCallback([&cap](const std::string& s) { cap.append(s); });
+        std::string line = text + "\n";
+        io.input(line);
+        return cap.out.size() >= 2 ? cap.out[1] : std::string{};
+    }
+}
+
+TEST(CommandShellIntegrationTests, PipelineHeadStopsStreamingProducerEarly)
+{
+    CommandShell shell;
+    int produced = 0;
+    shell.registerComponent(makeDumpComponent(produced));
+
+    EXPECT_EQ(runLine(shell, "dump regs | head 2"), std::string("reg0 even\nreg1 odd\n"));
+    EXPECT_EQ(produced, 2);
+}
+
+TEST(CommandShellIntegrationTests, PipelineChainsGrepAndCount)
+{
+    CommandShell shell;
+    int produced = 0;
+    shell.registerComponent(makeDumpComponent(produced));
+
+    EXPECT_EQ(runLine(shell, "dump regs | grep odd | count"), std::string("500\n"));
+    EXPECT_EQ(runLine(shell, "dump regs | grep -v odd | head 1"), std::string("reg0 even\n"));
+    // Only a standalone `|` is a pipe; inside a token it is an ordinary character
+    EXPECT_EQ(runLine(shell, "dump regs | grep odd|even | count"), std::string("0\n"));
+    EXPECT_EQ(runLine(shell, "dump regs | head abc"), std::string("Error: head count must be a number: 'abc'\n"));
+    EXPECT_EQ(runLine(shell, "dump regs | head -2"), std::string("reg0 even\nreg1 odd\n"));
+    EXPECT_EQ(runLine(shell, "dump regs | head -n 1"), std::string("reg0 even\n"));
+    EXPECT_EQ(runLine(shell, "dump regs | head -x 2"), std::string("Error: head: unknown option '-x'\n"));
+    EXPECT_EQ(runLine(shell, "dump regs | head --all"), std::string("Error: head: unknown option '--all'\n"));
+    EXPECT_EQ(runLine(shell, "dump regs | | count"), std::string("Error: Empty pipeline stage.\n"));
+    // Plain string handlers are split into lines too
+    EXPECT_NE(runLine(shell, "help list | grep dump").find("dump - Bulk dumps\n"), std::string::npos);
+    EXPECT_EQ(runLine(shell, "dump regs | nosuch"), std::string("Error: unknown filter 'nosuch'\n"));
+    // Without a pipe the stream is collected into a single output
+    auto all = runLine(shell, "dump regs");
+    EXPECT_EQ(all.rfind("reg999 odd\n"), all.size() - std::string("reg999 odd\n").size());
+}
@@ -1,15 +1,23 @@
 // Unit tests for CommandShell (direct execution and help rendering)
 #include "../src/CommandShell.hpp"
+#include "../src/CommandCache.hpp"
 #include "../src/CommandTypes.hpp"
+#include "../src/Cancellation.hpp"
+#include "TestHelpers.hpp"
 
 #include <gtest/gtest.h>
 #include <string>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <memory>
 
 using commandshell::CommandShell;
 using commandshell::Command;
 using commandshell::ComponentCommands;
 using commandshell::CommandDetails;
 using commandshell::OptionDetails;
+using testhelpers::makeCommand;
 
 namespace {
     ComponentCommands makeSysComponent()
@@ -138,3 +146,469 @@ TEST(CommandShellTests, PerComponentHelpAndCommandHelp)
     EXPECT_EQ(outCmd, std::string("sys echo: Echo arguments like /bin/echo\n"));
 }
 
+
+namespace {
+    // Component whose only command counts how often its handler really runs
+    ComponentCommands makeCountingComponent(int& calls, commandshell::CachePolicy policy)
+    {
+        ComponentCommands hw{"hw", "Hardware inventory"};
+        CommandDetails inventory{
+            "inventory",
+            "List hardware",
+            [&calls](const std::vector<std::string>& args, const std::vector<std::string>&) -> std::string {
+                ++calls;
+                return "inventory " + std::to_string(calls) + (args.empty() ? "" : " " + args[0]) + "\n";
+            }
+        };
+        inventory.cache = policy;
+        hw.addCommand(inventory);
+        return hw;
+    }
+}
+
+TEST(CommandShellTests, PureCommandIsMemoizedPerArgumentsAndOptions)
+{
+    CommandShell shell;
+    int calls = 0;
+    shell.registerComponent(makeCountingComponent(calls, commandshell::CachePolicy::pure()));
+
+    EXPECT_EQ(shell.executeCommand(makeCommand("hw", "inventory", {}, {"-a", "-b"})), "inventory 1\n");
+    // Option order and duplicates are normalized
+    EXPECT_EQ(shell.executeCommand(makeCommand("hw", "inventory", {}, {"-b", "-a", "-a"})), "inventory 1\n");
+    EXPECT_EQ(shell.executeCommand(makeCommand("hw", "inventory", {"x"})), "inventory 2 x\n");
+    EXPECT_EQ(calls, 2);
+
+    // Separator bytes inside arguments cannot make two calls share a key
+    EXPECT_NE(commandshell::CommandCache::makeKey(makeCommand("hw", "inventory", {"a\x1f" "b"})),
+              commandshell::CommandCache::makeKey(makeCommand("hw", "inventory", {"a", "b"})));
+    EXPECT_NE(commandshell::CommandCache::makeKey(makeCommand("hw", "inventory", {"-a"})),
+              commandshell::CommandCache::makeKey(makeCommand("hw", "inventory", {}, {"-a"})));
+
+    auto stats = shell.cacheStats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 2u);
+    EXPECT_EQ(stats.entries, 2u);
+}
+
+TEST(CommandShellTests, TtlCacheExpiresWithClock)
+{
+    CommandShell shell;
+    uint64_t now = 0;
+    shell.setClock([&now]() { return now; });
+    int calls = 0;
+    shell.registerComponent(makeCountingComponent(calls, commandshell::CachePolicy::ttl(100)));
+
+    shell.executeCommand(makeCommand("hw", "inventory"));
+    now = 99 * 1000;
+    shell.executeCommand(makeCommand("hw", "inventory"));
+    EXPECT_EQ(calls, 1);
+    now = 100 * 1000;
+    shell.executeCommand(makeCommand("hw", "inventory"));
+    EXPECT_EQ(calls, 2);
+}
+
+TEST(CommandShellTests, CacheInvalidationAndBounds)
+{
+    CommandShell shell;
+    int calls = 0;
+    shell.registerComponent(makeCountingComponent(calls, commandshell::CachePolicy::pure()));
+
+    shell.executeCommand(makeCommand("hw", "inventory"));
+    shell.invalidateCache("hw", "inventory");
+    shell.executeCommand(makeCommand("hw", "inventory"));
+    EXPECT_EQ(calls, 2);
+
+    shell.setCacheLimits(1, 1024);
+    shell.executeCommand(makeCommand("hw", "inventory", {"a"}));
+    shell.executeCommand(makeCommand("hw", "inventory", {"b"}));
+    auto stats = shell.cacheStats();
+    EXPECT_EQ(stats.entries, 1u);
+    EXPECT_GE(stats.evictions, 1u);
+
+    // Built-in stats command reflects the counters
+    auto out = shell.executeCommand(makeCommand("shell", "cache"));
+    EXPECT_NE(out.find("Cache: 1 entries"), std::string::npos);
+    EXPECT_EQ(shell.executeCommand(makeCommand("shell", "cache", {"clear"})), "Cache cleared\n");
+    EXPECT_EQ(shell.cacheStats().entries, 0u);
+}
+
+TEST(CommandShellTests, ComponentFactoryIsBuiltOnFirstUseOnly)
+{
+    CommandShell shell;
+    const size_t builtins = shell.materializedComponents();
+    int builds = 0;
+    shell.registerComponentFactory(commandshell::ComponentFactory{
+        "sys", "System commands",
+        [&builds]() { ++builds; return makeSysComponent(); }
+    });
+
+    // Listing uses only the stored name and description
+    auto list = shell.executeCommand(makeCommand("help", "list"));
+    EXPECT_NE(list.find("sys - System commands\n"), std::string::npos);
+    EXPECT_EQ(builds, 0);
+    EXPECT_EQ(shell.materializedComponents(), builtins);
+
+    EXPECT_EQ(shell.executeCommand(makeCommand("sys", "echo", {"hi"})), "hi\n");
+    EXPECT_NE(shell.executeCommand(makeCommand("help", "sys")).find("Commands:\n  echo"), std::string::npos);
+    EXPECT_EQ(builds, 1);
+    EXPECT_EQ(shell.materializedComponents(), builtins + 1);
+}
+
+TEST(CommandShellTests, BulkRegistrationReplacesAndSortsComponents)
+{
+    CommandShell shell;
+    int builds = 0;
+    std::vector<commandshell::ComponentFactory> factories;
+    for (int i = 99; i >= 0; --i) {
+        factories.push_back(commandshell::ComponentFactory{
+            "dev" + std::to_string(i), "Device " + std::to_string(i),
+            [&builds]() { ++builds; return makeSysComponent(); }
+        });
+    }
+    shell.registerComponentFactories(std::move(factories));
+
+    std::vector<ComponentCommands> eager;
+    eager.push_back(makeSysComponent());
+    ComponentCommands replaced{"dev5", "Replaced device"};
+    eager.push_back(std::move(replaced));
+    shell.registerComponents(std::move(eager));
+
+    auto list = shell.executeCommand(makeCommand("help", "list"));
+    EXPECT_NE(list.find("dev5 - Replaced device\n"), std::string::npos);
+    EXPECT_LT(list.find("dev10 -"), list.find("dev2 -"));
+    EXPECT_EQ(shell.executeCommand(makeCommand("dev7", "echo", {"x"})), "x\n");
+    EXPECT_EQ(builds, 1);
+}
+
+namespace {
+    commandshell::InstanceComponentCommands makeLedBank(std::vector<bool>& state)
+    {
+        commandshell::InstanceComponentCommands leds{"led", "Board LEDs", state.size()};
+        leds.addCommand(commandshell::InstanceCommandDetails{
+            "on", "Turn LED on",
+            [&state](size_t i, const std::vector<std::string>&, const std::vector<std::string>&) -> std::string {
+                state[i] = true;
+                return "led" + std::to_string(i) + ": ON\n";
+            }
+        });
+        return leds;
+    }
+}
+
+TEST(CommandShellTests, InstanceComponentRoutesByIndex)
+{
+    CommandShell shell;
+    std::vector<bool> state(32, false);
+    shell.registerInstanceComponent(makeLedBank(state));
+
+    EXPECT_EQ(shell.executeCommand(makeCommand("led17", "on")), "led17: ON\n");
+    EXPECT_EQ(shell.executeCommand(makeCommand("led[3]", "on")), "led3: ON\n");
+    EXPECT_TRUE(state[17]);
+    EXPECT_TRUE(state[3]);
+    EXPECT_FALSE(state[0]);
+
+    EXPECT_EQ(shell.executeCommand(makeCommand("led32", "on")), "Instance out of range for 'led' (0..31)\n");
+    EXPECT_EQ(shell.executeCommand(makeCommand("led", "on")), "Unknown component 'led'\n");
+    EXPECT_EQ(shell.executeCommand(makeCommand("led1", "off")), "Unknown command for component 'led1'\n");
+}
+
+TEST(CommandShellTests, InstanceComponentHelp)
+{
+    CommandShell shell;
+    std::vector<bool> state(4, false);
+    shell.registerInstanceComponent(makeLedBank(state));
+
+    auto list = shell.executeCommand(makeCommand("help", "list"));
+    EXPECT_NE(list.find("led[0..3] - Board LEDs\n"), std::string::npos);
+
+    auto help = shell.executeCommand(makeCommand("help", "led"));
+    EXPECT_NE(help.find("Component: led[0..3]\n"), std::string::npos);
+    EXPECT_NE(help.find("Commands:\n  on - Turn LED on\n"), std::string::npos);
+    EXPECT_EQ(shell.executeCommand(makeCommand("led2", "help", {"on"})), "led[N] on: Turn LED on\n");
+}
+
+namespace {
+    ComponentCommands makeStatusComponent(const std::string& name, int delayMs = 0)
+    {
+        ComponentCommands comp{name, "Device " + name};
+        comp.addCommand(CommandDetails{
+            "status", "Report status",
+            [name, delayMs](const std::vector<std::string>& args, const std::vector<std::string>&) -> std::string {
+                if (delayMs > 0) std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+                return name + " up" + (args.empty() ? "" : " " + args[0]) + "\n";
+            }
+        });
+        return comp;
+    }
+}
+
+TEST(CommandShellTests, HelpListFiltersAndPages)
+{
+    CommandShell shell;
+    for (const char* name : {"adc", "can0", "can1", "can2", "spi"})
+    {
+        shell.registerComponent(makeStatusComponent(name));
+    }
+    std::vector<bool> state(2, false);
+    shell.registerInstanceComponent(makeLedBank(state));
+
+    for (bool frozen : {false, true})
+    {
+        if (frozen) shell.freeze();
+        EXPECT_EQ(shell.executeCommand(makeCommand("help", "list", {}, {"--prefix=can", "--limit=2"})),
+            "Available components (1-2 of 3):\n  can0 - Device can0\n  can1 - Device can1\n");
+        EXPECT_EQ(shell.executeCommand(makeCommand("help", "list", {}, {"--prefix=can", "--limit=2", "--page=2"})),
+            "Available components (3-3 of 3):\n  can2 - Device can2\n");
+        EXPECT_EQ(shell.executeCommand(makeCommand("help", "list", {}, {"--prefix=can", "--limit=2", "--page=3"})),
+            "Available components (0 of 3):\n");
+        // A glob argument filters too; instance components follow the registered ones
+        EXPECT_EQ(shell.executeCommand(makeCommand("help", "list", {"l*"})), "Available components (1-1 of 1):\n  led[0..1] - Board LEDs\n");
+        EXPECT_EQ(shell.executeCommand(makeCommand("help", "list", {"?d*"})), "Available components (1-1 of 1):\n  adc - Device adc\n");
+        EXPECT_EQ(shell.executeCommand(makeCommand("help", "list", {"can?"}, {"--prefix=ca", "--page=2", "--limit=1"})),
+            "Available components (2-2 of 3):\n  can1 - Device can1\n");
+    }
+    EXPECT_EQ(shell.executeCommand(makeCommand("help", "list", {}, {"--page=0"})), "Error: invalid value for --page '0'\n");
+    EXPECT_EQ(shell.executeCommand(makeCommand("help", "list", {}, {"--limit=x"})), "Error: invalid value for --limit 'x'\n");
+}
+
+TEST(CommandShellTests, ComponentHelpFiltersCommandsByGlob)
+{
+    CommandShell shell;
+    auto sys = makeSysComponent();
+    sys.addCommand(CommandDetails{"eject", "Eject media",
+        [](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string { return {}; }});
+    sys.addCommand(CommandDetails{"status", "Report status",
+        [](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string { return {}; }});
+    shell.registerComponent(sys);
+
+    auto out = shell.executeCommand(makeCommand("help", "sys", {"e*"}, {"--page=2", "--limit=1"}));
+    EXPECT_NE(out.find("Commands (2-2 of 2):\n  eject - Eject media\n"), std::string::npos);
+    EXPECT_EQ(out.find("echo"), std::string::npos);
+
+    out = shell.executeCommand(makeCommand("sys", "help", {}, {"--limit=2"}));
+    EXPECT_NE(out.find("Commands (1-2 of 3):\n  echo - Echo arguments like /bin/echo\n  eject - Eject media\n"), std::string::npos);
+    EXPECT_EQ(out.find("status"), std::string::npos);
+
+    // A plain name still selects that one command
+    EXPECT_EQ(shell.executeCommand(makeCommand("help", "sys", {"eject"})), "sys eject: Eject media\n");
+}
+
+TEST(CommandShellTests, FanOutAllRunsOnEveryTargetInOrder)
+{
+    CommandShell shell;
+    shell.registerComponent(makeStatusComponent("pump"));
+    shell.registerComponent(makeStatusComponent("fan"));
+    shell.registerComponent(makeSysComponent()); // has no status command
+    commandshell::InstanceComponentCommands leds{"led", "Board LEDs", 2};
+    leds.addCommand(commandshell::InstanceCommandDetails{
+        "status", "Report status",
+        [](size_t i, const std::vector<std::string>&, const std::vector<std::string>&) -> std::string {
+            return "led" + std::to_string(i) + " off\n";
+        }
+    });
+    shell.registerInstanceComponent(leds);
+
+    auto out = shell.executeCommand(makeCommand("all", "status", {"now"}));
+    EXPECT_EQ(out,
+        "[fan] ok\nfan up now\n"
+        "[pump] ok\npump up now\n"
+        "[led0] ok\nled0 off\n"
+        "[led1] ok\nled1 off\n"
+        "4 targets: 4 ok, 0 timeout, 0 error\n");
+
+    auto glob = shell.executeCommand(makeCommand("p*", "status"));
+    EXPECT_EQ(glob, "[pump] ok\npump up\n1 targets: 1 ok, 0 timeout, 0 error\n");
+    auto missing = shell.executeCommand(makeCommand("s?s", "status"));
+    EXPECT_EQ(missing, "[sys] error: unknown command 'status'\n1 targets: 0 ok, 0 timeout, 1 error\n");
+    auto instances = shell.executeCommand(makeCommand("led?", "status"));
+    EXPECT_NE(instances.find("2 targets: 2 ok"), std::string::npos);
+}
+TEST(CommandShellTests, FanOutAllSkipsUnbuiltFactories)
+{
+    CommandShell shell;
+    shell.registerComponent(makeStatusComponent("pump"));
+    int builds = 0;
+    shell.registerComponentFactory(commandshell::ComponentFactory{
+        "meter", "Device meter",
+        [&builds]() { ++builds; return makeStatusComponent("meter"); }
+    });
+
+    EXPECT_EQ(shell.executeCommand(makeCommand("all", "status")), "[pump] ok\npump up\n1 targets: 1 ok, 0 timeout, 0 error\n");
+    EXPECT_EQ(builds, 0);
+
+    // Naming it through a glob builds it; from then on `all` includes it
+    EXPECT_EQ(shell.executeCommand(makeCommand("me*", "status")), "[meter] ok\nmeter up\n1 targets: 1 ok, 0 timeout, 0 error\n");
+    EXPECT_EQ(builds, 1);
+    EXPECT_NE(shell.executeCommand(makeCommand("all", "status")).find("2 targets: 2 ok"), std::string::npos);
+}
+
+
+TEST(CommandShellTests, FanOutReportsTimeoutPerTarget)
+{
+    CommandShell shell;
+    shell.setFanOutThreads(2);
+    shell.registerComponent(makeStatusComponent("dev1"));
+    shell.registerComponent(makeStatusComponent("dev2", 500));
+
+    shell.setFanOutAbandonLimit(1);
+    auto out = shell.executeCommand(makeCommand("dev?", "status", {}, {"--timeout=50"}));
+    EXPECT_EQ(out, "[dev1] ok\ndev1 up\n[dev2] timeout\n2 targets: 1 ok, 1 timeout, 0 error\n"
+                   "1 abandoned handler(s) running (limit 1)\n");
+
+    // The stuck handler still holds a worker: further fan-outs are refused until it returns
+    EXPECT_EQ(shell.executeCommand(makeCommand("dev?", "status")),
+              "Error: fan-out refused: 1 timed-out handler(s) still running (limit 1)\n");
+}
+
+TEST(CommandShellTests, DeadlineAnswersPromptlyAndCancelsHandler)
+{
+    CommandShell shell;
+    auto sawCancel = std::make_shared<std::atomic<bool>>(false);
+    ComponentCommands dev{"dev", "Device"};
+    CommandDetails hang{"hang", "Loop until cancelled", {}};
+    hang.cancellable = [sawCancel](const std::vector<std::string>&, const std::vector<std::string>&,
+                                   const commandshell::CancellationToken& token) -> std::string {
+        while (!token.isCancelled()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        sawCancel->store(true);
+        return "stopped\n";
+    };
+    hang.deadlineMs = 30;
+    dev.addCommand(hang);
+    shell.registerComponent(dev);
+
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(shell.executeCommand(makeCommand("dev", "hang")), "Error: command timed out after 30 ms\n");
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1000));
+
+    for (int i = 0; i < 200 && !sawCancel->load(); ++i) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    EXPECT_TRUE(sawCancel->load());
+    const auto stats = shell.watchdogStats();
+    EXPECT_EQ(stats.started, 1u);
+    EXPECT_EQ(stats.timeouts, 1u);
+    EXPECT_EQ(stats.unresponsive, 0u);
+}
+
+TEST(CommandShellTests, BoundedHandlerMayRunBoundedCommands)
+{
+    CommandShell shell;
+    ComponentCommands dev{"dev", "Device"};
+    CommandDetails inner{"inner", "Bounded leaf",
+        [](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string { return "leaf\n"; }};
+    inner.deadlineMs = 200;
+    CommandDetails outer{"outer", "Bounded handler calling back into the shell",
+        [&shell](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string {
+            return "outer " + shell.executeCommand(makeCommand("dev", "inner"));
+        }};
+    outer.deadlineMs = 500;
+    dev.addCommand(inner);
+    dev.addCommand(outer);
+    shell.registerComponent(dev);
+
+    // The nested call runs on the busy worker's thread instead of queueing behind its caller
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(shell.executeCommand(makeCommand("dev", "outer")), "outer leaf\n");
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(150));
+    EXPECT_EQ(shell.watchdogStats().timeouts, 0u);
+}
+
+TEST(CommandShellTests, StuckHandlerOnlyBlocksItsOwnComponent)
+{
+    auto owned = std::make_unique<CommandShell>();
+    CommandShell& shell = *owned;
+    auto release = std::make_shared<std::atomic<bool>>(false);
+    ComponentCommands dev{"dev", "Device"};
+    CommandDetails stuck{"stuck", "Ignores cancellation",
+        [release](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string {
+            while (!release->load()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            return "late\n";
+        }};
+    stuck.deadlineMs = 20;
+    dev.addCommand(stuck);
+    shell.registerComponent(dev);
+    ComponentCommands pump{"pump", "Pump"};
+    CommandDetails status{"status", "Bounded status",
+        [](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string { return "pump up\n"; }};
+    status.deadlineMs = 200;
+    pump.addCommand(status);
+    shell.registerComponent(pump);
+
+    EXPECT_EQ(shell.executeCommand(makeCommand("dev", "stuck")), "Error: command timed out after 20 ms\n");
+    // Bounded commands on other components still get a worker while dev's is held
+    for (int i = 0; i < 3; ++i)
+    {
+        EXPECT_EQ(shell.executeCommand(makeCommand("pump", "status")), "pump up\n");
+    }
+    EXPECT_EQ(shell.watchdogStats().timeouts, 1u);
+    EXPECT_EQ(shell.executeCommand(makeCommand("dev", "stuck")).find("Error: 'dev stuck' missed its deadline"), 0u);
+
+    release->store(true);
+    owned.reset();
+}
+
+TEST(CommandShellTests, DeadlinesFollowTheShellClock)
+{
+    CommandShell shell;
+    auto now = std::make_shared<std::atomic<uint64_t>>(0);
+    shell.setClock([now]() { return now->load(); });
+    ComponentCommands dev{"dev", "Device"};
+    CommandDetails wait{"wait", "Loop until cancelled", {}};
+    wait.cancellable = [](const std::vector<std::string>&, const std::vector<std::string>&,
+                          const commandshell::CancellationToken& token) -> std::string {
+        while (!token.isCancelled()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return "stopped\n";
+    };
+    wait.deadlineMs = 5000;
+    dev.addCommand(wait);
+    shell.registerComponent(dev);
+
+    // Simulated time passes the deadline long before 5 s of real time
+    std::thread clock([now]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        now->store(6000000);
+    });
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(shell.executeCommand(makeCommand("dev", "wait")), "Error: command timed out after 5000 ms\n");
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1000));
+    clock.join();
+}
+
+TEST(CommandShellTests, WatchdogFlagsHandlerIgnoringCancellation)
+{
+    auto owned = std::make_unique<CommandShell>();
+    CommandShell& shell = *owned;
+    ComponentCommands dev{"dev", "Device"};
+    CommandDetails stuck{
+        "stuck", "Ignores cancellation",
+        [](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string {
+            std::this_thread::sleep_for(std::chrono::milliseconds(400));
+            return "late\n";
+        }
+    };
+    stuck.deadlineMs = 20;
+    dev.addCommand(stuck);
+    shell.registerComponent(dev);
+
+    EXPECT_EQ(shell.executeCommand(makeCommand("dev", "stuck")), "Error: command timed out after 20 ms\n");
+
+    // Flagged once the grace period (100 ms) after the deadline has passed
+    std::string report;
+    for (int i = 0; i < 100; ++i)
+    {
+        report = shell.executeCommand(makeCommand("shell", "watchdog"));
+        if (report.find("ignored cancellation") != std::string::npos) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_NE(report.find("unresponsive 1"), std::string::npos);
+    EXPECT_NE(report.find("ignored cancellation: dev stuck\n"), std::string::npos);
+
+    // The component is refused while its late handler runs; others are not affected
+    EXPECT_EQ(shell.executeCommand(makeCommand("dev", "stuck")),
+              "Error: 'dev stuck' missed its deadline and is still running; 'dev' is unavailable until it returns\n");
+    shell.registerComponent(makeStatusComponent("pump"));
+    EXPECT_EQ(shell.executeCommand(makeCommand("pump", "status")), "pump up\n");
+
+    // Shutdown waits only the grace period for it
+    const auto start = std::chrono::steady_clock::now();
+    owned.reset();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(250));
+}
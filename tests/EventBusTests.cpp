@@ -0,0 +1,161 @@
+// Unit tests for EventBus and session push notifications
+#include "../src/CommandShell.hpp"
+#include "../src/CommandShellIO.hpp"
+#include "../src/EventBus.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using commandshell::CommandShell;
+using commandshell::CommandShellIO;
+using commandshell::EventBus;
+
+TEST(EventBusTests, CoalescesUpdatesWithinWindow)
+{
+    EventBus bus;
+    EventBus::Options options;
+    options.coalesceMs = 100;
+    auto id = bus.addSubscriber(options);
+    ASSERT_TRUE(bus.subscribe(id, "led.*"));
+    EXPECT_FALSE(bus.subscribe(id, "led.*"));
+
+    std::vector<EventBus::Event> out;
+    bus.publish("led.state", "on", 0);
+    bus.publish("fan.state", "ignored", 0);
+    EXPECT_EQ(bus.collect(id, 0, out, 10), 1u); // first update goes out at once
+    EXPECT_EQ(out[0].payload, "on");
+
+    // Inside the window: held back, and only the newest payload survives
+    bus.publish("led.state", "off", 10000);
+    bus.publish("led.state", "on", 20000);
+    bus.publish("led.state", "off", 30000);
+    out.clear();
+    EXPECT_EQ(bus.collect(id, 50000, out, 10), 0u);
+    EXPECT_EQ(bus.collect(id, 100000, out, 10), 1u);
+    EXPECT_EQ(out[0].payload, "off");
+    EXPECT_EQ(out[0].coalesced, 2u);
+
+    const auto stats = bus.stats(id);
+    EXPECT_EQ(stats.published, 4u);
+    EXPECT_EQ(stats.delivered, 2u);
+    EXPECT_EQ(stats.coalesced, 2u);
+}
+
+TEST(EventBusTests, BoundedMailboxDropsOldestTopic)
+{
+    EventBus bus;
+    EventBus::Options options;
+    options.maxPending = 2;
+    auto id = bus.addSubscriber(options);
+    bus.subscribe(id, "*");
+
+    bus.publish("a", "1", 0);
+    bus.publish("b", "2", 0);
+    bus.publish("c", "3", 0);
+
+    std::vector<EventBus::Event> out;
+    EXPECT_EQ(bus.collect(id, 0, out, 1), 1u); // per-call cap
+    EXPECT_EQ(bus.collect(id, 0, out, 10), 1u);
+    ASSERT_EQ(out.size(), 2u);
+    EXPECT_EQ(out[0].topic, "b");
+    EXPECT_EQ(out[1].topic, "c");
+    EXPECT_EQ(bus.stats(id).dropped, 1u);
+
+    bus.removeSubscriber(id);
+    bus.publish("a", "1", 0);
+    EXPECT_EQ(bus.collect(id, 0, out, 10), 0u);
+}
+
+TEST(EventBusTests, ExpiredSendTimesAreForgotten)
+{
+    EventBus bus;
+    EventBus::Options options;
+    options.coalesceMs = 100;
+    auto id = bus.addSubscriber(options);
+    bus.subscribe(id, "req.*");
+
+    std::vector<EventBus::Event> out;
+    for (int i = 0; i < 50; ++i)
+    {
+        bus.publish("req." + std::to_string(i), "done", 0);
+        EXPECT_EQ(bus.collect(id, 0, out, 10), 1u);
+    }
+    EXPECT_EQ(bus.stats(id).windows, 50u);
+
+    // Still inside the window: kept, and a repeat is still held back
+    bus.publish("req.7", "again", 50000);
+    EXPECT_EQ(bus.collect(id, 50000, out, 100), 0u);
+    EXPECT_EQ(bus.stats(id).windows, 50u);
+
+    // Past the window only the topic just delivered is remembered
+    EXPECT_EQ(bus.collect(id, 100000, out, 100), 1u);
+    EXPECT_EQ(bus.stats(id).windows, 1u);
+    EXPECT_EQ(bus.collect(id, 200000, out, 100), 0u);
+    EXPECT_EQ(bus.stats(id).windows, 0u);
+}
+
+TEST(EventBusTests, SessionReceivesEventsFromPoll)
+{
+    CommandShell shell;
+    uint64_t now = 0;
+    shell.setClock([&now]() { return now; });
+    CommandShellIO io(shell, /*echoInput=*/false);
+    std::string captured;
+    io.setOutputCallback([&captured](const std::string& s) { captured += s; });
+
+    std::string line = "events subscribe led.*\n";
+    io.input(line);
+    EXPECT_NE(captured.find("Subscribed to 'led.*'\n"), std::string::npos);
+
+    // A blinking LED publishes on every phase change
+    captured.clear();
+    shell.publishEvent("led.state", "LED: ON (blinking)\n");
+    io.poll();
+    EXPECT_EQ(captured, "[event] led.state LED: ON (blinking)\n");
+
+    captured.clear();
+    for (int i = 0; i < 5; ++i)
+    {
+        now += 10000;
+        shell.publishEvent("led.state", i % 2 ? "LED: ON (blinking)\n" : "LED: OFF (blinking)\n");
+        io.poll();
+    }
+    EXPECT_EQ(captured, ""); // still inside the 100 ms window
+    now = 100000;
+    io.poll();
+    EXPECT_EQ(captured, "[event] led.state LED: OFF (blinking)\n");
+
+    captured.clear();
+    line = "events list\n";
+    io.input(line);
+    EXPECT_NE(captured.find("Subscriptions: led.*\nEvents: 6 published, 2 delivered, 4 coalesced, 0 dropped\n"),
+              std::string::npos);
+
+    // publish goes through the shell, so it works from any session
+    captured.clear();
+    line = "events publish led.mode manual\n";
+    io.input(line);
+    now = 300000;
+    io.poll();
+    EXPECT_NE(captured.find("[event] led.mode manual\n"), std::string::npos);
+}
+
+TEST(EventBusTests, SlowSessionIsToldAboutDrops)
+{
+    CommandShell shell;
+    CommandShellIO io(shell, /*echoInput=*/false);
+    std::string captured;
+    io.setOutputCallback([&captured](const std::string& s) { captured += s; });
+    EventBus::Options options;
+    options.maxPending = 1;
+    io.setEventOptions(options);
+    ASSERT_TRUE(io.subscribe("*"));
+
+    captured.clear(); // initial prompt
+    shell.publishEvent("a", "1");
+    shell.publishEvent("b", "2");
+    io.poll();
+    EXPECT_EQ(captured, "[event] dropped 1 (slow subscriber)\n[event] b 2\n");
+    EXPECT_EQ(io.eventStats().dropped, 1u);
+}
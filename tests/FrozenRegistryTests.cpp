@@ -0,0 +1,132 @@
+// Unit tests for CommandShell::freeze() and the compacted FrozenRegistry layout
+#include "../src/CommandShell.hpp"
+#include "../src/FrozenRegistry.hpp"
+#include "TestHelpers.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using commandshell::CommandDetails;
+using commandshell::CommandPriority;
+using commandshell::CommandShell;
+using commandshell::Command;
+using commandshell::ComponentCommands;
+using commandshell::ComponentFactory;
+using commandshell::OptionDetails;
+using testhelpers::makeCommand;
+
+namespace {
+    // A board-like component: several commands sharing one long description
+    ComponentCommands makeBank(const std::string& name)
+    {
+        ComponentCommands bank{name, "Register bank with a description long enough to leave the small buffer"};
+        bank.addOption(OptionDetails{"-v", "--verbose", "Print every register touched by the command"});
+        for (const char* cmd : {"write", "read", "dump", "clear"})
+        {
+            bank.addCommand(CommandDetails{cmd, "Operate on the register bank given by the component name",
+                [name, cmd](const std::vector<std::string>& args, const std::vector<std::string>&) {
+                    return name + " " + cmd + (args.empty() ? "" : " " + args[0]) + "\n";
+                }});
+        }
+        return bank;
+    }
+}
+
+TEST(FrozenRegistryTests, FrozenShellAnswersLikeTheMutableOne)
+{
+    CommandShell shell;
+    shell.registerComponent(makeBank("regs"));
+    shell.registerComponent(makeBank("adc"));
+    const std::vector<Command> probes = {
+        makeCommand("help", "list"), makeCommand("help", "regs"), makeCommand("help", "regs", {"dump"}),
+        makeCommand("adc", "help"), makeCommand("regs", "read", {"7"}), makeCommand("adc", "clear"),
+        makeCommand("regs", "nope"), makeCommand("nope", "read"), makeCommand("help", "registry"),
+        makeCommand("all", "dump"),
+    };
+    std::vector<std::string> before;
+    for (const auto& probe : probes) before.push_back(shell.executeCommand(probe));
+
+    auto stats = shell.freeze();
+    EXPECT_TRUE(shell.isFrozen());
+    EXPECT_EQ(stats.components, shell.materializedComponents());
+    EXPECT_LT(stats.bytesAfter, stats.bytesBefore);
+    for (size_t i = 0; i < probes.size(); ++i)
+    {
+        EXPECT_EQ(shell.executeCommand(probes[i]), before[i]) << probes[i].component << " " << probes[i].command;
+    }
+
+    // The shared descriptions are stored once
+    auto report = shell.executeCommand(makeCommand("shell", "registry"));
+    EXPECT_EQ(report.find("Registry: frozen"), 0u);
+    EXPECT_NE(report.find("saved "), std::string::npos);
+}
+
+TEST(FrozenRegistryTests, RegistrationIsRejectedUntilThaw)
+{
+    CommandShell shell;
+    ASSERT_TRUE(shell.registerComponent(makeBank("regs")));
+    shell.freeze();
+
+    EXPECT_FALSE(shell.registerComponent(makeBank("adc")));
+    EXPECT_FALSE(shell.registerComponentFactory(ComponentFactory{"gpio", "Pins", [] { return makeBank("gpio"); }}));
+    EXPECT_EQ(shell.executeCommand(makeCommand("adc", "read")), "Unknown component 'adc'\n");
+
+    shell.thaw();
+    EXPECT_FALSE(shell.isFrozen());
+    EXPECT_TRUE(shell.registerComponent(makeBank("adc")));
+    EXPECT_EQ(shell.executeCommand(makeCommand("adc", "read", {"1"})), "adc read 1\n");
+    // Handlers moved back out of the frozen table still work
+    EXPECT_EQ(shell.executeCommand(makeCommand("regs", "write", {"2"})), "regs write 2\n");
+    EXPECT_NE(shell.executeCommand(makeCommand("help", "regs")).find("  -v, --verbose  - Print every"), std::string::npos);
+}
+
+TEST(FrozenRegistryTests, FreezeBuildsLazyComponentsAndKeepsPriorities)
+{
+    CommandShell shell;
+    int builds = 0;
+    shell.registerComponentFactory(ComponentFactory{"motor", "Motor control", [&builds] {
+        ++builds;
+        ComponentCommands motor{"motor", "Motor control"};
+        CommandDetails stop{"stop", "Stop now",
+            [](const std::vector<std::string>&, const std::vector<std::string>&) { return std::string("stopped\n"); }};
+        stop.priority = CommandPriority::High;
+        motor.addCommand(stop);
+        return motor;
+    }});
+    EXPECT_FALSE(shell.commandPriority(makeCommand("motor", "stop")).has_value());
+
+    shell.freeze();
+    EXPECT_EQ(builds, 1);
+    EXPECT_EQ(shell.commandPriority(makeCommand("motor", "stop")), CommandPriority::High);
+    EXPECT_EQ(shell.executeCommand(makeCommand("motor", "stop")), "stopped\n");
+    EXPECT_EQ(builds, 1);
+}
+
+TEST(FrozenRegistryTests, LookupUsesSortedOffsetsButHelpKeepsRegistrationOrder)
+{
+    std::vector<ComponentCommands> components;
+    ComponentCommands b{"b", "second"};
+    for (const char* cmd : {"zeta", "alpha", "mid", "alpha"})
+    {
+        b.addCommand(CommandDetails{cmd, cmd, [cmd](const std::vector<std::string>&, const std::vector<std::string>&) {
+            return std::string(cmd);
+        }});
+    }
+    components.push_back(ComponentCommands{"a", "first"});
+    components.push_back(std::move(b));
+    commandshell::FrozenRegistry frozen(std::move(components));
+
+    const auto* comp = frozen.findComponent("b");
+    ASSERT_NE(comp, nullptr);
+    EXPECT_EQ(frozen.findComponent("c"), nullptr);
+    std::vector<std::string> order;
+    for (const auto& cmd : comp->commands) order.emplace_back(cmd.command);
+    EXPECT_EQ(order, (std::vector<std::string>{"zeta", "alpha", "mid", "alpha"}));
+
+    const CommandDetails* mid = frozen.findCommand(*comp, "mid");
+    ASSERT_NE(mid, nullptr);
+    EXPECT_EQ(mid->execute({}, {}), "mid");
+    EXPECT_EQ(frozen.findCommand(*comp, "beta"), nullptr);
+    EXPECT_EQ(frozen.stats().blobBytes, std::string("afirstbsecondzetaalphamid").size());
+}
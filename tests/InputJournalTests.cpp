@@ -0,0 +1,107 @@
+// Unit tests for the input journal recorder, parser and replay
+#ifdef CommandShell
+#undef CommandShell
+#endif
+
+#include "../src/CommandShell.hpp"
+#include "../src/CommandShellIO.hpp"
+#include "../src/InputJournal.hpp"
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using commandshell::CommandShell;
+using commandshell::CommandShellIO;
+using commandshell::InputRecorder;
+using commandshell::JournalRecord;
+using commandshell::ReplayOptions;
+
+TEST(InputJournalTests, RecordsChunksWithTimingAndParsesBack)
+{
+    CommandShell shell;
+    uint64_t now = 1000;
+    shell.setClock([&now]() { return now; });
+
+    std::string journal;
+    InputRecorder recorder([&journal](const char* d, size_t n) { journal.append(d, n); });
+    CommandShellIO io(shell, /*echoInput=*/false);
+    io.setInputRecorder(&recorder);
+
+    std::string a = "help";
+    std::string b = " list\n";
+    io.input(a);
+    now += 250;
+    io.input(b);
+
+    EXPECT_EQ(recorder.recordCount(), 2u);
+    EXPECT_EQ(journal.substr(0, 4), "CSJ1");
+
+    std::vector<JournalRecord> records;
+    ASSERT_TRUE(commandshell::parseJournal(journal, records));
+    ASSERT_EQ(records.size(), 2u);
+    EXPECT_EQ(records[0].deltaUs, 0u);
+    EXPECT_EQ(records[0].bytes, "help");
+    EXPECT_EQ(records[1].deltaUs, 250u);
+    EXPECT_EQ(records[1].bytes, " list\n");
+
+    // Truncated journals are rejected
+    std::vector<JournalRecord> bad;
+    EXPECT_FALSE(commandshell::parseJournal(journal.substr(0, journal.size() - 1), bad));
+}
+
+TEST(InputJournalTests, FileWriterContinuesAnExistingJournal)
+{
+    const std::string path = ::testing::TempDir() + "input_journal_append.csj";
+    std::remove(path.c_str());
+    for (const char* chunk : {"help\n", "help list\n"})
+    {
+        InputRecorder recorder(commandshell::journalFileWriter(path));
+        recorder.record(chunk, std::string(chunk).size(), 100);
+    }
+
+    std::vector<JournalRecord> records;
+    ASSERT_TRUE(commandshell::loadJournal(path, records));
+    ASSERT_EQ(records.size(), 2u);
+    EXPECT_EQ(records[0].bytes, "help\n");
+    EXPECT_EQ(records[1].bytes, "help list\n");
+
+    // Anything else is left untouched
+    std::FILE* other = std::fopen(path.c_str(), "wb");
+    ASSERT_NE(other, nullptr);
+    std::fputs("not a journal", other);
+    std::fclose(other);
+    EXPECT_FALSE(commandshell::journalFileWriter(path));
+    std::remove(path.c_str());
+}
+
+TEST(InputJournalTests, ReplayHonoursSpeedAndReportsLatency)
+{
+    std::vector<JournalRecord> records{{0, "help "}, {1000, "list\n"}, {4000, "help\n"}};
+
+    CommandShell shell;
+    uint64_t now = 0;
+    shell.setClock([&now]() { return now; });
+
+    std::vector<uint64_t> waits;
+    std::string output;
+    ReplayOptions options;
+    options.speed = ReplayOptions::Speed::Scaled;
+    options.scale = 2.0;
+    options.sleep = [&](uint64_t us) { waits.push_back(us); now += us; };
+    options.output = [&output](const std::string& s) { output += s; };
+
+    auto report = commandshell::replayJournal(records, shell, options);
+    EXPECT_EQ(waits, (std::vector<uint64_t>{500, 2000}));
+    EXPECT_EQ(report.chunks, 3u);
+    EXPECT_EQ(report.bytes, 15u);
+    EXPECT_EQ(report.elapsedUs, 2500u);
+    EXPECT_EQ(report.inputLatency.count(), 3u);
+    EXPECT_NE(output.find("Available components:"), std::string::npos);
+
+    waits.clear();
+    options.speed = ReplayOptions::Speed::Max;
+    commandshell::replayJournal(records, shell, options);
+    EXPECT_TRUE(waits.empty());
+}
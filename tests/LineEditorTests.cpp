@@ -0,0 +1,128 @@
+// Unit tests for LineEditor key decoding and minimal-redraw echo
+#include "../src/CommandShell.hpp"
+#include "../src/CommandShellIO.hpp"
+#include "../src/LineEditor.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using commandshell::CommandShell;
+using commandshell::CommandShellIO;
+using commandshell::CommandDetails;
+using commandshell::ComponentCommands;
+using commandshell::LineEditor;
+
+namespace {
+    // Decode and apply a byte string; returns the echo and collects actions
+    std::string type(LineEditor& editor, const std::string& bytes,
+                     std::vector<LineEditor::Action>* actions = nullptr)
+    {
+        std::string echo;
+        LineEditor::KeyEvent key;
+        for (char c : bytes) {
+            if (!editor.decode(c, key)) continue;
+            auto action = editor.apply(key, echo);
+            if (actions && action != LineEditor::Action::None) actions->push_back(action);
+        }
+        return echo;
+    }
+}
+
+TEST(LineEditorTests, DecodesCursorKeysInCsiAndSs3Forms)
+{
+    LineEditor editor;
+    type(editor, "abcd");
+    EXPECT_EQ(type(editor, "\x1b[D\x1bOD"), "\b\b");
+    EXPECT_EQ(editor.cursor(), 2u);
+    EXPECT_EQ(type(editor, "\x1b[H"), "\b\b");        // Home
+    EXPECT_EQ(type(editor, "\x1b[4~"), "abcd");       // End re-sends the tail
+    EXPECT_EQ(type(editor, "\x01"), "\b\b\b\b");      // Ctrl-A
+    EXPECT_EQ(type(editor, "\x1b[C"), "a");           // Right re-sends one char
+    EXPECT_EQ(editor.cursor(), 1u);
+
+    std::vector<LineEditor::Action> actions;
+    type(editor, "\x1b[A\x1b[B\x12\r\n", &actions);
+    using A = LineEditor::Action;
+    EXPECT_EQ(actions, (std::vector<A>{A::HistoryOlder, A::HistoryNewer, A::Search, A::Submit}));
+    EXPECT_EQ(editor.line(), "abcd"); // unknown sequences and control bytes never land in the line
+    type(editor, "\x1b[5~\x1b[2J\x0b");
+    EXPECT_EQ(editor.line(), "abcd");
+}
+
+TEST(LineEditorTests, MidLineEditsEmitShortestUpdate)
+{
+    LineEditor editor;
+    type(editor, "helo");
+    type(editor, "\x1b[D");
+    // Insert before a one-char tail: rewriting "lo" and stepping back (3 bytes)
+    EXPECT_EQ(type(editor, "l"), "lo\b");
+    EXPECT_EQ(editor.line(), "hello");
+
+    // Long tail: insert-character sequence beats rewriting it
+    LineEditor wide;
+    type(wide, "a long line of text");
+    type(wide, "\x01");
+    EXPECT_EQ(type(wide, "X"), "\x1b[@X");
+    EXPECT_EQ(wide.line(), "Xa long line of text");
+
+    // Backspace at end, mid-line with a short tail, mid-line with a long tail
+    EXPECT_EQ(type(editor, "\x1b[F\x7f"), "o\b \b");
+    EXPECT_EQ(editor.line(), "hell");
+    EXPECT_EQ(type(editor, "\x1b[D\x7f"), "\b\b\x1b[P"); // DCH is shorter than "l \b\b"
+    EXPECT_EQ(editor.line(), "hel");
+    EXPECT_EQ(type(wide, "\x1b[C\x7f"), "a\b\x1b[P");
+    EXPECT_EQ(wide.line(), "X long line of text");
+
+    // Delete under the cursor
+    EXPECT_EQ(type(wide, "\x1b[3~"), "\x1b[P");
+    EXPECT_EQ(wide.line(), "Xlong line of text");
+    EXPECT_EQ(type(wide, "\x1b[F\x1b[3~"), "\x1b[17C"); // CSI move beats re-sending 17 chars; nothing to delete at end
+}
+
+TEST(LineEditorTests, SetLineRewritesOnlyTheDifference)
+{
+    LineEditor editor;
+    type(editor, "led on 1");
+    std::string echo;
+    editor.setLine("led off", echo);
+    EXPECT_EQ(echo, "\b\b\bff\x1b[K"); // common prefix "led o" stays on screen
+    EXPECT_EQ(editor.line(), "led off");
+
+    echo.clear();
+    editor.setLine("led off 22", echo);
+    EXPECT_EQ(echo, " 22");
+}
+
+TEST(LineEditorTests, SessionEditsLineBeforeSubmitting)
+{
+    CommandShell shell;
+    std::string received;
+    ComponentCommands sys{"sys", "System commands"};
+    sys.addCommand(CommandDetails{"echo", "Echo an argument",
+        [&received](const std::vector<std::string>& args, const std::vector<std::string>&) {
+            received = args.empty() ? "" : args[0];
+            return std::string("ok\n");
+        }});
+    shell.registerComponent(sys);
+
+    CommandShellIO io(shell);
+    std::string out;
+    io.setOutputCallback([&out](const std::string& s) { out += s; });
+
+    std::string typed = "sys echo wrld";
+    io.input(typed);
+    out.clear();
+    std::string edit = "\x1b[D\x1b[D\x1b[Do\x1b[F\r";
+    io.input(edit);
+    EXPECT_EQ(received, "world");
+    EXPECT_EQ(out.find("\b\b\b\x1b[@orld"), 0u); // three steps back, insert, End re-sends the tail
+    EXPECT_NE(out.find("ok\n"), std::string::npos);
+
+    // A plain chunk after the edit takes the verbatim fast path again
+    out.clear();
+    std::string next = "sys echo again\n";
+    io.input(next);
+    EXPECT_EQ(received, "again");
+    EXPECT_EQ(out.find("sys echo again\n"), 0u);
+}
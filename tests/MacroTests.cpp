@@ -0,0 +1,199 @@
+// Unit tests for server-side macros: parsing, placeholders, pre-resolved steps and the `macro` built-in
+#include "../src/CommandShell.hpp"
+#include "../src/CommandShellIO.hpp"
+#include "../src/Macro.hpp"
+#include "TestHelpers.hpp"
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using commandshell::CommandDetails;
+using commandshell::CommandShell;
+using commandshell::CommandShellIO;
+using commandshell::Command;
+using commandshell::ComponentCommands;
+using commandshell::ExecutionOptions;
+using commandshell::MacroDefinition;
+using commandshell::OutputFormat;
+using testhelpers::makeCommand;
+
+namespace {
+    // `led on/off <n>` that records every call
+    void registerLed(CommandShell& shell, std::vector<std::string>& calls, const std::string& prefix = "")
+    {
+        ComponentCommands led{"led", "Board LEDs"};
+        for (const char* state : {"on", "off"})
+        {
+            std::string name = state;
+            led.addCommand(CommandDetails{name, "Switch an LED",
+                [&calls, name, prefix](const std::vector<std::string>& args, const std::vector<std::string>& opts) {
+                    std::string call = prefix + name;
+                    for (const auto& a : args) call += " " + a;
+                    for (const auto& o : opts) call += " " + o;
+                    calls.push_back(call);
+                    return "LED " + call + "\n";
+                }});
+        }
+        shell.registerComponent(led);
+    }
+}
+
+TEST(MacroTests, ParsesStepsOptionsAndPlaceholders)
+{
+    MacroDefinition macro;
+    std::string error;
+    ASSERT_TRUE(MacroDefinition::parse("led on $1 -f ;; sys delay 100 ; led$2 off", macro, error)) << error;
+    ASSERT_EQ(macro.steps().size(), 3u);
+    EXPECT_EQ(macro.arity(), 2u);
+
+    const auto& first = macro.steps()[0];
+    EXPECT_TRUE(first.templated);
+    EXPECT_FALSE(first.dynamicTarget);
+    EXPECT_EQ(first.command.options, std::vector<std::string>{"-f"});
+
+    EXPECT_FALSE(macro.steps()[1].templated);
+    EXPECT_EQ(macro.steps()[1].command.arguments, std::vector<std::string>{"100"});
+    EXPECT_TRUE(macro.steps()[2].dynamicTarget);
+
+    Command expanded = macro.expand(0, {"3", "x"});
+    EXPECT_EQ(expanded.arguments, std::vector<std::string>{"3"});
+    EXPECT_EQ(macro.expand(2, {"3", "x"}).component, "ledx");
+}
+
+TEST(MacroTests, RejectsMalformedBodies)
+{
+    MacroDefinition macro;
+    std::string error;
+    EXPECT_FALSE(MacroDefinition::parse(" ; ", macro, error));
+    EXPECT_EQ(error, "Error: macro has no steps\n");
+    EXPECT_FALSE(MacroDefinition::parse("led on ; led", macro, error));
+    EXPECT_EQ(error, "Error: macro step 2 is incomplete: 'led'\n");
+    EXPECT_FALSE(MacroDefinition::parse("led on | grep ON", macro, error));
+    EXPECT_EQ(error, "Error: macro step 1: pipelines are not supported\n");
+}
+
+TEST(MacroTests, RunsAllStepsInOneResponse)
+{
+    CommandShell shell;
+    std::vector<std::string> calls;
+    registerLed(shell, calls);
+
+    std::string reply;
+    ASSERT_TRUE(shell.defineMacro("blink", "led on $1 ; led off $1", &reply));
+    EXPECT_EQ(reply, "Macro 'blink' defined: 2 steps, 1 argument\n");
+
+    EXPECT_EQ(shell.runMacro("blink", {"4"}), "LED on 4\nLED off 4\n");
+    EXPECT_EQ(shell.executeCommand(makeCommand("macro", "run", {"blink", "7"})), "LED on 7\nLED off 7\n");
+    EXPECT_EQ(calls, (std::vector<std::string>{"on 4", "off 4", "on 7", "off 7"}));
+
+    EXPECT_EQ(shell.runMacro("blink", {}), "Error: macro 'blink' needs 1 arguments\n");
+    EXPECT_EQ(shell.runMacro("nope", {}), "Error: unknown macro 'nope'\n");
+}
+
+TEST(MacroTests, DefinitionChecksEveryStep)
+{
+    CommandShell shell;
+    std::vector<std::string> calls;
+    registerLed(shell, calls);
+
+    std::string reply;
+    EXPECT_FALSE(shell.defineMacro("bad", "led on ; motor spin", &reply));
+    EXPECT_EQ(reply, "Error: macro step 2: unknown command 'motor spin'\n");
+    EXPECT_EQ(shell.executeCommand(makeCommand("macro", "list")), "No macros defined\n");
+
+    // Built-ins, fan-out and dynamic targets are dispatched per run, so they are accepted
+    EXPECT_TRUE(shell.defineMacro("mixed", "help list ; all status ; $1 on"));
+    EXPECT_EQ(shell.executeCommand(makeCommand("macro", "list")),
+        "Macros:\n  mixed (3 steps, 1 args): help list ; all status ; $1 on\n");
+    EXPECT_EQ(shell.executeCommand(makeCommand("macro", "delete", {"mixed"})), "Deleted macro 'mixed'\n");
+    EXPECT_FALSE(shell.deleteMacro("mixed"));
+}
+
+TEST(MacroTests, StepsFollowReRegistrationAndFreeze)
+{
+    CommandShell shell;
+    std::vector<std::string> calls;
+    registerLed(shell, calls);
+    ASSERT_TRUE(shell.defineMacro("on", "led on 1"));
+
+    // Replacing the component moves the handlers; the macro must not run the old ones
+    std::vector<std::string> replaced;
+    registerLed(shell, replaced, "new ");
+    EXPECT_EQ(shell.runMacro("on", {}), "LED new on 1\n");
+
+    shell.freeze();
+    EXPECT_EQ(shell.runMacro("on", {}), "LED new on 1\n");
+    shell.thaw();
+    EXPECT_EQ(shell.runMacro("on", {}), "LED new on 1\n");
+    EXPECT_TRUE(calls.empty());
+}
+
+TEST(MacroTests, NestedMacrosAreBounded)
+{
+    CommandShell shell;
+    ASSERT_TRUE(shell.defineMacro("loop", "macro run loop"));
+    EXPECT_EQ(shell.runMacro("loop", {}), "Error: macro nesting deeper than 8\n");
+}
+
+TEST(MacroTests, StepsRunWithTheCallersOptions)
+{
+    CommandShell shell;
+    std::vector<std::string> calls;
+    registerLed(shell, calls);
+    ComponentCommands dev{"dev", "Device"};
+    CommandDetails hang{"hang", "Loop until cancelled", {}};
+    hang.cancellable = [](const std::vector<std::string>&, const std::vector<std::string>&,
+                          const commandshell::CancellationToken& token) -> std::string {
+        while (!token.isCancelled()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return "stopped\n";
+    };
+    dev.addCommand(hang);
+    shell.registerComponent(dev);
+
+    // `--format=` selects one step's encoding, as on the command line; the handler never sees it
+    ASSERT_TRUE(shell.defineMacro("mixed", "led on 1 --format=json ; led off 1"));
+    EXPECT_EQ(shell.runMacro("mixed", {}), "{\"output\":\"LED on 1\\n\"}\nLED off 1\n");
+    EXPECT_EQ(calls, (std::vector<std::string>{"on 1", "off 1"}));
+
+    // A structured session gets the whole macro as one encoded response
+    ExecutionOptions options;
+    options.format = OutputFormat::Json;
+    ASSERT_TRUE(shell.defineMacro("off", "led off 2"));
+    EXPECT_EQ(shell.executeCommand(makeCommand("macro", "run", {"off"}), options), "{\"output\":\"LED off 2\\n\"}\n");
+
+    // The session deadline bounds each pre-resolved step
+    options = ExecutionOptions{};
+    options.deadlineMs = 20;
+    ASSERT_TRUE(shell.defineMacro("stall", "dev hang"));
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(shell.executeCommand(makeCommand("macro", "run", {"stall"}), options), "Error: command timed out after 20 ms\n");
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(1000));
+}
+
+TEST(MacroTests, SessionDefinesStepsWithOptions)
+{
+    CommandShell shell;
+    std::vector<std::string> calls;
+    registerLed(shell, calls);
+    CommandShellIO io(shell, /*echoInput=*/false);
+    std::string captured;
+    io.setOutputCallback([&captured](const std::string& s) { captured += s; });
+
+    captured.clear();
+    std::string line = "macro define flash led on $1 -f ; led off $1\n";
+    io.input(line);
+    EXPECT_NE(captured.find("Macro 'flash' defined: 2 steps, 1 argument\n"), std::string::npos);
+
+    captured.clear();
+    line = "macro run flash 2\n";
+    io.input(line);
+    EXPECT_NE(captured.find("LED on 2 -f\nLED off 2\n"), std::string::npos);
+
+    captured.clear();
+    line = "macro define piped led on | grep on\n";
+    io.input(line);
+    EXPECT_NE(captured.find("Error: macro step 1: pipelines are not supported\n"), std::string::npos);
+}
@@ -0,0 +1,180 @@
+// Unit tests for OutputQueue policies, counters and CommandShellIO backpressure
+#include "../src/CommandShell.hpp"
+#include "../src/CommandShellIO.hpp"
+#include "../src/OutputQueue.hpp"
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using commandshell::CommandDetails;
+using commandshell::CommandShell;
+using commandshell::CommandShellIO;
+using commandshell::ComponentCommands;
+using commandshell::OutputQueue;
+
+namespace {
+    // Sink that accepts at most `budget` bytes until refilled
+    struct SlowSink
+    {
+        std::string written;
+        size_t budget = 0;
+        OutputQueue::Writer writer()
+        {
+            return [this](const char* data, size_t size) {
+                const size_t n = std::min(size, budget);
+                written.append(data, n);
+                budget -= n;
+                return n;
+            };
+        }
+    };
+
+    OutputQueue::Options makeOptions(OutputQueue::Policy policy, size_t capacity, size_t resume = 0)
+    {
+        OutputQueue::Options options;
+        options.policy = policy;
+        options.capacityBytes = capacity;
+        options.resumeBytes = resume;
+        return options;
+    }
+}
+
+TEST(OutputQueueTests, DrainWritesWhatTheSinkAccepts)
+{
+    SlowSink sink;
+    OutputQueue queue(sink.writer(), makeOptions(OutputQueue::Policy::DropOldest, 64));
+    queue.push("hello ");
+    queue.push("world\n");
+    EXPECT_EQ(queue.pendingBytes(), 12u);
+
+    sink.budget = 4;
+    EXPECT_EQ(queue.drain(), 4u);
+    EXPECT_EQ(queue.drain(), 0u); // sink busy
+    sink.budget = 100;
+    EXPECT_EQ(queue.drain(3), 3u);
+    EXPECT_EQ(queue.drain(), 5u);
+    EXPECT_EQ(sink.written, "hello world\n");
+
+    const auto stats = queue.stats();
+    EXPECT_EQ(stats.queuedBytes, 12u);
+    EXPECT_EQ(stats.writtenBytes, 12u);
+    EXPECT_EQ(stats.pendingBytes, 0u);
+}
+
+TEST(OutputQueueTests, DropOldestKeepsNewestBytes)
+{
+    SlowSink sink;
+    OutputQueue queue(sink.writer(), makeOptions(OutputQueue::Policy::DropOldest, 8));
+    queue.push("abcdef");
+    queue.push("ghij");
+    EXPECT_EQ(queue.stats().droppedBytes, 2u);
+    queue.push("0123456789AB"); // larger than the queue on its own
+    EXPECT_EQ(queue.stats().droppedBytes, 14u);
+    sink.budget = 100;
+    queue.drain();
+    EXPECT_EQ(sink.written, "456789AB");
+}
+
+TEST(OutputQueueTests, BlockWritesInlineWithoutDrainThread)
+{
+    SlowSink sink;
+    OutputQueue queue(sink.writer(), makeOptions(OutputQueue::Policy::Block, 4));
+    sink.budget = 100;
+    queue.push("0123456789");
+    // Nothing is lost: the producer wrote to the sink itself once the queue was full
+    EXPECT_EQ(queue.stats().blockedPushes, 1u);
+    EXPECT_EQ(queue.stats().droppedBytes, 0u);
+    EXPECT_EQ(queue.pendingBytes(), 2u);
+    queue.drain();
+    EXPECT_EQ(sink.written, "0123456789");
+}
+
+TEST(OutputQueueTests, BlockWaitsForDrainThread)
+{
+    std::string written;
+    OutputQueue queue([&written](const char* data, size_t size) {
+        written.append(data, size);
+        return size;
+    }, makeOptions(OutputQueue::Policy::Block, 16));
+    queue.start();
+    for (int i = 0; i < 200; ++i)
+    {
+        queue.push("line " + std::to_string(i) + "\n");
+    }
+    while (queue.pendingBytes() != 0)
+    {
+        std::this_thread::yield();
+    }
+    queue.stop();
+
+    std::string expected;
+    for (int i = 0; i < 200; ++i)
+    {
+        expected += "line " + std::to_string(i) + "\n";
+    }
+    EXPECT_EQ(written, expected);
+    EXPECT_EQ(queue.stats().droppedBytes, 0u);
+}
+
+TEST(OutputQueueTests, PushDoesNotWaitForTheWriter)
+{
+    std::string written;
+    std::atomic<bool> inWriter{false};
+    std::atomic<bool> release{false};
+    OutputQueue queue([&](const char* data, size_t size) {
+        inWriter = true;
+        while (!release) std::this_thread::yield();
+        written.append(data, size);
+        return size;
+    }, makeOptions(OutputQueue::Policy::DropOldest, 64));
+    queue.start();
+    queue.push("first\n");
+    while (!inWriter) std::this_thread::yield();
+
+    // The drain thread is stuck in the sink; the queue itself stays available
+    queue.push("second\n");
+    EXPECT_EQ(queue.pendingBytes(), 13u);
+    release = true;
+    while (queue.pendingBytes() != 0) std::this_thread::yield();
+    queue.stop();
+    EXPECT_EQ(written, "first\nsecond\n");
+}
+
+TEST(OutputQueueTests, BackpressurePausesSessionInput)
+{
+    CommandShell shell;
+    ComponentCommands sys{"sys", "Demo"};
+    sys.addCommand(CommandDetails{"dump", "Long output",
+        [](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string { return std::string(30, 'x') + "\n"; }});
+    shell.registerComponent(sys);
+
+    SlowSink sink;
+    OutputQueue queue(sink.writer(), makeOptions(OutputQueue::Policy::Backpressure, 32, 8));
+    CommandShellIO io(shell, /*echoInput=*/false, "> ");
+    io.setOutputQueue(&queue);
+    EXPECT_FALSE(io.inputPaused());
+
+    std::string line = "sys dump\n";
+    io.input(line);
+    EXPECT_TRUE(io.inputPaused());
+    EXPECT_EQ(queue.stats().pauses, 1u);
+
+    // Held, not run, while the link is behind
+    line = "sys dump\n";
+    io.input(line);
+    io.poll();
+    EXPECT_EQ(queue.pendingBytes(), 35u);
+
+    sink.budget = 30;
+    queue.drain();
+    EXPECT_FALSE(io.inputPaused());
+    io.poll();
+    sink.budget = 100;
+    queue.drain();
+    EXPECT_EQ(sink.written, "> " + std::string(30, 'x') + "\n> " + std::string(30, 'x') + "\n> ");
+    EXPECT_EQ(io.droppedInputBytes(), 0u);
+}
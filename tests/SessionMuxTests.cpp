@@ -0,0 +1,223 @@
+// Unit tests for SessionMux framing, per-channel sessions, fair output and queue limits
+#include "../src/CommandShell.hpp"
+#include "../src/SessionMux.hpp"
+
+#include <gtest/gtest.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+using commandshell::CommandDetails;
+using commandshell::CommandShell;
+using commandshell::ComponentCommands;
+using commandshell::SessionMux;
+
+namespace {
+    // Decodes the link output back into (channel, payload) frames
+    struct LinkCapture
+    {
+        std::string bytes;
+        SessionMux::Writer writer()
+        {
+            return [this](const char* data, size_t size) { bytes.append(data, size); };
+        }
+        std::vector<std::pair<uint8_t, std::string>> frames() const
+        {
+            std::vector<std::pair<uint8_t, std::string>> out;
+            size_t pos = 0;
+            while (pos + SessionMux::kHeaderBytes <= bytes.size())
+            {
+                EXPECT_EQ(static_cast<uint8_t>(bytes[pos]), SessionMux::kSync);
+                const size_t length = (static_cast<size_t>(static_cast<uint8_t>(bytes[pos + 2])) << 8)
+                    | static_cast<uint8_t>(bytes[pos + 3]);
+                EXPECT_EQ(SessionMux::crc8(bytes.data() + pos + 1, SessionMux::kHeaderBytes - 1 + length),
+                          static_cast<uint8_t>(bytes[pos + SessionMux::kHeaderBytes + length]));
+                out.emplace_back(static_cast<uint8_t>(bytes[pos + 1]), bytes.substr(pos + SessionMux::kHeaderBytes, length));
+                pos += SessionMux::kHeaderBytes + length + SessionMux::kTrailerBytes;
+            }
+            return out;
+        }
+        std::map<uint8_t, std::string> byChannel() const
+        {
+            std::map<uint8_t, std::string> out;
+            for (const auto& f : frames()) out[f.first] += f.second;
+            return out;
+        }
+    };
+
+    void registerLed(CommandShell& shell)
+    {
+        ComponentCommands led{"led", "Board LED"};
+        led.addCommand(CommandDetails{"on", "Turn LED on",
+            [](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string { return "LED: ON\n"; }});
+        led.addCommand(CommandDetails{"dump", "Long output",
+            [](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string { return std::string(100, 'x') + "\n"; }});
+        shell.registerComponent(led);
+    }
+}
+
+TEST(SessionMuxTests, ChannelsKeepIndependentSessionState)
+{
+    CommandShell shell;
+    registerLed(shell);
+    LinkCapture link;
+    SessionMux mux(shell, link.writer());
+    ASSERT_NE(mux.open(0, /*echoInput=*/true, "con> "), nullptr);
+    ASSERT_NE(mux.open(1, /*echoInput=*/false, ""), nullptr);
+    EXPECT_EQ(mux.open(1), nullptr);
+    link.bytes.clear();
+    mux.flush();
+    link.bytes.clear();
+
+    // Half a line on the console, then a whole command from automation, then the rest
+    std::string stream = SessionMux::encodeFrame(0, "led o") + SessionMux::encodeFrame(1, "led on\n");
+    mux.input(stream.data(), stream.size());
+    stream = SessionMux::encodeFrame(0, "n\n");
+    mux.input(stream.data(), stream.size());
+
+    auto out = link.byChannel();
+    EXPECT_EQ(out[0], "led on\nLED: ON\ncon> ");
+    EXPECT_EQ(out[1], "LED: ON\n");
+    EXPECT_EQ(mux.stats(0).framesIn, 2u);
+    EXPECT_EQ(mux.stats(1).bytesIn, 7u);
+}
+
+TEST(SessionMuxTests, ReassemblesFramesSplitAtAnyByte)
+{
+    CommandShell shell;
+    registerLed(shell);
+    LinkCapture link;
+    SessionMux mux(shell, link.writer());
+    mux.open(7, /*echoInput=*/false, "");
+
+    const std::string stream = SessionMux::encodeFrame(7, "led on\n") + SessionMux::encodeFrame(9, "led on\n")
+        + SessionMux::encodeFrame(7, "led on\n");
+    for (char c : stream)
+    {
+        mux.input(&c, 1);
+    }
+    EXPECT_EQ(link.byChannel()[7], "LED: ON\nLED: ON\n");
+    EXPECT_EQ(mux.stats().unknownChannel, 1u);
+}
+
+TEST(SessionMuxTests, SkipsOversizedFrames)
+{
+    CommandShell shell;
+    registerLed(shell);
+    LinkCapture link;
+    SessionMux::Limits limits;
+    limits.maxFrameBytes = 16;
+    SessionMux mux(shell, link.writer(), limits);
+    mux.open(0, /*echoInput=*/false, "");
+
+    std::string stream = SessionMux::encodeFrame(0, std::string(40, 'z')) + SessionMux::encodeFrame(0, "led on\n");
+    mux.input(stream.data(), 10); // part of the oversized payload
+    mux.input(stream.data() + 10, stream.size() - 10);
+    EXPECT_EQ(mux.stats().oversized, 1u);
+    EXPECT_EQ(link.byChannel()[0], "LED: ON\n");
+}
+
+TEST(SessionMuxTests, ResyncsAfterCorruptedBytes)
+{
+    CommandShell shell;
+    registerLed(shell);
+    LinkCapture link;
+    SessionMux mux(shell, link.writer());
+    mux.open(3, /*echoInput=*/false, "");
+
+    EXPECT_EQ(SessionMux::crc8("123456789", 9), 0xF4); // CRC-8/SMBUS check value
+
+    // Line noise, a frame with a flipped payload bit and one with a lost byte, then a good frame
+    std::string damaged = SessionMux::encodeFrame(3, "led on\n");
+    damaged[5] ^= 0x01;
+    std::string truncated = SessionMux::encodeFrame(3, "led on\n");
+    truncated.erase(6, 1);
+    const std::string stream = std::string("\x00\x13noise") + damaged + truncated + SessionMux::encodeFrame(3, "led on\n");
+    mux.input(stream.data(), stream.size());
+
+    EXPECT_EQ(link.byChannel()[3], "LED: ON\n");
+    EXPECT_EQ(mux.stats(3).framesIn, 1u);
+    EXPECT_GE(mux.stats().badChecksum, 2u);
+    EXPECT_GE(mux.stats().skippedBytes, 7u);
+}
+
+TEST(SessionMuxTests, OutputIsInterleavedRoundRobin)
+{
+    CommandShell shell;
+    registerLed(shell);
+    LinkCapture link;
+    SessionMux::Limits limits;
+    limits.maxFrameBytes = 32;
+    SessionMux mux(shell, link.writer(), limits);
+    mux.open(1, false, "");
+    mux.open(2, false, "");
+
+    // Queue both long outputs before anything is written
+    std::string line = "led dump\n";
+    mux.session(1)->input(line);
+    line = "led dump\n";
+    mux.session(2)->input(line);
+    EXPECT_EQ(mux.stats(1).queuedBytes, 101u);
+
+    EXPECT_EQ(mux.flush(3), 3u);
+    mux.flush();
+    std::vector<uint8_t> order;
+    for (const auto& f : link.frames()) order.push_back(f.first);
+    EXPECT_EQ(order, (std::vector<uint8_t>{1, 2, 1, 2, 1, 2, 1, 2}));
+    auto out = link.byChannel();
+    EXPECT_EQ(out[1], std::string(100, 'x') + "\n");
+    EXPECT_EQ(out[2], out[1]);
+}
+
+TEST(SessionMuxTests, FullQueueDropsOldestWholeOutput)
+{
+    CommandShell shell;
+    registerLed(shell);
+    LinkCapture link;
+    SessionMux::Limits limits;
+    limits.maxQueuedBytes = 105;
+    SessionMux mux(shell, link.writer(), limits);
+    mux.open(0, false, "");
+
+    std::string line = "led on\n";
+    mux.session(0)->input(line);
+    line = "led dump\n";
+    mux.session(0)->input(line);
+    auto stats = mux.stats(0);
+    EXPECT_EQ(stats.droppedBytes, 8u);
+    EXPECT_EQ(stats.droppedOutputs, 1u);
+    EXPECT_EQ(stats.queuedBytes, 101u);
+
+    // The reader learns where output went missing; what survives arrives whole
+    const std::string dump = std::string(100, 'x') + "\n";
+    mux.flush();
+    EXPECT_EQ(link.byChannel()[0], "[output] dropped 8 bytes (slow reader)\n" + dump);
+    EXPECT_TRUE(mux.close(0));
+    EXPECT_EQ(mux.session(0), nullptr);
+}
+
+TEST(SessionMuxTests, HalfSentOutputIsFinishedBeforeDrops)
+{
+    CommandShell shell;
+    registerLed(shell);
+    LinkCapture link;
+    SessionMux::Limits limits;
+    limits.maxFrameBytes = 32;
+    limits.maxQueuedBytes = 150;
+    SessionMux mux(shell, link.writer(), limits);
+    mux.open(0, false, "");
+
+    std::string line = "led dump\n";
+    mux.session(0)->input(line);
+    EXPECT_EQ(mux.flush(1), 1u); // first 32 bytes are on the link
+
+    // 69 + 101 bytes are over the limit: the new output goes, not the tail of the old one
+    mux.session(0)->input(line);
+    line = "led on\n";
+    mux.session(0)->input(line);
+    EXPECT_EQ(mux.stats(0).droppedBytes, 101u);
+    mux.flush();
+    const std::string dump = std::string(100, 'x') + "\n";
+    EXPECT_EQ(link.byChannel()[0], dump + "[output] dropped 101 bytes (slow reader)\nLED: ON\n");
+}
@@ -0,0 +1,109 @@
+// Unit tests for StringPool interning and the `shell memory` footprint report
+#include "../src/CommandShell.hpp"
+#include "../src/StringPool.hpp"
+#include "TestHelpers.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using commandshell::CommandShell;
+using commandshell::ComponentCommands;
+using commandshell::ComponentFactory;
+using commandshell::InstanceComponentCommands;
+using commandshell::StringPool;
+using testhelpers::makeCommand;
+
+TEST(StringPoolTests, InternsEachDistinctStringOnce)
+{
+    StringPool pool;
+    auto a = pool.intern("Control the built-in LED");
+    auto b = pool.intern("Motor driver");
+    auto c = pool.intern(std::string("Control the built-in LED"));
+    auto empty = pool.intern("");
+
+    EXPECT_EQ(a.offset, c.offset);
+    EXPECT_EQ(a.size, c.size);
+    EXPECT_NE(a.offset, b.offset);
+    EXPECT_TRUE(empty.empty());
+    EXPECT_EQ(pool.view(a), "Control the built-in LED");
+    EXPECT_EQ(pool.view(b), "Motor driver");
+    EXPECT_EQ(sizeof(StringPool::Handle), 8u);
+
+    const auto stats = pool.stats();
+    EXPECT_EQ(stats.strings, 2u);
+    EXPECT_EQ(stats.requests, 4u);
+    EXPECT_EQ(stats.bytes, std::string("Control the built-in LEDMotor driver").size());
+    EXPECT_EQ(stats.savedBytes, std::string("Control the built-in LED").size());
+}
+
+TEST(StringPoolTests, HandlesSurviveIndexGrowth)
+{
+    StringPool pool;
+    std::vector<StringPool::Handle> handles;
+    for (int i = 0; i < 500; ++i)
+    {
+        handles.push_back(pool.intern("name" + std::to_string(i)));
+    }
+    for (int i = 0; i < 500; ++i)
+    {
+        EXPECT_EQ(pool.view(handles[static_cast<size_t>(i)]), "name" + std::to_string(i));
+        EXPECT_EQ(pool.intern("name" + std::to_string(i)).offset, handles[static_cast<size_t>(i)].offset);
+    }
+    EXPECT_EQ(pool.stats().strings, 500u);
+
+    // Trimming drops the index; interning afterwards rebuilds it
+    pool.shrinkToFit();
+    EXPECT_EQ(pool.intern("name42").offset, handles[42].offset);
+    EXPECT_EQ(pool.view(pool.intern("fresh")), "fresh");
+    EXPECT_EQ(pool.stats().strings, 501u);
+}
+
+TEST(StringPoolTests, ShellMemoryReportsEveryComponent)
+{
+    CommandShell shell;
+    const std::string shared = "GPIO bank with a description shared by several components";
+    shell.registerComponent(ComponentCommands{"gpioa", shared});
+    shell.registerComponent(ComponentCommands{"gpiob", shared});
+    shell.registerComponentFactory(ComponentFactory{"lazy", shared, [] { return ComponentCommands{"lazy", "built"}; }});
+    shell.registerInstanceComponent(InstanceComponentCommands{"led", "Board LEDs", 16});
+
+    auto report = shell.executeCommand(makeCommand("shell", "memory"));
+    EXPECT_EQ(report.find("Registry memory (mutable): "), 0u);
+    EXPECT_NE(report.find("\n  gpioa: "), std::string::npos);
+    EXPECT_NE(report.find("\n  gpiob: "), std::string::npos);
+    EXPECT_NE(report.find("\n  lazy: "), std::string::npos);
+    EXPECT_NE(report.find(" (not built)\n"), std::string::npos);
+    EXPECT_NE(report.find("\n  led[0..15]: "), std::string::npos);
+    EXPECT_NE(report.find("shared by 16 instances"), std::string::npos);
+    // The mutable registry keeps strings where they were registered: no pool yet
+    EXPECT_NE(report.find("\n  strings: not interned until freeze()\n"), std::string::npos);
+    EXPECT_NE(shell.executeCommand(makeCommand("help", "list")).find("lazy - " + shared), std::string::npos);
+
+    shell.freeze();
+    report = shell.executeCommand(makeCommand("shell", "memory"));
+    EXPECT_EQ(report.find("Registry memory (frozen): "), 0u);
+    EXPECT_NE(report.find("\n  lazy: "), std::string::npos);
+    EXPECT_EQ(report.find("not built"), std::string::npos);
+    // Freezing interns the description shared by gpioa and gpiob once
+    const size_t sharedAt = report.rfind(", ", report.find(" bytes shared"));
+    ASSERT_NE(sharedAt, std::string::npos);
+    EXPECT_GE(std::stoul(report.substr(sharedAt + 2)), shared.size());
+}
+
+TEST(StringPoolTests, ReRegistrationKeepsOneDescription)
+{
+    CommandShell shell;
+    const std::string first(200, 'a');
+    shell.registerComponent(ComponentCommands{"gpio", first});
+    const auto before = shell.executeCommand(makeCommand("shell", "memory"));
+
+    // Replacing a component many times must not accumulate old descriptions
+    for (int i = 0; i < 100; ++i)
+    {
+        shell.registerComponent(ComponentCommands{"gpio", std::string(200, static_cast<char>('b' + i % 20))});
+    }
+    shell.registerComponent(ComponentCommands{"gpio", first});
+    EXPECT_EQ(shell.executeCommand(makeCommand("shell", "memory")), before);
+    EXPECT_NE(shell.executeCommand(makeCommand("help", "list")).find("gpio - " + first), std::string::npos);
+}
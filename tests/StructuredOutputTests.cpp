@@ -0,0 +1,177 @@
+// Unit tests for the JSON/CBOR encoders and structured shell responses
+#include "../src/CommandShell.hpp"
+#include "../src/CommandShellIO.hpp"
+#include "../src/StructuredOutput.hpp"
+#include "TestHelpers.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using commandshell::CborWriter;
+using commandshell::CommandDetails;
+using commandshell::CommandShell;
+using commandshell::CommandShellIO;
+using commandshell::ComponentCommands;
+using commandshell::ExecutionOptions;
+using commandshell::JsonWriter;
+using commandshell::OptionDetails;
+using commandshell::OutputFormat;
+using commandshell::StructuredWriter;
+using testhelpers::makeCommand;
+
+namespace {
+    void registerLed(CommandShell& shell)
+    {
+        ComponentCommands led{"led", "LED control"};
+        led.addOption(OptionDetails{"-q", "--quiet", "No output"});
+        led.addCommand(CommandDetails{
+            "on", "Turn on",
+            [](const std::vector<std::string>&, const std::vector<std::string>& opts) -> std::string {
+                return "LED on" + std::string(opts.empty() ? "" : " " + opts[0]) + "\n";
+            }
+        });
+        CommandDetails state{
+            "state", "Report state",
+            [](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string { return "on, 40%\n"; }
+        };
+        state.structured = [](const std::vector<std::string>&, const std::vector<std::string>&, StructuredWriter& w) {
+            w.beginObject();
+            w.field("on", true);
+            w.field("brightness", static_cast<uint64_t>(40));
+            w.endObject();
+        };
+        led.addCommand(state);
+        shell.registerComponent(led);
+    }
+
+    std::string bytes(std::initializer_list<unsigned char> list)
+    {
+        return std::string(list.begin(), list.end());
+    }
+}
+
+TEST(StructuredOutputTests, JsonWriterNestsAndEscapes)
+{
+    std::string out;
+    JsonWriter w(out);
+    w.beginObject();
+    w.field("text", "a\"b\\c\n\x01");
+    w.key("list");
+    w.beginArray();
+    w.value(static_cast<uint64_t>(1));
+    w.value(false);
+    w.null();
+    w.beginObject();
+    w.endObject();
+    w.endArray();
+    w.endObject();
+    EXPECT_EQ(out, "{\"text\":\"a\\\"b\\\\c\\n\\u0001\",\"list\":[1,false,null,{}]}");
+}
+
+TEST(StructuredOutputTests, CborWriterUsesIndefiniteContainers)
+{
+    std::string out;
+    CborWriter w(out);
+    w.beginObject();
+    w.field("a", static_cast<uint64_t>(500));
+    w.key("b");
+    w.beginArray();
+    w.value(true);
+    w.value(static_cast<uint64_t>(23));
+    w.value(static_cast<uint64_t>(24));
+    w.endArray();
+    w.endObject();
+    EXPECT_EQ(out, bytes({0xBF, 0x61, 'a', 0x19, 0x01, 0xF4, 0x61, 'b', 0x9F, 0xF5, 0x17, 0x18, 0x18, 0xFF, 0xFF}));
+}
+
+TEST(StructuredOutputTests, HelpAndErrorsAsJson)
+{
+    CommandShell shell;
+    registerLed(shell);
+    ExecutionOptions json;
+    json.format = OutputFormat::Json;
+
+    auto help = shell.executeCommand(makeCommand("help", "led"), json);
+    EXPECT_EQ(help,
+        "{\"name\":\"led\",\"description\":\"LED control\","
+        "\"options\":[{\"short\":\"-q\",\"long\":\"--quiet\",\"description\":\"No output\"}],"
+        "\"commands\":[{\"name\":\"on\",\"description\":\"Turn on\"},{\"name\":\"state\",\"description\":\"Report state\"}]}\n");
+
+    auto list = shell.executeCommand(makeCommand("help", "list"), json);
+    EXPECT_NE(list.find("{\"name\":\"led\",\"description\":\"LED control\"}"), std::string::npos);
+    EXPECT_NE(list.find("\"instanceComponents\":[]"), std::string::npos);
+
+    EXPECT_EQ(shell.executeCommand(makeCommand("nope", "x"), json), "{\"error\":\"Unknown component 'nope'\"}\n");
+    EXPECT_EQ(shell.executeCommand(makeCommand("led", "on", {}, {"--format=xml"})),
+        "Error: unknown format 'xml' (text, json, cbor)\n");
+}
+
+TEST(StructuredOutputTests, PagedHelpReportsTotals)
+{
+    CommandShell shell;
+    registerLed(shell);
+    ExecutionOptions json;
+    json.format = OutputFormat::Json;
+
+    auto help = shell.executeCommand(makeCommand("help", "led", {}, {"--limit=1"}), json);
+    EXPECT_NE(help.find("\"commands\":[{\"name\":\"on\",\"description\":\"Turn on\"}],\"total\":2,\"page\":1,\"limit\":1}"),
+        std::string::npos);
+
+    auto list = shell.executeCommand(makeCommand("help", "list", {"l*"}), json);
+    EXPECT_EQ(list, "{\"components\":[{\"name\":\"led\",\"description\":\"LED control\"}],"
+        "\"instanceComponents\":[],\"total\":1,\"page\":1,\"limit\":0}\n");
+}
+
+TEST(StructuredOutputTests, FormatOptionSelectsEncodingPerCommand)
+{
+    CommandShell shell;
+    registerLed(shell);
+
+    // Plain handlers are wrapped; the --format option is not passed to them
+    EXPECT_EQ(shell.executeCommand(makeCommand("led", "on", {}, {"--format=json", "--quiet"})),
+        "{\"output\":\"LED on --quiet\\n\"}\n");
+    // Opted-in handlers write through the encoder
+    EXPECT_EQ(shell.executeCommand(makeCommand("led", "state", {}, {"--format=json"})),
+        "{\"on\":true,\"brightness\":40}\n");
+    EXPECT_EQ(shell.executeCommand(makeCommand("led", "state", {}, {"--format=cbor"})),
+        bytes({0xBF, 0x62, 'o', 'n', 0xF5, 0x6A, 'b', 'r', 'i', 'g', 'h', 't', 'n', 'e', 's', 's', 0x18, 0x28, 0xFF}));
+    EXPECT_EQ(shell.executeCommand(makeCommand("led", "state")), "on, 40%\n");
+}
+
+TEST(StructuredOutputTests, RegistryDumpCoversComponentsAndFilters)
+{
+    CommandShell shell;
+    registerLed(shell);
+    auto dump = shell.executeCommand(makeCommand("help", "registry"));
+    EXPECT_EQ(dump.rfind("{\"components\":[", 0), 0u);
+    EXPECT_NE(dump.find("{\"name\":\"shell\",\"description\":"), std::string::npos);
+    EXPECT_NE(dump.find("{\"name\":\"state\",\"description\":\"Report state\"}"), std::string::npos);
+    EXPECT_NE(dump.find("\"filters\":[{\"name\":\"count\""), std::string::npos);
+    EXPECT_EQ(dump.back(), '\n');
+}
+
+TEST(StructuredOutputTests, SessionFormatAppliesToEveryLine)
+{
+    CommandShell shell;
+    registerLed(shell);
+    CommandShellIO io(shell, /*echoInput=*/false);
+    std::string captured;
+    io.setOutputCallback([&captured](const std::string& s) { captured += s; });
+    io.setOutputFormat(OutputFormat::Json);
+
+    std::string line = "led state\n";
+    io.input(line);
+    EXPECT_NE(captured.find("{\"on\":true,\"brightness\":40}\ncmd> "), std::string::npos);
+
+    captured.clear();
+    line = "led state --format=text\n";
+    io.input(line);
+    EXPECT_EQ(captured, "on, 40%\ncmd> ");
+
+    // Filters work on the text; what leaves the last stage is encoded
+    captured.clear();
+    line = "led state | grep on\n";
+    io.input(line);
+    EXPECT_EQ(captured, "{\"output\":\"on, 40%\\n\"}\ncmd> ");
+}
@@ -0,0 +1,24 @@
+#ifndef TEST_HELPERS_HPP
+#define TEST_HELPERS_HPP
+
+#include "../src/CommandTypes.hpp"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace testhelpers
+{
+    // A parsed command as CommandShellIO would hand it to CommandShell
+    inline commandshell::Command makeCommand(const std::string& comp, const std::string& cmd,
+                                             std::vector<std::string> args = {}, std::vector<std::string> opts = {})
+    {
+        commandshell::Command c;
+        c.component = comp;
+        c.command = cmd;
+        c.arguments = std::move(args);
+        c.options = std::move(opts);
+        return c;
+    }
+} // namespace testhelpers
+#endif // TEST_HELPERS_HPP
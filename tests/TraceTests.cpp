@@ -0,0 +1,69 @@
+// Unit tests for span tracing (only meaningful with -DENABLE_TRACE=ON)
+#include "../src/CommandShell.hpp"
+#include "../src/CommandShellIO.hpp"
+#include "../src/Trace.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+
+using commandshell::CommandDetails;
+using commandshell::CommandShell;
+using commandshell::CommandShellIO;
+using commandshell::ComponentCommands;
+
+#if COMMANDSHELL_TRACE
+namespace trace = commandshell::trace;
+
+TEST(TraceTests, RecordsStagesOfAnInputLine)
+{
+    CommandShell shell;
+    ComponentCommands sys{"sys", "System commands"};
+    sys.addCommand(CommandDetails{
+        "ping", "Reply pong",
+        [](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string { return "pong\n"; }
+    });
+    shell.registerComponent(sys);
+    CommandShellIO io(shell, /*echoInput=*/false);
+    io.setOutputCallback([](const std::string&) {});
+
+    trace::clearTrace();
+    std::string line = "sys ping\n";
+    io.input(line);
+
+    const auto json = trace::dumpChromeTrace();
+    EXPECT_EQ(json.rfind("{\"traceEvents\":[", 0), 0u);
+    for (const char* stage : {"io.input", "io.assembleLine", "io.splitInput", "io.parseCommand",
+                              "shell.executeCommand", "shell.lookupCommand", "shell.handler", "io.output"})
+    {
+        EXPECT_NE(json.find(std::string("{\"name\":\"") + stage + "\",\"ph\":\"X\""), std::string::npos) << stage;
+    }
+}
+
+TEST(TraceTests, KeepsOneRingPerThreadAndBoundsIt)
+{
+    trace::clearTrace();
+    std::thread worker([]() { COMMANDSHELL_TRACE_SCOPE("worker"); });
+    worker.join();
+    {
+        COMMANDSHELL_TRACE_SCOPE("main");
+    }
+    EXPECT_EQ(trace::spanCount(), 2u);
+    const auto json = trace::dumpChromeTrace();
+    EXPECT_NE(json.find("\"name\":\"worker\""), std::string::npos);
+    EXPECT_NE(json.find("\"name\":\"main\""), std::string::npos);
+
+    trace::clearTrace();
+    for (size_t i = 0; i < trace::kRingCapacity + 10; ++i)
+    {
+        COMMANDSHELL_TRACE_SCOPE("loop");
+    }
+    EXPECT_EQ(trace::spanCount(), trace::kRingCapacity);
+}
+#else
+TEST(TraceTests, ScopeCompilesOutWhenDisabled)
+{
+    COMMANDSHELL_TRACE_SCOPE("unused");
+    SUCCEED();
+}
+#endif
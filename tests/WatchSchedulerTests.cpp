@@ -0,0 +1,254 @@
+// Unit tests for WatchScheduler and the session `watch`/`repeat` commands
+#include "../src/CommandShell.hpp"
+#include "../src/CommandShellIO.hpp"
+#include "../src/WatchScheduler.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using commandshell::CommandDetails;
+using commandshell::CommandShell;
+using commandshell::CommandShellIO;
+using commandshell::ComponentCommands;
+using commandshell::WatchScheduler;
+
+namespace {
+    WatchScheduler::Watch makeWatch(const std::string& line, uint32_t intervalMs, uint32_t count = 0, bool diff = false)
+    {
+        WatchScheduler::Watch w;
+        w.line = line;
+        w.intervalMs = intervalMs;
+        w.remaining = count;
+        w.diff = diff;
+        return w;
+    }
+
+    // `led status` reports whatever state the test sets
+    void registerLed(CommandShell& shell, std::string& state, int& calls)
+    {
+        ComponentCommands led{"led", "Board LED"};
+        led.addCommand(CommandDetails{"status", "Show LED state",
+            [&state, &calls](const std::vector<std::string>&, const std::vector<std::string>&) -> std::string {
+                ++calls;
+                return "LED: " + state + "\nBrightness: 100\n";
+            }});
+        shell.registerComponent(led);
+    }
+}
+
+TEST(WatchSchedulerTests, DiffListsOnlyChangedLines)
+{
+    EXPECT_EQ(WatchScheduler::diffLines("a\nb\nc\n", "a\nB\nc\n"), "- b\n+ B\n");
+    EXPECT_EQ(WatchScheduler::diffLines("a\nb\nc\nd\n", "A\nb\nc\nD\n"), "- a\n+ A\n- d\n+ D\n");
+    EXPECT_EQ(WatchScheduler::diffLines("a\nc\n", "a\nb1\nb2\nc\n"), "+ b1\n+ b2\n");
+    EXPECT_EQ(WatchScheduler::diffLines("a\nb\nc\n", "a\n"), "- b\n- c\n");
+}
+
+TEST(WatchSchedulerTests, EmitsOnlyChangesOnSchedule)
+{
+    WatchScheduler watches;
+    std::string output = "one\n";
+    int runs = 0;
+    auto runner = [&](const WatchScheduler::Watch&) { ++runs; return output; };
+    std::vector<WatchScheduler::Update> updates;
+
+    const uint32_t id = watches.add(makeWatch("x y", 100), 0);
+    watches.run(0, 16, runner, updates);
+    ASSERT_EQ(updates.size(), 1u);
+    EXPECT_EQ(updates[0].id, id);
+    EXPECT_EQ(updates[0].text, "one\n");
+    EXPECT_EQ(watches.nextDueUs(), 100000u);
+
+    // Not due yet, then due but unchanged
+    updates.clear();
+    watches.run(50000, 16, runner, updates);
+    watches.run(100000, 16, runner, updates);
+    EXPECT_TRUE(updates.empty());
+    EXPECT_EQ(runs, 2);
+
+    // A late loop skips the missed ticks instead of running them back to back
+    output = "two\n";
+    watches.run(1000000, 16, runner, updates);
+    EXPECT_EQ(runs, 3);
+    ASSERT_EQ(updates.size(), 1u);
+    EXPECT_EQ(updates[0].text, "two\n");
+    EXPECT_EQ(watches.nextDueUs(), 1100000u);
+
+    EXPECT_TRUE(watches.stop(id));
+    EXPECT_FALSE(watches.stop(id));
+    EXPECT_EQ(watches.size(), 0u);
+}
+
+TEST(WatchSchedulerTests, RepeatFinishesAfterCount)
+{
+    WatchScheduler watches;
+    int runs = 0;
+    auto runner = [&](const WatchScheduler::Watch&) { return std::to_string(++runs % 2) + "\n"; };
+    std::vector<WatchScheduler::Update> updates;
+    watches.add(makeWatch("x y", 0, 3, /*diff=*/true), 0);
+
+    // Interval 0: once per run() call, never twice in the same call
+    watches.run(0, 16, runner, updates);
+    watches.run(0, 16, runner, updates);
+    watches.run(0, 16, runner, updates);
+    EXPECT_EQ(runs, 3);
+    ASSERT_EQ(updates.size(), 3u);
+    EXPECT_FALSE(updates[0].diff);
+    EXPECT_TRUE(updates[1].diff);
+    EXPECT_EQ(updates[1].text, "- 1\n+ 0\n");
+    EXPECT_TRUE(updates[2].finished);
+    EXPECT_EQ(updates[2].runs, 3u);
+    EXPECT_EQ(watches.size(), 0u);
+}
+
+TEST(WatchSchedulerTests, EmptyDiffIsNotAnUpdate)
+{
+    WatchScheduler watches;
+    std::string output = "a\nb\n";
+    auto runner = [&](const WatchScheduler::Watch&) { return output; };
+    std::vector<WatchScheduler::Update> updates;
+    watches.add(makeWatch("x y", 0, 0, /*diff=*/true), 0);
+    watches.run(0, 16, runner, updates);
+    ASSERT_EQ(updates.size(), 1u);
+
+    // Only the trailing newline changes: the line diff is empty, so nothing is reported
+    updates.clear();
+    output = "a\nb";
+    watches.run(0, 16, runner, updates);
+    EXPECT_TRUE(updates.empty());
+    EXPECT_EQ(watches.watches()[0].changes, 1u);
+
+    output = "a\nc";
+    watches.run(0, 16, runner, updates);
+    ASSERT_EQ(updates.size(), 1u);
+    EXPECT_EQ(updates[0].text, "- b\n+ c\n");
+}
+
+TEST(WatchSchedulerTests, SessionWatchOutputsDeltasUntilCtrlC)
+{
+    CommandShell shell;
+    uint64_t now = 0;
+    shell.setClock([&now]() { return now; });
+    std::string state = "OFF";
+    int calls = 0;
+    registerLed(shell, state, calls);
+    CommandShellIO io(shell, /*echoInput=*/false);
+    std::string captured;
+    io.setOutputCallback([&captured](const std::string& s) { captured += s; });
+
+    captured.clear();
+    std::string line = "watch 500 --diff led status\n";
+    io.input(line);
+    EXPECT_EQ(captured, "Watch 1: 'led status' every 500 ms, as diff\ncmd> ");
+
+    captured.clear();
+    io.poll();
+    EXPECT_EQ(captured, "[watch 1] led status\nLED: OFF\nBrightness: 100\n");
+
+    captured.clear();
+    for (int i = 1; i <= 4; ++i)
+    {
+        now = static_cast<uint64_t>(i) * 500000;
+        io.poll();
+    }
+    EXPECT_EQ(captured, "");
+    EXPECT_EQ(calls, 5);
+
+    state = "ON";
+    now = 2500000;
+    io.poll();
+    EXPECT_EQ(captured, "[watch 1] led status\n- LED: OFF\n+ LED: ON\n");
+
+    captured.clear();
+    line = "watch list\n";
+    io.input(line);
+    EXPECT_NE(captured.find("  1: led status (every 500 ms, 6 runs, 2 changed)\n"), std::string::npos);
+
+    captured.clear();
+    line = "\x03";
+    io.input(line);
+    EXPECT_EQ(captured, "Stopped 1 watch\ncmd> ");
+    EXPECT_EQ(io.watches().size(), 0u);
+    now = 10000000;
+    io.poll();
+    EXPECT_EQ(calls, 6);
+}
+
+TEST(WatchSchedulerTests, SessionRepeatAndErrors)
+{
+    CommandShell shell;
+    uint64_t now = 0;
+    shell.setClock([&now]() { return now; });
+    std::string state = "OFF";
+    int calls = 0;
+    registerLed(shell, state, calls);
+    CommandShellIO io(shell, /*echoInput=*/false);
+    std::string captured;
+    io.setOutputCallback([&captured](const std::string& s) { captured += s; });
+
+    captured.clear();
+    std::string line = "repeat 3 led status | grep LED\n";
+    io.input(line);
+    EXPECT_EQ(captured, "Watch 1: 'led status | grep LED' 3 times\ncmd> ");
+    captured.clear();
+    io.poll();
+    io.poll();
+    io.poll();
+    EXPECT_EQ(captured, "[watch 1] led status | grep LED\nLED: OFF\n[watch 1] done: 3 runs, 1 changed\n");
+    EXPECT_EQ(io.watches().size(), 0u);
+
+    std::string error;
+    EXPECT_EQ(io.startWatch("led status", 1, 0, false, &error), 0u);
+    EXPECT_EQ(error, "Error: watch interval must be at least 10 ms\n");
+    EXPECT_EQ(io.startWatch("watch 100 led status", 100, 0, false, &error), 0u);
+    EXPECT_EQ(error, "Error: cannot watch 'watch' commands\n");
+    EXPECT_EQ(io.startWatch("led", 100, 0, false, &error), 0u);
+    EXPECT_EQ(error, "Error: Incomplete command.\n");
+
+    captured.clear();
+    line = "watch stop 7\n";
+    io.input(line);
+    EXPECT_EQ(captured, "Error: no watch 7\ncmd> ");
+}
+
+TEST(WatchSchedulerTests, SessionWatchesSpendTheAdmissionBudget)
+{
+    CommandShell shell;
+    uint64_t now = 0;
+    shell.setClock([&now]() { return now; });
+    std::string state = "OFF";
+    int calls = 0;
+    registerLed(shell, state, calls);
+    commandshell::AdmissionPolicy policy;
+    policy.ratePerSecond = 1;
+    policy.burst = 1;
+    policy.overflow = commandshell::AdmissionPolicy::Overflow::Reject;
+    shell.setAdmissionPolicy("led", policy);
+    CommandShellIO io(shell, /*echoInput=*/false);
+    std::string captured;
+    io.setOutputCallback([&captured](const std::string& s) { captured += s; });
+
+    std::string line = "watch 10 led status\n";
+    io.input(line);
+    io.poll();
+    EXPECT_EQ(calls, 1);
+
+    // Due again, but the bucket is empty: the run is deferred, not forced through
+    now = 100000;
+    io.poll();
+    io.poll();
+    EXPECT_EQ(calls, 1);
+    line = "led status\n";
+    captured.clear();
+    io.input(line);
+    EXPECT_EQ(captured, "Error: rate limit exceeded\ncmd> ");
+
+    now = 1000000;
+    io.poll();
+    EXPECT_EQ(calls, 2);
+    captured.clear();
+    line = "watch list\n";
+    io.input(line);
+    EXPECT_NE(captured.find("  1: led status (every 10 ms, 2 runs, 1 changed, 2 deferred)\n"), std::string::npos);
+}
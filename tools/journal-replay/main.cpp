@@ -0,0 +1,93 @@
+// Replays an input journal recorded with CommandShellIO::setInputRecorder and
+// reports throughput and per-chunk input latency.
+//
+// The tool only registers a small demo component; to replay against a real
+// registry call commandshell::replayJournal() from the host binary instead.
+#include "CommandShell.hpp"
+#include "CommandTypes.hpp"
+#include "InputJournal.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using commandshell::CommandDetails;
+using commandshell::CommandShell;
+using commandshell::ComponentCommands;
+using commandshell::JournalRecord;
+using commandshell::ReplayOptions;
+
+namespace {
+    void usage()
+    {
+        std::cerr << "usage: journal-replay <journal> [--speed=original|max|<factor>] [--echo] [--print-output]\n";
+    }
+
+    ComponentCommands makeSysComponent()
+    {
+        ComponentCommands sys{"sys", "Demo commands for journal replay"};
+        sys.addCommand(CommandDetails{
+            "echo",
+            "Echo arguments",
+            [](const std::vector<std::string>& args, const std::vector<std::string>&) -> std::string {
+                std::string out;
+                for (size_t i = 0; i < args.size(); ++i) {
+                    if (i) out += ' ';
+                    out += args[i];
+                }
+                return out + "\n";
+            }
+        });
+        return sys;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        usage();
+        return 2;
+    }
+
+    ReplayOptions options;
+    bool printOutput = false;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--speed=original") {
+            options.speed = ReplayOptions::Speed::Original;
+        } else if (arg == "--speed=max") {
+            options.speed = ReplayOptions::Speed::Max;
+        } else if (arg.rfind("--speed=", 0) == 0) {
+            options.speed = ReplayOptions::Speed::Scaled;
+            options.scale = std::atof(arg.c_str() + 8);
+            if (options.scale <= 0.0) {
+                usage();
+                return 2;
+            }
+        } else if (arg == "--echo") {
+            options.echoInput = true;
+        } else if (arg == "--print-output") {
+            printOutput = true;
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (printOutput) {
+        options.output = [](const std::string& s) { std::cout << s; };
+    }
+
+    std::vector<JournalRecord> records;
+    if (!commandshell::loadJournal(argv[1], records)) {
+        std::cerr << "error: cannot read journal " << argv[1] << "\n";
+        return 1;
+    }
+
+    CommandShell shell;
+    shell.registerComponent(makeSysComponent());
+
+    auto report = commandshell::replayJournal(records, shell, options);
+    std::cout << report.summary();
+    return 0;
+}